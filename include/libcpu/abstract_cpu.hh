@@ -3,12 +3,18 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <libcpu/breakpoint.hh>
+#include <libcpu/coverage.hh>
 #include <libcpu/event.hh>
 #include <libcpu/memory.hh>
+#include <libcpu/profiler.hh>
+#include <libcpu/sampler.hh>
+#include <libcpu/watchpoint.hh>
 #include <libvio/agent.hh>
 #include <libvio/bus.hh>
 #include <libvio/frontend.hh>
 #include <libvio/ringbuffer.hh>
+#include <memory>
 
 namespace libcpu {
 
@@ -25,6 +31,15 @@ template <typename WORD_T> class abstract_cpu {
 public:
   using word_t = WORD_T; ///< Type alias for the CPU word type
 
+  /**
+   * @brief Opaque copy of the architectural state of a CPU
+   * @see save_state()
+   */
+  class state_t {
+  public:
+    virtual ~state_t() = default;
+  };
+
   memory_view *mem_bus = nullptr;
 
   //< The virtual MMIO bus. If nullptr, MMIO is disabled. Ignored
@@ -34,6 +49,22 @@ public:
   // Buffer for storing CPU events. If nullptr, event tracing is off.
   libvio::ringbuffer<event_t<WORD_T>> *event_buffer = nullptr;
 
+  // Data watchpoints checked on each load and store. If nullptr, or if the
+  // CPU does not support data watchpoints, they are not checked.
+  watchpoint_set<WORD_T> *watchpoints = nullptr;
+
+  // Profiler fed with the retired instructions, calls and returns. If
+  // nullptr, or if the CPU does not support profiling, nothing is profiled.
+  call_profiler<WORD_T> *profiler = nullptr;
+
+  // Sampler of the PC, fed by `run()`. If nullptr, or if the CPU does not
+  // support sampling, the PC is not sampled.
+  pc_sampler<WORD_T> *sampler = nullptr;
+
+  // Coverage map fed with the control flow edges taken. If nullptr, or if
+  // the CPU does not support coverage, no coverage is recorded.
+  coverage_map *coverage = nullptr;
+
   /**
    * @brief Get the number of the general purpose registers.
    * @return The number of the general purpose registers.
@@ -114,6 +145,55 @@ public:
     }
   };
 
+  /**
+   * @brief Execute instructions until n are committed, a breakpoint is reached
+   * or the CPU stops.
+   * @param n The maximum number of instructions to execute
+   * @param breakpoints Breakpoints checked after each instruction, may be
+   * `nullptr`
+   * @return The number of `next_instruction()` steps executed. If it is less
+   * than n and the CPU has not stopped, the PC is at a breakpoint or the last
+   * instruction triggered a data watchpoint in `watchpoints`.
+   * @note Implementations should override this with a loop that avoids the
+   * virtual calls per instruction.
+   */
+  virtual size_t run(size_t n, const breakpoint_set<WORD_T> *breakpoints) {
+    for (size_t i = 0; i < n; ++i) {
+      if (stopped()) {
+        return i;
+      }
+      next_instruction();
+      if ((breakpoints != nullptr && breakpoints->contains(get_pc())) ||
+          (watchpoints != nullptr && watchpoints->hit.has_value())) {
+        return i + 1;
+      }
+    }
+    return n;
+  }
+
+  /**
+   * @brief Save the architectural state of the CPU
+   *
+   * The state covers everything needed to continue execution from this point,
+   * except the content of the memory and the devices. It should be cheap
+   * enough to be taken periodically.
+   *
+   * @return The saved state, `nullptr` if not supported.
+   */
+  virtual std::unique_ptr<state_t> save_state(void) const { return nullptr; }
+
+  /**
+   * @brief Restore the architectural state saved by `save_state()`
+   *
+   * The buses are not part of the state, the CPU keeps using `mem_bus` and
+   * `mmio_bus`. Restoring a state also makes the CPU pick up any change to
+   * them since `reset()`.
+   *
+   * @param state A state saved from this CPU
+   * @return false if not supported
+   */
+  virtual bool restore_state(const state_t &state) { return false; }
+
   /**
    * @brief Convert virtual address to physical address
    * @param vaddr Virtual address to convert
@@ -0,0 +1,124 @@
+#ifndef LIBCPU_BREAKPOINT_HH
+#define LIBCPU_BREAKPOINT_HH
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief A set of breakpoint addresses optimized for checking every
+ * instruction.
+ *
+ * Most checks are for addresses without a breakpoint, so they are answered by
+ * a bitmap filter with one bit per hash bucket of addresses. Only the few
+ * addresses passing the filter are looked up exactly in a sorted vector. A
+ * check is therefore one load and a bit test, regardless of the number of
+ * breakpoints.
+ *
+ * The breakpoints are also kept in insertion order, so they can be listed and
+ * removed by index.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class breakpoint_set {
+public:
+  /**
+   * @brief Check whether an address has a breakpoint
+   * @param addr The address to check, usually the PC
+   * @return true if there is a breakpoint at `addr`
+   */
+  bool contains(WORD_T addr) const {
+    size_t bucket = hash(addr);
+    if (!((filter[bucket / 64] >> (bucket % 64)) & 1)) {
+      return false;
+    }
+    return std::binary_search(sorted.begin(), sorted.end(), addr);
+  }
+
+  /**
+   * @brief Add a breakpoint
+   * @param addr Address of the breakpoint
+   * @return false if there is already a breakpoint at `addr`
+   */
+  bool insert(WORD_T addr) {
+    auto it = std::lower_bound(sorted.begin(), sorted.end(), addr);
+    if (it != sorted.end() && *it == addr) {
+      return false;
+    }
+    sorted.insert(it, addr);
+    ordered.push_back(addr);
+    size_t bucket = hash(addr);
+    filter[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    return true;
+  }
+
+  /**
+   * @brief Remove a breakpoint by its index in insertion order
+   * @param index Index of the breakpoint, must be less than `size()`
+   * @return WORD_T Address of the removed breakpoint
+   */
+  WORD_T erase(size_t index) {
+    WORD_T addr = ordered[index];
+    ordered.erase(ordered.begin() + index);
+    sorted.erase(std::lower_bound(sorted.begin(), sorted.end(), addr));
+    rebuild_filter();
+    return addr;
+  }
+
+  /**
+   * @brief Get the number of breakpoints
+   * @return size_t Number of breakpoints
+   */
+  size_t size(void) const { return ordered.size(); }
+
+  /**
+   * @brief Check whether there is no breakpoint
+   * @return true if there is no breakpoint
+   */
+  bool empty(void) const { return ordered.empty(); }
+
+  /**
+   * @brief Get a breakpoint by its index in insertion order
+   * @param index Index of the breakpoint, must be less than `size()`
+   * @return WORD_T Address of the breakpoint
+   */
+  WORD_T operator[](size_t index) const { return ordered[index]; }
+
+private:
+  static constexpr size_t filter_bits = 4096; ///< Number of hash buckets
+
+  std::array<uint64_t, filter_bits / 64> filter{}; ///< Bit per hash bucket
+  std::vector<WORD_T> sorted;  ///< Breakpoints sorted by address
+  std::vector<WORD_T> ordered; ///< Breakpoints in insertion order
+
+  /**
+   * @brief Get the hash bucket of an address
+   * @param addr The address
+   * @return size_t Index of the bucket
+   *
+   * Instructions are at least 2-byte aligned, so the lowest bit is dropped
+   * and nearby instructions fall into different buckets.
+   */
+  static size_t hash(WORD_T addr) {
+    return (static_cast<uint64_t>(addr) >> 1) % filter_bits;
+  }
+
+  /**
+   * @brief Recompute the filter from the remaining breakpoints
+   */
+  void rebuild_filter(void) {
+    filter.fill(0);
+    for (WORD_T addr : sorted) {
+      size_t bucket = hash(addr);
+      filter[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    }
+  }
+};
+
+} // namespace libcpu
+
+#endif
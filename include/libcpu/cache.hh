@@ -0,0 +1,372 @@
+#ifndef LIBCPU_CACHE_HH
+#define LIBCPU_CACHE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <libcpu/event.hh>
+#include <libvio/ringbuffer.hh>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @enum replacement_t
+ * @brief Replacement policies of a cache
+ */
+enum class replacement_t : uint8_t {
+  lru,    ///< Least recently used
+  plru,   ///< Tree pseudo-LRU, the number of ways must be a power of 2
+  random, ///< Uniformly random
+};
+
+/**
+ * @struct cache_config_t
+ * @brief Geometry and policies of a cache
+ */
+struct cache_config_t {
+  uint64_t size = 32 * 1024; ///< Capacity in bytes
+  unsigned ways = 8;         ///< Associativity, at most 64
+  unsigned line = 64;        ///< Line size in bytes, a power of 2
+  replacement_t replacement = replacement_t::lru; ///< Replacement policy
+  bool write_back = true;     ///< Write back dirty lines, or write through
+  bool write_allocate = true; ///< Fill the line on a write miss
+
+  /**
+   * @brief Parse a configuration
+   *
+   * The format is `size:ways:line[:policy]...`, where the size may have a
+   * `k` or `m` suffix, and the policies are `lru`, `plru` or `random`, and
+   * `wb` or `wt` for write-back or write-through, and `wa` or `nwa` for
+   * write-allocate or not. Policies not given keep their defaults, e.g.
+   * `32k:8:64:plru:wt`.
+   *
+   * @param spec The configuration
+   * @return The configuration, nullopt if malformed or not a valid geometry
+   */
+  static std::optional<cache_config_t> parse(const std::string &spec);
+
+  /**
+   * @brief Format a configuration as accepted by `parse()`
+   * @return std::string The configuration
+   */
+  std::string to_string(void) const;
+};
+
+/**
+ * @brief A set-associative cache, holding tags only.
+ *
+ * The tags of a set are contiguous and compared all at once without
+ * branches, so the compiler vectorizes the lookup. Only misses go through
+ * the replacement policy out of line.
+ *
+ * The cache reports the requests it makes to the next level: fills of the
+ * missing lines, write-backs of dirty victims, and writes passed through.
+ */
+class cache_model {
+public:
+  /**
+   * @struct stats_t
+   * @brief Access counts
+   */
+  struct stats_t {
+    uint64_t reads = 0;        ///< Read accesses
+    uint64_t writes = 0;       ///< Write accesses
+    uint64_t read_misses = 0;  ///< Read accesses missing
+    uint64_t write_misses = 0; ///< Write accesses missing
+    uint64_t writebacks = 0;   ///< Dirty lines evicted
+  };
+
+  /**
+   * @struct result_t
+   * @brief Requests to the next level caused by an access
+   */
+  struct result_t {
+    bool hit;            ///< Whether the line was present
+    bool fill;           ///< Whether the line is read from the next level
+    bool write_through;  ///< Whether the write is passed to the next level
+    bool writeback;      ///< Whether a dirty line is written back
+    uint64_t victim;     ///< Address of the line written back
+  };
+
+  /**
+   * @brief Create an empty cache
+   * @param config The configuration, as validated by
+   * `cache_config_t::parse()`
+   */
+  explicit cache_model(const cache_config_t &config);
+
+  /**
+   * @brief Access the cache
+   * @param addr Byte address accessed, an access never spans two lines
+   * @param write Whether it is a write
+   * @return result_t Requests to the next level
+   */
+  result_t access(uint64_t addr, bool write) {
+    uint64_t block = addr >> line_shift;
+    size_t base = (block & set_mask) * ways;
+    uint64_t hits = match(base, block);
+    if (write) {
+      ++stats.writes;
+    } else {
+      ++stats.reads;
+    }
+    if (hits == 0) {
+      return miss(base, block, write);
+    }
+    size_t way = base + __builtin_ctzll(hits);
+    touch(base, way);
+    dirty[way] |= write & config.write_back;
+    return {true, false, write && !config.write_back, false, 0};
+  }
+
+  /**
+   * @brief Get the configuration
+   * @return const cache_config_t& The configuration
+   */
+  const cache_config_t &get_config(void) const { return config; }
+
+  /**
+   * @brief Get the access counts
+   * @return const stats_t& The counts
+   */
+  const stats_t &get_stats(void) const { return stats; }
+
+private:
+  /// Tag of an invalid line, no block address reaches it
+  static constexpr uint64_t invalid = UINT64_MAX;
+
+  cache_config_t config;
+  unsigned line_shift;          ///< log2 of the line size
+  uint64_t set_mask;            ///< Number of sets minus 1
+  size_t ways;                  ///< Associativity
+  std::vector<uint64_t> tags;   ///< Block address of each line, by set
+  std::vector<uint8_t> dirty;   ///< Whether each line is dirty
+  std::vector<uint64_t> state;  ///< LRU stamps by line, or PLRU bits by set
+  uint64_t clock = 0;           ///< Stamp of the last LRU access
+  uint64_t rng = 0x9e3779b97f4a7c15; ///< State of the random policy
+  stats_t stats;
+
+  /**
+   * @brief Compare the tags of a set
+   * @param base Index of the first line of the set
+   * @param block Block address looked for
+   * @return uint64_t Bit `i` is set if way `i` holds the block
+   */
+  uint64_t match(size_t base, uint64_t block) const {
+    const uint64_t *set = tags.data() + base;
+    uint64_t hits = 0;
+    for (size_t i = 0; i < ways; ++i) {
+      hits |= static_cast<uint64_t>(set[i] == block) << i;
+    }
+    return hits;
+  }
+
+  /**
+   * @brief Update the replacement state on an access
+   * @param base Index of the first line of the set
+   * @param line Index of the line accessed
+   */
+  void touch(size_t base, size_t line) {
+    if (config.replacement == replacement_t::lru) {
+      state[line] = ++clock;
+    } else if (config.replacement == replacement_t::plru) {
+      touch_plru(base / ways, line - base);
+    }
+  }
+
+  /**
+   * @brief Point the PLRU tree of a set away from a way
+   * @param set The set
+   * @param way The way accessed
+   */
+  void touch_plru(size_t set, size_t way);
+
+  /**
+   * @brief Handle a miss, filling the line if allocated
+   * @param base Index of the first line of the set
+   * @param block Block address missing
+   * @param write Whether it is a write
+   * @return result_t Requests to the next level
+   */
+  result_t miss(size_t base, uint64_t block, bool write);
+
+  /**
+   * @brief Choose the line to replace in a set
+   * @param base Index of the first line of the set
+   * @return size_t Index of the line
+   */
+  size_t victim(size_t base);
+};
+
+/**
+ * @brief A trace-driven model of an L1I/L1D/L2 cache hierarchy.
+ *
+ * The model consumes the `issue`, `load` and `store` events of a CPU, live
+ * from its event buffer or from a recorded trace. An instruction fetch goes
+ * to the L1I, loads and stores go to the L1D, and the requests of both to
+ * the next level go to the optional unified L2, or to the memory. Accesses
+ * are assumed not to span two lines.
+ *
+ * The reuse distance of each L1 access is the number of accesses to the
+ * same L1 since the last access to the same line. It is collected in
+ * power-of-two buckets in bounded memory: the last access of each line is
+ * kept in a direct-mapped table, where lines evicted count as first uses.
+ */
+class cache_hierarchy {
+public:
+  static constexpr size_t n_buckets = 24; ///< Reuse histogram buckets
+
+  /**
+   * @brief Create an empty hierarchy
+   * @param l1i Configuration of the instruction cache
+   * @param l1d Configuration of the data cache
+   * @param l2 Configuration of the unified L2, nullopt if none
+   */
+  cache_hierarchy(const cache_config_t &l1i, const cache_config_t &l1d,
+                  const std::optional<cache_config_t> &l2);
+
+  /**
+   * @brief Fetch an instruction
+   * @param addr Address of the instruction
+   */
+  void fetch(uint64_t addr) {
+    ++instructions;
+    l1_access(l1i, ireuse, addr, false);
+  }
+
+  /**
+   * @brief Load data
+   * @param addr Address loaded
+   */
+  void load(uint64_t addr) { l1_access(l1d, dreuse, addr, false); }
+
+  /**
+   * @brief Store data
+   * @param addr Address stored to
+   */
+  void store(uint64_t addr) { l1_access(l1d, dreuse, addr, true); }
+
+  /**
+   * @brief Consume an event
+   * @param event The event, types other than `issue`, `load` and `store`
+   * are ignored
+   */
+  template <typename WORD_T> void consume(const event_t<WORD_T> &event) {
+    switch (event.type) {
+    case event_type_t::issue:
+      fetch(event.pc);
+      break;
+    case event_type_t::load:
+      load(event.val1);
+      break;
+    case event_type_t::store:
+      store(event.val1);
+      break;
+    default:
+      break;
+    }
+  }
+
+  /**
+   * @brief Consume the new events in an event buffer
+   *
+   * If the buffer has overwritten events since `begin`, they are counted as
+   * lost and the model continues with the oldest event left.
+   *
+   * @param buffer The event buffer
+   * @param begin Index of the first event not consumed yet
+   * @return size_t Index of the next event to consume
+   */
+  template <typename WORD_T>
+  size_t consume(const libvio::ringbuffer<event_t<WORD_T>> &buffer,
+                 size_t begin) {
+    if (begin < buffer.firstindex()) {
+      lost += buffer.firstindex() - begin;
+      begin = buffer.firstindex();
+    }
+    for (size_t i = begin; i < buffer.lastindex(); ++i) {
+      consume(buffer[i]);
+    }
+    return buffer.lastindex();
+  }
+
+  /**
+   * @brief Get the instruction cache
+   * @return const cache_model& The cache
+   */
+  const cache_model &get_l1i(void) const { return l1i; }
+
+  /**
+   * @brief Get the data cache
+   * @return const cache_model& The cache
+   */
+  const cache_model &get_l1d(void) const { return l1d; }
+
+  /**
+   * @brief Get the L2 cache
+   * @return const cache_model* The cache, nullptr if none
+   */
+  const cache_model *get_l2(void) const {
+    return l2.has_value() ? &l2.value() : nullptr;
+  }
+
+  /**
+   * @brief Write the hit rates, MPKI and reuse distances
+   * @param os Output stream
+   */
+  void write_report(std::ostream &os) const;
+
+private:
+  /**
+   * @struct reuse_t
+   * @brief Reuse distances of the accesses to a cache
+   */
+  struct reuse_t {
+    /// Last access of a line
+    struct entry_t {
+      uint64_t block; ///< Block address
+      uint64_t time;  ///< Index of the access from 1, 0 if empty
+    };
+    unsigned line_shift;                ///< log2 of the line size
+    std::vector<entry_t> last;          ///< Last accesses, direct-mapped
+    uint64_t time = 0;                  ///< Accesses so far
+    uint64_t first = 0;                 ///< Accesses with no reuse known
+    uint64_t histogram[n_buckets] = {}; ///< Reuse distances
+
+    explicit reuse_t(const cache_config_t &config);
+    void access(uint64_t addr);
+  };
+
+  cache_model l1i;
+  cache_model l1d;
+  std::optional<cache_model> l2;
+  reuse_t ireuse;
+  reuse_t dreuse;
+  uint64_t instructions = 0;  ///< Instructions fetched
+  uint64_t mem_reads = 0;     ///< Lines read from the memory
+  uint64_t mem_writes = 0;    ///< Writes to the memory
+  uint64_t lost = 0;          ///< Events overwritten before consumed
+
+  void l1_access(cache_model &cache, reuse_t &reuse, uint64_t addr,
+                 bool write) {
+    reuse.access(addr);
+    cache_model::result_t result = cache.access(addr, write);
+    if (!result.hit || result.write_through) {
+      next_level(result, addr);
+    }
+  }
+
+  /**
+   * @brief Pass the requests of an L1 to the L2 or the memory
+   * @param result Result of the L1 access
+   * @param addr Address accessed in the L1
+   */
+  void next_level(const cache_model::result_t &result, uint64_t addr);
+};
+
+} // namespace libcpu
+
+#endif
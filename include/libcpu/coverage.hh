@@ -0,0 +1,161 @@
+#ifndef LIBCPU_COVERAGE_HH
+#define LIBCPU_COVERAGE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_set>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief Control flow coverage of a program, in the style of AFL.
+ *
+ * The CPU reports every edge of the control flow graph it takes, i.e. each
+ * jump or branch, taken or not, each trap and each trap return, with the
+ * address of the instruction and the address executed next. An edge is
+ * hashed to an index in a 64 KiB bitmap of saturating hit counts, so
+ * collisions are possible but recording costs a few instructions.
+ *
+ * Optionally, the start of every basic block executed is recorded exactly.
+ * A basic block starts at the target of an edge, so the blocks are the
+ * targets of the edges, plus the entry point.
+ *
+ * Coverage maps are saved in a binary file and merged by taking the highest
+ * count of each edge and the union of the blocks.
+ */
+class coverage_map {
+public:
+  /// Number of entries of the edge bitmap
+  static constexpr size_t map_size = size_t{1} << 16;
+
+  /**
+   * @brief Create an empty coverage map
+   * @param track_blocks Whether to record the basic blocks exactly
+   */
+  explicit coverage_map(bool track_blocks = false)
+      : track_blocks(track_blocks), bitmap(map_size) {}
+
+  /**
+   * @brief Record a taken edge of the control flow graph
+   * @param from Address of the instruction
+   * @param to Address of the next instruction executed
+   */
+  void edge(uint64_t from, uint64_t to) {
+    // the source is shifted so that A->B and B->A differ, like AFL does
+    size_t index = hash(to) ^ (hash(from) >> 1);
+    bitmap[index] += bitmap[index] != UINT8_MAX;
+    if (track_blocks) {
+      insert_block(to);
+    }
+  }
+
+  /**
+   * @brief Record the start of a basic block not reached by an edge, e.g.
+   * the entry point
+   * @param addr Address of the first instruction
+   */
+  void block(uint64_t addr) {
+    if (track_blocks) {
+      insert_block(addr);
+    }
+  }
+
+  /**
+   * @brief Check whether the basic blocks are recorded
+   * @return true if they are, false if only the edge bitmap is
+   */
+  bool tracks_blocks(void) const { return track_blocks; }
+
+  /**
+   * @brief Get the edge bitmap
+   * @return The hit count of each edge index, `map_size` entries
+   */
+  const uint8_t *get_bitmap(void) const { return bitmap.data(); }
+
+  /**
+   * @brief Count the edge indices hit
+   * @return size_t Number of non-zero entries of the bitmap
+   */
+  size_t edges(void) const;
+
+  /**
+   * @brief Get the number of basic blocks executed
+   * @return size_t Number of blocks, 0 if they are not recorded
+   */
+  size_t n_blocks(void) const { return blocks.size(); }
+
+  /**
+   * @brief Get the basic blocks executed
+   * @return The start addresses of the blocks, sorted
+   */
+  std::vector<uint64_t> get_blocks(void) const;
+
+  /**
+   * @brief Merge another coverage map into this one
+   *
+   * The blocks of `other` are ignored if this map does not record blocks.
+   *
+   * @param other The coverage map to merge
+   * @return size_t Number of edge indices and blocks not covered before
+   */
+  size_t merge(const coverage_map &other);
+
+  /**
+   * @brief Merge a coverage map saved by `save()` into this one
+   * @param filename Path to the file
+   * @return Number of edge indices and blocks not covered before, nullopt if
+   * the file cannot be read or is not a coverage map
+   */
+  std::optional<size_t> merge(const char *filename);
+
+  /**
+   * @brief Save the coverage map in a binary file
+   *
+   * The file holds an 8-byte magic `ANEMOCOV`, the number of blocks as a
+   * 64-bit integer, the bitmap, then the sorted block addresses as 64-bit
+   * integers, in host byte order.
+   *
+   * @param filename Path to the file
+   * @return true on success, false if the file cannot be written
+   */
+  bool save(const char *filename) const;
+
+  /**
+   * @brief Forget all edges and blocks
+   */
+  void clear(void);
+
+private:
+  bool track_blocks;                   ///< Whether blocks are recorded
+  std::vector<uint8_t> bitmap;         ///< Hit counts by edge index
+  std::unordered_set<uint64_t> blocks; ///< Start addresses of the blocks
+
+  /**
+   * @brief Hash an address to an index of the bitmap
+   * @param addr The address
+   * @return size_t The index, less than `map_size`
+   */
+  static size_t hash(uint64_t addr) {
+    // Fibonacci hashing, instructions are at least 2-byte aligned
+    return (addr >> 1) * 0x9e3779b97f4a7c15 >> 48;
+  }
+
+  /**
+   * @brief Add a block, out of line to keep the CPU loop small
+   * @param addr Address of the first instruction
+   */
+  void insert_block(uint64_t addr);
+
+  /**
+   * @brief Merge a bitmap into the bitmap of this map
+   * @param other The bitmap, `map_size` entries
+   * @return size_t Number of edge indices not covered before
+   */
+  size_t merge_bitmap(const uint8_t *other);
+};
+
+} // namespace libcpu
+
+#endif
@@ -0,0 +1,326 @@
+#ifndef LIBCPU_DATAFLOW_HH
+#define LIBCPU_DATAFLOW_HH
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <libcpu/event.hh>
+#include <libvio/ringbuffer.hh>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief A limit study of the instruction level parallelism in a trace.
+ *
+ * The analyzer consumes the `issue`, `load`, `store` and `reg_write` events
+ * of a CPU and renames every register and memory location written into a
+ * new value, named by the instruction producing it, as in a static single
+ * assignment form. Only true dependences remain, so each instruction depends
+ * on the producers of the registers it reads, found by an ISA-specific
+ * decoder, and of the memory it loads. Memory is tracked in granules of
+ * `granule_bytes`, so accesses to the same granule are all dependent.
+ *
+ * Every instruction takes one cycle once its operands are ready, and two
+ * schedules are computed:
+ *
+ * - The dataflow schedule has unlimited resources. Its length is the
+ *   critical path of the trace.
+ * - The window schedule only has `window` instructions in flight, retired in
+ *   order, as with a reorder buffer of that size and an unlimited issue
+ *   width. Producers older than the window never delay an instruction in it.
+ *
+ * The available ILP is the number of instructions over the length of a
+ * schedule. The distance in instructions from each producer to its consumer
+ * is also collected, in power-of-two buckets, separately for registers and
+ * memory.
+ *
+ * Memory use is bounded: stores are remembered in a direct-mapped table,
+ * where a store evicting another one drops the dependences on the older
+ * store, so the schedules may come out shorter. Evictions are counted and
+ * reported.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class dataflow_analyzer {
+public:
+  /// Function reading the source registers of an instruction into `regs`,
+  /// at least 4 entries, and returning their number
+  using source_fn = unsigned (*)(WORD_T instr, uint8_t *regs);
+
+  static constexpr size_t n_buckets = 16; ///< Distance histogram buckets
+  static constexpr unsigned granule_bytes = 8; ///< Memory tracking unit
+
+  /**
+   * @brief Start an analysis
+   * @param window Instructions in flight in the window schedule, at least 1
+   * @param sources Decoder of the source registers
+   * @param mem_entries Stores remembered, rounded up to a power of 2
+   */
+  dataflow_analyzer(size_t window, source_fn sources,
+                    size_t mem_entries = 1 << 16)
+      : window(std::max<size_t>(window, 1)), sources(sources),
+        retired(this->window, 0), mem(std::bit_ceil(mem_entries)) {}
+
+  /**
+   * @brief Consume an event
+   *
+   * An instruction is accounted for when the next one issues, or on
+   * `flush()`.
+   *
+   * @param event The event, types other than `issue`, `load`, `store` and
+   * `reg_write` are ignored
+   */
+  void consume(const event_t<WORD_T> &event) {
+    switch (event.type) {
+    case event_type_t::issue: {
+      flush();
+      pending = true;
+      uint8_t regs[4];
+      unsigned n = sources(event.val1, regs);
+      for (unsigned i = 0; i < n; ++i) {
+        depend(this->regs[regs[i]], reg_distances);
+      }
+      break;
+    }
+    case event_type_t::load: {
+      const mem_entry_t &entry = mem[mem_slot(event.val1)];
+      if (entry.granule == event.val1 / granule_bytes) {
+        depend(entry.value, mem_distances);
+      }
+      break;
+    }
+    case event_type_t::store:
+      if (n_stores < max_dests) {
+        stores[n_stores++] = event.val1 / granule_bytes;
+      }
+      break;
+    case event_type_t::reg_write:
+      if (n_writes < max_dests) {
+        writes[n_writes++] = static_cast<uint8_t>(event.val1);
+      }
+      break;
+    default:
+      break;
+    }
+  }
+
+  /**
+   * @brief Consume the new events in an event buffer
+   *
+   * If the buffer has overwritten events since `begin`, they are counted as
+   * lost and the analysis continues with the oldest event left.
+   *
+   * @param buffer The event buffer
+   * @param begin Index of the first event not consumed yet
+   * @return size_t Index of the next event to consume
+   */
+  size_t consume(const libvio::ringbuffer<event_t<WORD_T>> &buffer,
+                 size_t begin) {
+    if (begin < buffer.firstindex()) {
+      lost += buffer.firstindex() - begin;
+      begin = buffer.firstindex();
+    }
+    for (size_t i = begin; i < buffer.lastindex(); ++i) {
+      consume(buffer[i]);
+    }
+    return buffer.lastindex();
+  }
+
+  /**
+   * @brief Account for the last instruction issued
+   *
+   * Call it at an instruction boundary, before reading the results.
+   */
+  void flush(void) {
+    if (!pending) {
+      return;
+    }
+    uint64_t seq = ++instructions;
+    uint64_t height = ready_height + 1;
+    // `retired` holds the retire cycle of the instruction `window` before
+    uint64_t &slot = retired[seq % window];
+    uint64_t cycle = std::max(ready_cycle, slot) + 1;
+    last_retired = std::max(last_retired, cycle);
+    slot = last_retired;
+    critical_path = std::max(critical_path, height);
+
+    value_t value{seq, height, cycle};
+    for (size_t i = 0; i < n_writes; ++i) {
+      regs[writes[i]] = value;
+    }
+    for (size_t i = 0; i < n_stores; ++i) {
+      mem_entry_t &entry = mem[mem_slot(stores[i] * granule_bytes)];
+      evictions += entry.value.seq != 0 && entry.granule != stores[i];
+      entry = {stores[i], value};
+    }
+    pending = false;
+    ready_height = 0;
+    ready_cycle = 0;
+    n_writes = 0;
+    n_stores = 0;
+  }
+
+  /**
+   * @brief Get the number of instructions analyzed
+   * @return uint64_t Number of instructions
+   */
+  uint64_t get_instructions(void) const { return instructions; }
+
+  /**
+   * @brief Get the length of the window schedule
+   * @return uint64_t Number of cycles
+   */
+  uint64_t get_cycles(void) const { return last_retired; }
+
+  /**
+   * @brief Get the length of the dataflow schedule
+   * @return uint64_t Instructions on the longest dependence chain
+   */
+  uint64_t get_critical_path(void) const { return critical_path; }
+
+  /**
+   * @brief Get the histogram of register dependence distances
+   * @return Bucket `i` counts distances in `[2^i, 2^(i+1))`, the last one
+   * counts all longer distances too
+   */
+  const uint64_t *get_reg_distances(void) const { return reg_distances; }
+
+  /**
+   * @brief Get the histogram of memory dependence distances
+   * @return Buckets as in `get_reg_distances()`
+   */
+  const uint64_t *get_mem_distances(void) const { return mem_distances; }
+
+  /**
+   * @brief Write the schedule lengths, ILP and distance histograms
+   * @param os Output stream
+   */
+  void write_report(std::ostream &os) const;
+
+private:
+  static constexpr size_t max_dests = 4; ///< Writes kept per instruction
+
+  /**
+   * @struct value_t
+   * @brief A value in SSA form, named by its producer
+   */
+  struct value_t {
+    uint64_t seq;    ///< Number of the producer from 1, 0 if a live-in
+    uint64_t height; ///< Cycle of the producer in the dataflow schedule
+    uint64_t cycle;  ///< Cycle of the producer in the window schedule
+  };
+
+  /**
+   * @struct mem_entry_t
+   * @brief The last store to a memory granule
+   */
+  struct mem_entry_t {
+    uint64_t granule; ///< Address over `granule_bytes`
+    value_t value;    ///< The value stored
+  };
+
+  size_t window;                   ///< Size of the window schedule
+  source_fn sources;               ///< Decoder of the source registers
+  std::vector<uint64_t> retired;   ///< Retire cycles of the last window
+  std::vector<mem_entry_t> mem;    ///< Last stores, direct-mapped
+  value_t regs[256] = {};          ///< Current value of each register
+  uint64_t reg_distances[n_buckets] = {}; ///< Register dependence distances
+  uint64_t mem_distances[n_buckets] = {}; ///< Memory dependence distances
+
+  uint64_t instructions = 0;  ///< Instructions accounted for
+  uint64_t last_retired = 0;  ///< Retire cycle of the last instruction
+  uint64_t critical_path = 0; ///< Longest dependence chain
+  uint64_t evictions = 0;     ///< Stores evicted from `mem`
+  uint64_t lost = 0;          ///< Events overwritten before consumed
+
+  bool pending = false;       ///< Whether an instruction is being collected
+  uint64_t ready_height = 0;  ///< Latest producer in the dataflow schedule
+  uint64_t ready_cycle = 0;   ///< Latest producer in the window schedule
+  uint8_t writes[max_dests];  ///< Registers written
+  uint64_t stores[max_dests]; ///< Granules stored to
+  size_t n_writes = 0;
+  size_t n_stores = 0;
+
+  size_t mem_slot(uint64_t addr) const {
+    uint64_t granule = addr / granule_bytes;
+    return (granule ^ (granule >> 16)) & (mem.size() - 1);
+  }
+
+  /**
+   * @brief Make the instruction being collected depend on a value
+   * @param value The value
+   * @param distances Histogram of the dependence distance
+   */
+  void depend(const value_t &value, uint64_t *distances) {
+    if (!pending || value.seq == 0) {
+      return;
+    }
+    ready_height = std::max(ready_height, value.height);
+    ready_cycle = std::max(ready_cycle, value.cycle);
+    uint64_t distance = instructions + 1 - value.seq;
+    ++distances[std::min<size_t>(std::bit_width(distance) - 1,
+                                 n_buckets - 1)];
+  }
+};
+
+template <typename WORD_T>
+void dataflow_analyzer<WORD_T>::write_report(std::ostream &os) const {
+  auto ilp = [this](uint64_t cycles) {
+    return static_cast<double>(instructions) / std::max<uint64_t>(cycles, 1);
+  };
+  os << std::dec << instructions << " instructions";
+  if (lost != 0) {
+    os << ", " << lost << " events lost";
+  }
+  os << std::endl << std::fixed << std::setprecision(2);
+  os << "window of " << window << ": " << last_retired << " cycles, ILP "
+     << ilp(last_retired) << std::endl;
+  os << "dataflow: critical path " << critical_path << ", ILP "
+     << ilp(critical_path);
+  if (evictions != 0) {
+    os << " (" << evictions << " stores evicted, may be longer)";
+  }
+  os << std::endl;
+
+  // the cumulative share is the fraction of dependences a window of the
+  // upper bound of the bucket would see
+  os << std::setw(12) << "distance" << std::setw(14) << "registers"
+     << std::setw(8) << "cum%" << std::setw(14) << "memory" << std::setw(8)
+     << "cum%" << std::endl;
+  uint64_t total_reg = 0;
+  uint64_t total_mem = 0;
+  for (size_t i = 0; i < n_buckets; ++i) {
+    total_reg += reg_distances[i];
+    total_mem += mem_distances[i];
+  }
+  uint64_t cum_reg = 0;
+  uint64_t cum_mem = 0;
+  for (size_t i = 0; i < n_buckets; ++i) {
+    if (reg_distances[i] == 0 && mem_distances[i] == 0) {
+      continue;
+    }
+    cum_reg += reg_distances[i];
+    cum_mem += mem_distances[i];
+    uint64_t low = uint64_t{1} << i;
+    std::string range = std::to_string(low);
+    if (i == n_buckets - 1) {
+      range += "+";
+    } else if (low != 1) {
+      range += "-" + std::to_string(2 * low - 1);
+    }
+    os << std::setw(12) << range << std::setw(14) << reg_distances[i]
+       << std::setw(8) << 100.0 * cum_reg / std::max<uint64_t>(total_reg, 1)
+       << std::setw(14) << mem_distances[i] << std::setw(8)
+       << 100.0 * cum_mem / std::max<uint64_t>(total_mem, 1) << std::endl;
+  }
+  os << std::defaultfloat;
+}
+
+} // namespace libcpu
+
+#endif
@@ -7,8 +7,10 @@
 #include <iostream>
 #include <libcpu/abstract_cpu.hh>
 #include <libcpu/event.hh>
+#include <libvio/phase.hh>
 #include <libvio/ringbuffer.hh>
 #include <libvio/width.hh>
+#include <memory>
 #include <ostream>
 #include <vector>
 
@@ -99,6 +101,30 @@ public:
   virtual std::optional<WORD_T> get_trap(void) const override {
     return ref->get_trap();
   }
+
+  virtual std::unique_ptr<typename cpu_t::state_t>
+  save_state(void) const override {
+    auto state = std::make_unique<saved_state_t>();
+    state->dut = dut->save_state();
+    state->ref = ref->save_state();
+    if (state->dut == nullptr || state->ref == nullptr) {
+      return nullptr;
+    }
+    return state;
+  }
+
+  virtual bool restore_state(const typename cpu_t::state_t &state) override {
+    auto saved = dynamic_cast<const saved_state_t *>(&state);
+    return saved != nullptr && dut->restore_state(*saved->dut) &&
+           ref->restore_state(*saved->ref);
+  }
+
+protected:
+  /// The states of both CPUs
+  struct saved_state_t : cpu_t::state_t {
+    std::unique_ptr<typename cpu_t::state_t> dut;
+    std::unique_ptr<typename cpu_t::state_t> ref;
+  };
 };
 
 /**
@@ -125,9 +151,31 @@ private:
 public:
   bool get_difftest_error(void) const override { return difftest_error; }
 
+  /**
+   * @brief Restore the states of both CPUs
+   *
+   * Events logged before the restore are not compared again, and the
+   * difftest error is cleared.
+   */
+  bool restore_state(const typename abstract_cpu<WORD_T>::state_t &state)
+      override {
+    if (!abstract_difftest<WORD_T>::restore_state(state)) {
+      return false;
+    }
+    if (this->dut->event_buffer != nullptr) {
+      dut_buffer_index = this->dut->event_buffer->lastindex();
+    }
+    if (this->ref->event_buffer != nullptr) {
+      ref_buffer_index = this->ref->event_buffer->lastindex();
+    }
+    difftest_error = false;
+    return true;
+  }
+
   void next_instruction(void) override { next_cycle(); }
 
   void next_cycle(void) override {
+    LIBVIO_PHASE(difftest);
     // panic if all the event buffers are not available
     if (this->dut->event_buffer == nullptr ||
         this->ref->event_buffer == nullptr) {
@@ -158,14 +206,21 @@ public:
     // step the DUT for a cycle
     // zero or one or multiple instructions can be committed
     std::vector<event_t<WORD_T>> dut_events{};
-    this->dut->next_cycle();
+    {
+      // a DUT not timing itself is counted as CPU time
+      LIBVIO_PHASE(cpu);
+      this->dut->next_cycle();
+    }
     // record the events of DUT
     dut_buffer_index =
         pull_events(dut_events, this->dut->event_buffer, dut_buffer_index);
     // step the ref
     std::vector<event_t<WORD_T>> ref_events{};
     while (ref_events.size() < dut_events.size() && !this->ref->stopped()) {
-      this->ref->next_instruction();
+      {
+        LIBVIO_PHASE(cpu);
+        this->ref->next_instruction();
+      }
       // record the events of REF
       ref_buffer_index =
           pull_events(ref_events, this->ref->event_buffer, ref_buffer_index);
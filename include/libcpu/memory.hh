@@ -8,9 +8,12 @@
 #include <memory>
 #include <optional>
 #include <ostream>
+#include <vector>
 
 namespace libcpu {
 
+class memory_journal;
+
 /**
  * @brief Abstract base class representing a view into memory.
  *
@@ -63,6 +66,43 @@ public:
    */
   uint8_t *host_addr(uint64_t addr);
 
+  /**
+   * @brief Get a direct pointer to a contiguous range of host memory.
+   *
+   * This is meant for burst transfers, e.g. DMA from a device into guest RAM
+   * with `libvio::io_agent::read_burst()`.
+   *
+   * @param addr Starting memory address of the range
+   * @param len Size of the range in bytes
+   * @return Pointer to host memory at the specified address,
+   *                  or nullptr if any part of the range is invalid
+   */
+  uint8_t *host_addr(uint64_t addr, uint64_t len);
+
+  /**
+   * @brief Read a contiguous range of memory.
+   *
+   * @param addr Starting memory address of the range
+   * @param data Destination buffer of at least `len` bytes
+   * @param len Size of the range in bytes
+   * @return true if read succeeded, false if any part of the range is invalid
+   */
+  bool read_burst(uint64_t addr, uint8_t *data, uint64_t len);
+
+  /**
+   * @brief Write a contiguous range of memory.
+   *
+   * Unlike a copy through `host_addr()`, the write is journaled, so this is
+   * the way for DMA to write the memory, e.g. from
+   * `libvio::io_agent::dma_write_handler`.
+   *
+   * @param addr Starting memory address of the range
+   * @param data Source buffer of at least `len` bytes
+   * @param len Size of the range in bytes
+   * @return true if write succeeded, false if any part of the range is invalid
+   */
+  bool write_burst(uint64_t addr, const uint8_t *data, uint64_t len);
+
   /**
    * @brief Save memory contents to a file.
    *
@@ -126,10 +166,13 @@ public:
    */
   bool out_of_bound(uint64_t addr, libvio::width_t width) const;
 
+  friend class memory_journal;
+
 protected:
   uint8_t *mem_ptr; ///< Pointer to the memory storage
   uint64_t base;    ///< Base address of the memory region
   uint64_t size;    ///< Size of the memory region in bytes
+  memory_journal *journal = nullptr; ///< Journal of writes, may be nullptr
 
   /**
    * @brief Protected default constructor for derived classes.
@@ -157,6 +200,102 @@ protected:
   std::unique_ptr<uint8_t[]> mem; ///< Contiguous memory storage
 };
 
+/**
+ * @brief Records the content of memory pages before they are written.
+ *
+ * The journal is divided into epochs. The first `write()` to a page in an
+ * epoch copies the page before it is modified, later writes to the page in
+ * the same epoch cost a bit test. Undoing the pages of an epoch brings the
+ * memory back to its content at the beginning of the epoch, so a series of
+ * epochs forms a history of memory snapshots holding only the dirty pages.
+ *
+ * Only writes through `memory_view::write()` and `memory_view::write_burst()`
+ * of the journaled view are recorded. Writes through host pointers are not.
+ */
+class memory_journal {
+public:
+  static constexpr unsigned page_shift = 12; ///< 4 KiB pages
+  static constexpr uint64_t page_size = uint64_t(1) << page_shift;
+
+  /**
+   * @struct page_t
+   * @brief A page saved before its first write in an epoch
+   */
+  struct page_t {
+    uint64_t offset; ///< Offset of the page in the memory view
+    std::unique_ptr<uint8_t[]> data; ///< Content before the first write
+  };
+
+  /**
+   * @brief Start journaling the writes to a memory view
+   * @param mem The memory view, must outlive the journal and have no other
+   * journal attached
+   */
+  explicit memory_journal(memory_view &mem);
+
+  /**
+   * @brief Stop journaling the writes to the memory view
+   */
+  ~memory_journal();
+
+  memory_journal(const memory_journal &) = delete;
+  memory_journal &operator=(const memory_journal &) = delete;
+
+  /**
+   * @brief Save the pages of a range not saved in the current epoch yet
+   * @param offset Offset of the range in the memory view
+   * @param len Length of the range in bytes, must not be 0
+   */
+  void record(uint64_t offset, uint64_t len) {
+    uint64_t first = offset >> page_shift;
+    uint64_t last = (offset + len - 1) >> page_shift;
+    // a range over more than one page may have unsaved pages in the middle
+    if (first != last || !test(first)) {
+      save(first, last);
+    }
+  }
+
+  /**
+   * @brief End the current epoch and start a new one
+   * @return The pages saved in the ended epoch
+   */
+  std::vector<page_t> take(void);
+
+  /**
+   * @brief Write saved pages back to the memory
+   * @param pages Pages saved in an epoch, usually from `take()`
+   * @note Epochs must be undone from the latest to the earliest.
+   */
+  void undo(const std::vector<page_t> &pages);
+
+  /**
+   * @brief Get the number of pages saved in the current epoch
+   * @return size_t Number of pages
+   */
+  size_t size(void) const { return pages.size(); }
+
+private:
+  memory_view &mem;            ///< The journaled memory view
+  std::vector<uint64_t> saved; ///< Bit per page saved in the current epoch
+  std::vector<page_t> pages;   ///< Pages saved in the current epoch
+
+  /**
+   * @brief Check whether a page is saved in the current epoch
+   * @param page Page number in the memory view
+   * @return true if the page is saved
+   */
+  bool test(uint64_t page) const {
+    return (saved[page / 64] >> (page % 64)) & 1;
+  }
+
+  /**
+   * @brief Save the unsaved pages of a range of pages
+   * @param first First page number
+   * @param last Last page number
+   */
+  void save(uint64_t first, uint64_t last);
+};
+
 } // namespace libcpu
 
 #endif
@@ -0,0 +1,324 @@
+#ifndef LIBCPU_PROFILER_HH
+#define LIBCPU_PROFILER_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <libcpu/symbols.hh>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief A function-level profiler counting instructions per call stack.
+ *
+ * The CPU reports calls, returns, traps and trap returns as they retire, and
+ * calls `retire()` for every instruction. The profiler maintains a shadow
+ * call stack from them. Every distinct call stack is a node of a calling
+ * context tree, and the instructions retired while a node is on top of the
+ * stack are its exclusive count. Counts are attributed on calls and returns
+ * only, so profiling costs an increment per instruction and a walk of the
+ * children of the current node per call.
+ *
+ * A return pops the frames down to the call whose return address it jumps
+ * to, so `longjmp()` and similar unwinding keep the stack consistent. A
+ * return to an unknown address pops one frame. A trap return pops the
+ * frames down to the latest trap.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class call_profiler {
+public:
+  /// Deepest call stack tracked, deeper calls are counted in their caller
+  static constexpr size_t max_depth = 1024;
+
+  /**
+   * @struct node_t
+   * @brief A call stack in the calling context tree
+   */
+  struct node_t {
+    WORD_T func;     ///< Entry address of the function on top
+    uint32_t parent; ///< Index of the caller stack, the root is its own parent
+    uint32_t child;  ///< Index of the first callee stack, 0 if none
+    uint32_t next;   ///< Index of the next stack with the same caller, or 0
+    bool trap;       ///< Whether the function on top is a trap handler
+    uint64_t calls;  ///< Number of times the stack was entered
+    uint64_t self;   ///< Instructions retired with the stack on top
+  };
+
+  /**
+   * @struct function_t
+   * @brief Instruction counts of a function over all its call stacks
+   */
+  struct function_t {
+    std::string name;   ///< Symbol name or entry address of the function
+    uint64_t calls;     ///< Number of calls
+    uint64_t inclusive; ///< Instructions retired in it and its callees
+    uint64_t exclusive; ///< Instructions retired in it
+  };
+
+  /**
+   * @brief Start profiling inside a function
+   * @param entry An address in the function executing when profiling starts
+   */
+  explicit call_profiler(WORD_T entry) {
+    nodes.push_back({entry, 0, 0, 0, false, 1, 0});
+  }
+
+  /**
+   * @brief Count a retired instruction
+   */
+  void retire(void) { ++instructions; }
+
+  /**
+   * @brief Push a function called by the retired instruction
+   * @param target Entry address of the callee
+   * @param return_addr Address the callee returns to
+   */
+  void call(WORD_T target, WORD_T return_addr) {
+    enter(target, return_addr, false);
+  }
+
+  /**
+   * @brief Pop the functions returned from by the retired instruction
+   * @param target Address returned to
+   */
+  void ret(WORD_T target) {
+    if (overflow != 0) {
+      --overflow;
+      return;
+    }
+    attribute();
+    // search down to the latest trap, a return never leaves a handler
+    size_t i = frames.size();
+    while (i > 0 && !frames[i - 1].trap &&
+           frames[i - 1].return_addr != target) {
+      --i;
+    }
+    if (i > 0 && !frames[i - 1].trap) {
+      frames.resize(i - 1);
+    } else if (!frames.empty() && !frames.back().trap) {
+      frames.pop_back();
+    }
+    current = frames.empty() ? 0 : frames.back().node;
+  }
+
+  /**
+   * @brief Push a trap handler entered after the retired instruction
+   * @param handler Address of the handler
+   */
+  void trap(WORD_T handler) { enter(handler, 0, true); }
+
+  /**
+   * @brief Pop the functions down to and including the latest trap handler
+   */
+  void trap_ret(void) {
+    attribute();
+    overflow = 0;
+    size_t i = frames.size();
+    while (i > 0 && !frames[i - 1].trap) {
+      --i;
+    }
+    if (i > 0) {
+      frames.resize(i - 1);
+    }
+    current = frames.empty() ? 0 : frames.back().node;
+  }
+
+  /**
+   * @brief Get the number of instructions retired since profiling started
+   * @return uint64_t Number of instructions
+   */
+  uint64_t total(void) const { return instructions; }
+
+  /**
+   * @brief Get the depth of the shadow call stack
+   * @return size_t Number of calls and traps on the stack
+   */
+  size_t depth(void) const { return frames.size() + overflow; }
+
+  /**
+   * @brief Get the calling context tree
+   * @return The nodes, the root first and callers before callees
+   */
+  const std::vector<node_t> &tree(void) {
+    attribute();
+    return nodes;
+  }
+
+  /**
+   * @brief Sum the instruction counts per function
+   *
+   * Recursive calls are counted once in the inclusive count of a function.
+   *
+   * @param symbols Symbols naming the functions
+   * @return The functions by decreasing inclusive count
+   */
+  std::vector<function_t> functions(const symbol_table &symbols);
+
+  /**
+   * @brief Write the call stacks in the folded format of flame graph tools
+   *
+   * Each line is a call stack from the root, with frames separated by `;`,
+   * followed by a space and its exclusive instruction count. Trap handlers
+   * are marked with a `_[trap]` suffix.
+   *
+   * @param os Output stream
+   * @param symbols Symbols naming the functions
+   */
+  void write_folded(std::ostream &os, const symbol_table &symbols);
+
+private:
+  /**
+   * @struct frame_t
+   * @brief A call or trap on the shadow stack
+   */
+  struct frame_t {
+    uint32_t node;      ///< Node of the stack with this frame on top
+    bool trap;          ///< Whether the frame is a trap handler
+    WORD_T return_addr; ///< Address the call returns to
+  };
+
+  std::vector<node_t> nodes;   ///< Calling context tree
+  std::vector<frame_t> frames; ///< Shadow call stack, the root not included
+  uint32_t current = 0;        ///< Node of the current stack
+  size_t overflow = 0;         ///< Calls not pushed beyond `max_depth`
+  uint64_t instructions = 0;   ///< Instructions retired
+  uint64_t attributed = 0;     ///< Instructions attributed to the nodes
+
+  /**
+   * @brief Attribute the instructions since the last call or return to the
+   * current stack
+   */
+  void attribute(void) {
+    nodes[current].self += instructions - attributed;
+    attributed = instructions;
+  }
+
+  /**
+   * @brief Push a function on the shadow stack
+   * @param func Entry address of the function
+   * @param return_addr Address the function returns to
+   * @param trap Whether the function is a trap handler
+   */
+  void enter(WORD_T func, WORD_T return_addr, bool trap);
+
+  /**
+   * @brief Get the name of a node in reports
+   * @param node The node
+   * @param symbols Symbols naming the functions
+   * @return The name
+   */
+  static std::string node_name(const node_t &node,
+                               const symbol_table &symbols);
+};
+
+template <typename WORD_T>
+void call_profiler<WORD_T>::enter(WORD_T func, WORD_T return_addr, bool trap) {
+  if (frames.size() >= max_depth) {
+    ++overflow;
+    return;
+  }
+  attribute();
+  // the callee of the last call from a stack is moved to the front of its
+  // list, so loops calling the same functions find them first
+  uint32_t prev = 0;
+  uint32_t node = nodes[current].child;
+  while (node != 0 && (nodes[node].func != func || nodes[node].trap != trap)) {
+    prev = node;
+    node = nodes[node].next;
+  }
+  if (node == 0) {
+    node = nodes.size();
+    nodes.push_back({func, current, 0, nodes[current].child, trap, 0, 0});
+    nodes[current].child = node;
+  } else if (prev != 0) {
+    nodes[prev].next = nodes[node].next;
+    nodes[node].next = nodes[current].child;
+    nodes[current].child = node;
+  }
+  ++nodes[node].calls;
+  frames.push_back({node, trap, return_addr});
+  current = node;
+}
+
+template <typename WORD_T>
+std::vector<typename call_profiler<WORD_T>::function_t>
+call_profiler<WORD_T>::functions(const symbol_table &symbols) {
+  attribute();
+  std::vector<std::string> names(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    names[i] = node_name(nodes[i], symbols);
+  }
+  // callees come after their callers, so a reverse pass sums the subtrees
+  std::vector<uint64_t> inclusive(nodes.size());
+  for (size_t i = nodes.size(); i-- > 0;) {
+    inclusive[i] += nodes[i].self;
+    if (i != 0) {
+      inclusive[nodes[i].parent] += inclusive[i];
+    }
+  }
+  std::vector<function_t> result;
+  std::unordered_map<std::string, size_t> index;
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto [pos, inserted] = index.try_emplace(names[i], result.size());
+    if (inserted) {
+      result.push_back({names[i], 0, 0, 0});
+    }
+    function_t *it = &result[pos->second];
+    it->calls += nodes[i].calls;
+    it->exclusive += nodes[i].self;
+    // a recursive call is already included in the outermost call
+    bool recursive = false;
+    for (size_t j = i; j != 0 && !recursive;) {
+      j = nodes[j].parent;
+      recursive = names[j] == names[i];
+    }
+    if (!recursive) {
+      it->inclusive += inclusive[i];
+    }
+  }
+  std::stable_sort(result.begin(), result.end(),
+                   [](const function_t &a, const function_t &b) {
+                     return a.inclusive > b.inclusive;
+                   });
+  return result;
+}
+
+template <typename WORD_T>
+void call_profiler<WORD_T>::write_folded(std::ostream &os,
+                                         const symbol_table &symbols) {
+  attribute();
+  std::vector<std::string> stacks(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    std::string name = node_name(nodes[i], symbols);
+    // `;` separates frames and the count follows the last space
+    std::replace(name.begin(), name.end(), ';', ':');
+    std::replace(name.begin(), name.end(), ' ', '_');
+    if (nodes[i].trap) {
+      name += "_[trap]";
+    }
+    stacks[i] = i == 0 ? name : stacks[nodes[i].parent] + ";" + name;
+    if (nodes[i].self != 0) {
+      os << stacks[i] << ' ' << std::dec << nodes[i].self << '\n';
+    }
+  }
+  os.flush();
+}
+
+template <typename WORD_T>
+std::string call_profiler<WORD_T>::node_name(const node_t &node,
+                                             const symbol_table &symbols) {
+  const symbol_table::symbol_t *sym = symbols.lookup(node.func);
+  if (sym != nullptr) {
+    return sym->name;
+  }
+  return symbols.name(node.func);
+}
+
+} // namespace libcpu
+
+#endif
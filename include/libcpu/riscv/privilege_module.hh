@@ -9,7 +9,9 @@
 #include <libcpu/riscv/riscv.hh>
 #include <libcpu/riscv/user_core.hh>
 #include <libvio/bus.hh>
+#include <libvio/phase.hh>
 #include <optional>
+#include <vector>
 
 namespace libcpu::riscv {
 
@@ -48,6 +50,8 @@ public:
 
   memory_view *mem_bus;
   libvio::io_agent *mmio_bus;
+  /// Device memory of `mmio_bus` accessed directly, without the agent
+  std::vector<libvio::host_range_t> host_ranges;
 
   struct {
     priv_level_t mpp;
@@ -146,6 +150,29 @@ public:
    */
   void vaddr_store(exec_result_t &op);
 
+  /**
+   * @brief Load from a device, out of RAM
+   *
+   * Accesses inside `host_ranges` are served directly, others go through
+   * `mmio_bus`.
+   *
+   * @param paddr Physical address
+   * @param width Width of the access
+   * @return std::optional<uint64_t> The zero extended value, or nullopt on
+   * failure
+   */
+  std::optional<uint64_t> device_read(uint64_t paddr, libvio::width_t width);
+
+  /**
+   * @brief Store to a device, out of RAM
+   * @param paddr Physical address
+   * @param width Width of the access
+   * @param data Data to store
+   * @return true if successful
+   * @see device_read()
+   */
+  bool device_write(uint64_t paddr, libvio::width_t width, WORD_T data);
+
   /**
    * @brief Reset privilege module
    *
@@ -163,6 +190,16 @@ public:
    */
   void raise_interrupt(WORD_T cause);
 
+  /**
+   * @brief Clear an interrupt
+   *
+   * Clears the interrupt pending bits of `cause`, e.g. when a level-sensitive
+   * interrupt source is deasserted.
+   *
+   * @param cause Interrupt cause code
+   */
+  void clear_interrupt(WORD_T cause);
+
   /**
    * @brief Handle exception
    *
@@ -252,6 +289,7 @@ privilege_module<WORD_T>::vaddr_to_paddr(WORD_T vaddr) const {
 template <typename WORD_T>
 void privilege_module<WORD_T>::paddr_fetch_instruction(
     exec_result_t &op) const {
+  LIBVIO_PHASE(fetch);
   WORD_T paddr = op.pc;
   std::optional<uint32_t> instr_opt =
       mem_bus->read(paddr, libvio::width_t::word);
@@ -270,6 +308,7 @@ void privilege_module<WORD_T>::paddr_fetch_instruction(
 template <typename WORD_T>
 void privilege_module<WORD_T>::vaddr_fetch_instruction(
     exec_result_t &op) const {
+  LIBVIO_PHASE(fetch);
   WORD_T vaddr = op.pc;
   std::optional<WORD_T> paddr_opt = vaddr_to_paddr(op.load.addr);
   if (paddr_opt.has_value()) {
@@ -295,14 +334,42 @@ void privilege_module<WORD_T>::vaddr_fetch_instruction(
   }
 }
 
+template <typename WORD_T>
+std::optional<uint64_t>
+privilege_module<WORD_T>::device_read(uint64_t paddr, libvio::width_t width) {
+  for (const auto &range : host_ranges) {
+    if (range.contains(paddr, static_cast<uint64_t>(width))) {
+      return range.load(paddr, width);
+    }
+  }
+  if (mmio_bus == nullptr) {
+    return std::nullopt;
+  }
+  return mmio_bus->read(paddr, width);
+}
+
+template <typename WORD_T>
+bool privilege_module<WORD_T>::device_write(uint64_t paddr,
+                                            libvio::width_t width,
+                                            WORD_T data) {
+  for (auto &range : host_ranges) {
+    if (range.contains(paddr, static_cast<uint64_t>(width))) {
+      range.store(paddr, width, data);
+      return true;
+    }
+  }
+  return mmio_bus != nullptr && mmio_bus->write(paddr, width, data);
+}
+
 template <typename WORD_T>
 void privilege_module<WORD_T>::paddr_load(exec_result_t &op) {
+  LIBVIO_PHASE(memory);
   assert(op.type == exec_result_type_t::load);
   auto [paddr, width, sign_extend, rd] = op.load;
   std::optional<uint64_t> data_opt = mem_bus->read(paddr, width);
   // fall back to MMIO if the address is out of RAM
-  if (!data_opt.has_value() && mmio_bus != nullptr) {
-    data_opt = mmio_bus->read(paddr, width);
+  if (!data_opt.has_value()) {
+    data_opt = device_read(paddr, width);
   }
   if (data_opt.has_value()) {
     // `data` is zero extended
@@ -326,12 +393,13 @@ void privilege_module<WORD_T>::paddr_load(exec_result_t &op) {
 
 template <typename WORD_T>
 void privilege_module<WORD_T>::paddr_store(exec_result_t &op) {
+  LIBVIO_PHASE(memory);
   assert(op.type == exec_result_type_t::store);
   auto [paddr, width, data] = op.store;
   bool success = mem_bus->write(paddr, width, data);
   // fall back to MMIO
-  if (!success && mmio_bus != nullptr) {
-    success = mmio_bus->write(paddr, width, data);
+  if (!success) {
+    success = device_write(paddr, width, data);
   }
   if (success) {
     op.type = exec_result_type_t::retire;
@@ -351,6 +419,7 @@ void privilege_module<WORD_T>::paddr_store(exec_result_t &op) {
 
 template <typename WORD_T>
 void privilege_module<WORD_T>::vaddr_load(exec_result_t &op) {
+  LIBVIO_PHASE(memory);
   assert(op.type == exec_result_type_t::load);
   auto [vaddr, width, sign_extend, rd] = op.load;
   std::optional<uint64_t> paddr_opt = vaddr_to_paddr(op.load.addr);
@@ -358,8 +427,8 @@ void privilege_module<WORD_T>::vaddr_load(exec_result_t &op) {
     uint64_t paddr = paddr_opt.value();
     std::optional<uint64_t> data_opt = mem_bus->read(paddr, width);
     // fall back to MMIO if the address is out of RAM
-    if (!data_opt.has_value() && mmio_bus != nullptr) {
-      data_opt = mmio_bus->read(paddr, width);
+    if (!data_opt.has_value()) {
+      data_opt = device_read(paddr, width);
     }
     if (data_opt.has_value()) {
       // `data` is zero extended
@@ -390,6 +459,7 @@ void privilege_module<WORD_T>::vaddr_load(exec_result_t &op) {
 
 template <typename WORD_T>
 void privilege_module<WORD_T>::vaddr_store(exec_result_t &op) {
+  LIBVIO_PHASE(memory);
   assert(op.type == exec_result_type_t::store);
   auto [vaddr, width, data] = op.store;
   std::optional<uint64_t> paddr_opt = vaddr_to_paddr(vaddr);
@@ -397,8 +467,8 @@ void privilege_module<WORD_T>::vaddr_store(exec_result_t &op) {
     uint64_t paddr = paddr_opt.value();
     bool success = mem_bus->write(paddr, width, data);
     // fall back to MMIO
-    if (!success && mmio_bus != nullptr) {
-      success = mmio_bus->write(paddr, width, data);
+    if (!success) {
+      success = device_write(paddr, width, data);
     }
     if (success) {
       op.type = exec_result_type_t::retire;
@@ -433,28 +503,35 @@ void privilege_module<WORD_T>::raise_interrupt(WORD_T cause) {
   }
 }
 
+template <typename WORD_T>
+void privilege_module<WORD_T>::clear_interrupt(WORD_T cause) {
+  WORD_T cause_mask = 1 << (cause & ~riscv::mcause<WORD_T>::intr_mask);
+  sip &= ~cause_mask;
+  mip &= ~cause_mask;
+}
+
 template <typename WORD_T>
 void privilege_module<WORD_T>::handle_interrupt(exec_result_t &op) {
   constexpr size_t word_size = sizeof(WORD_T) * CHAR_BIT;
 
   assert(op.type == exec_result_type_t::retire);
   WORD_T pc = op.next_pc;
-  priv_level_t target_priv_level;
-  WORD_T cause;
+  // the pending set is not empty, so a cause is always found
+  priv_level_t target_priv_level = priv_level_t::m;
+  WORD_T cause = 0;
 
   if ((mie & mip) && (status.mie || priv_level != priv_level_t::m)) {
     for (size_t i = 0; i < word_size; ++i) {
       if (((mie & mip) >> i) & 1) {
-        target_priv_level = priv_level_t::m;
         cause = i;
         break;
       }
     }
   } else if ((sie & sip) && priv_level != priv_level_t::m &&
              (status.sie || priv_level == priv_level_t::u)) {
+    target_priv_level = priv_level_t::s;
     for (size_t i = 0; i < word_size; ++i) {
       if (((sie & sip) >> i) & 1) {
-        target_priv_level = priv_level_t::s;
         cause = i;
         break;
       }
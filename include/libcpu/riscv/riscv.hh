@@ -92,6 +92,52 @@ inline constexpr uint_fast8_t gpr_addr(const char *name) {
   return 0;
 }
 
+/**
+ * @brief Get the general purpose registers read by an instruction
+ *
+ * Only the major opcode and `funct3` are looked at, so invalid instructions
+ * may report registers too. `x0` is never reported.
+ *
+ * @tparam WORD_T The word type of the CPU, as in `event_t`
+ * @param instr The instruction word
+ * @param regs Output, at least 2 entries
+ * @return Number of registers written to `regs`
+ */
+template <typename WORD_T>
+inline constexpr unsigned source_gprs(WORD_T instr, uint8_t *regs) {
+  uint8_t rs1 = (instr >> 15) & 0x1f;
+  uint8_t rs2 = (instr >> 20) & 0x1f;
+  bool use_rs1 = false;
+  bool use_rs2 = false;
+  switch (instr & 0x7f) {
+  case 0x33: // OP
+  case 0x3b: // OP-32
+  case 0x23: // STORE
+  case 0x63: // BRANCH
+    use_rs1 = use_rs2 = true;
+    break;
+  case 0x13: // OP-IMM
+  case 0x1b: // OP-IMM-32
+  case 0x03: // LOAD
+  case 0x67: // JALR
+    use_rs1 = true;
+    break;
+  case 0x73: // SYSTEM, only csrrw, csrrs and csrrc read a register
+    use_rs1 = ((instr >> 12) & 0x7) >= 1 && ((instr >> 12) & 0x7) <= 3;
+    break;
+  default:
+    break;
+  }
+  unsigned n = 0;
+  if (use_rs1 && rs1 != 0) {
+    regs[n++] = rs1;
+  }
+  if (use_rs2 && rs2 != 0 && rs2 != rs1) {
+    regs[n++] = rs2;
+  }
+  return n;
+}
+
 /**
  * @brief Control and Status Register (CSR) addresses
  *
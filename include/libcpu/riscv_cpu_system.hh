@@ -1,11 +1,17 @@
 #ifndef LIBCPU_RISCV_CPU_SYSYTEM_HH
 #define LIBCPU_RISCV_CPU_SYSYTEM_HH
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <libcpu/abstract_cpu.hh>
+#include <libcpu/breakpoint.hh>
 #include <libcpu/riscv/privilege_module.hh>
 #include <libcpu/riscv/riscv.hh>
 #include <libcpu/riscv/user_core.hh>
+#include <libvio/phase.hh>
+#include <memory>
+#include <utility>
 
 namespace libcpu {
 
@@ -17,6 +23,15 @@ public:
   using exec_result_type_t = riscv::exec_result_type_t;
   using exec_result_t = riscv::exec_result_t<WORD_T>;
 
+  /// MMIO interrupt line raising the machine external interrupt
+  static constexpr unsigned irq_line_m_external = 0;
+  /// MMIO interrupt line raising the supervisor external interrupt
+  static constexpr unsigned irq_line_s_external = 1;
+  /// Instructions between two interrupt polls of `mmio_bus`, counted the same
+  /// way on every CPU, so the CPUs of a differential test poll at the same
+  /// points
+  static constexpr uint32_t irq_poll_interval = 1024;
+
   virtual uint8_t n_gpr(void) const override;
   virtual const char *gpr_name(uint8_t addr) const override;
   virtual uint8_t gpr_addr(const char *name) const override;
@@ -26,8 +41,14 @@ public:
   virtual WORD_T get_gpr(uint8_t addr) const override;
   virtual void next_cycle(void) override;
   virtual void next_instruction(void) override;
+  virtual size_t
+  run(size_t n, const breakpoint_set<WORD_T> *breakpoints) override;
   virtual bool stopped(void) const override;
   virtual std::optional<WORD_T> get_trap(void) const override;
+  virtual std::unique_ptr<typename abstract_cpu<WORD_T>::state_t>
+  save_state(void) const override;
+  virtual bool
+  restore_state(const typename abstract_cpu<WORD_T>::state_t &state) override;
 
 private:
   exec_result_t exec_result;
@@ -35,6 +56,55 @@ private:
   riscv::privilege_module<WORD_T> privilege_module;
   std::optional<WORD_T> last_trap;
   bool is_stopped;
+  uint32_t irq_poll_countdown; ///< Instructions until the next interrupt poll
+
+  /**
+   * @enum link_t
+   * @brief Control transfers of `jal` and `jalr` by their link registers
+   */
+  enum class link_t : uint8_t {
+    none,    ///< Plain jump
+    call,    ///< Function call
+    ret,     ///< Function return
+    ret_call ///< Return followed by a call, e.g. a coroutine switch
+  };
+
+  /**
+   * @brief Classify a decoded instruction by the link register hints
+   *
+   * `ra` and `t0` are link registers. Writing one is a call, jumping through
+   * one without writing it is a return, as in the return address stack hints
+   * of the RISC-V unprivileged specification.
+   *
+   * @param decode The decoded instruction
+   * @return link_t How the instruction transfers control
+   */
+  static link_t link_hint(const decode_t &decode);
+
+  /**
+   * @brief Report an executed call or return to the tracer and the profiler
+   * @param link How the instruction transfers control, not `link_t::none`
+   */
+  void trace_link(link_t link);
+
+  /**
+   * @brief Execute instructions as `run()` does, without sampling
+   * @param n The maximum number of instructions to execute
+   * @param breakpoints Breakpoints checked after each instruction, may be
+   * `nullptr`
+   * @return size_t The number of instructions executed
+   */
+  size_t run_loop(size_t n, const breakpoint_set<WORD_T> *breakpoints);
+
+  /// The whole state is plain data, so it is saved by copying the members
+  struct saved_state_t : abstract_cpu<WORD_T>::state_t {
+    exec_result_t exec_result;
+    riscv::user_core<WORD_T> user_core;
+    riscv::privilege_module<WORD_T> privilege_module;
+    std::optional<WORD_T> last_trap;
+    bool is_stopped;
+    uint32_t irq_poll_countdown;
+  };
 };
 
 template <typename WORD_T> uint8_t riscv_cpu_system<WORD_T>::n_gpr(void) const {
@@ -55,11 +125,44 @@ template <typename WORD_T>
 void riscv_cpu_system<WORD_T>::reset(WORD_T init_pc) {
   privilege_module.mem_bus = this->mem_bus;
   privilege_module.mmio_bus = this->mmio_bus;
+  privilege_module.host_ranges.clear();
+  if (this->mmio_bus != nullptr) {
+    privilege_module.host_ranges = this->mmio_bus->host_ranges();
+  }
   user_core.reset();
   privilege_module.reset();
+  if (this->mmio_bus != nullptr) {
+    this->mmio_bus->irq_handler = [this](uint64_t lines) {
+      // the lines are level-sensitive, so each change sets or clears both
+      for (auto [line, cause] :
+           {std::pair{irq_line_m_external,
+                      riscv::mcause<WORD_T>::intr_m_external},
+            std::pair{irq_line_s_external,
+                      riscv::mcause<WORD_T>::intr_s_external}}) {
+        if ((lines >> line) & 1) {
+          privilege_module.raise_interrupt(cause);
+        } else {
+          privilege_module.clear_interrupt(cause);
+        }
+      }
+    };
+    // DMA goes to physical memory, journaled like the stores of the CPU
+    this->mmio_bus->dma_write_handler = [this](uint64_t addr,
+                                               const uint8_t *data,
+                                               size_t len) {
+      return this->mem_bus != nullptr &&
+             this->mem_bus->write_burst(addr, data, len);
+    };
+    this->mmio_bus->dma_read_handler = [this](uint64_t addr, uint8_t *data,
+                                              size_t len) {
+      return this->mem_bus != nullptr &&
+             this->mem_bus->read_burst(addr, data, len);
+    };
+  }
   exec_result.pc = init_pc;
   last_trap = std::nullopt;
   is_stopped = false;
+  irq_poll_countdown = irq_poll_interval;
 }
 
 template <typename WORD_T> WORD_T riscv_cpu_system<WORD_T>::get_pc(void) const {
@@ -82,50 +185,90 @@ template <typename WORD_T> void riscv_cpu_system<WORD_T>::next_cycle(void) {
 
 template <typename WORD_T>
 void riscv_cpu_system<WORD_T>::next_instruction(void) {
+  LIBVIO_PHASE(cpu);
+  // polled periodically, so that a completion of an asynchronous device
+  // reaches a CPU spinning without MMIO, the interrupt is taken after this
+  // instruction retires
+  if (--irq_poll_countdown == 0) {
+    irq_poll_countdown = irq_poll_interval;
+    if (this->mmio_bus != nullptr) {
+      this->mmio_bus->poll_irq();
+    }
+  }
+  // counted first, so calls and traps are counted in the function issuing them
+  if (this->profiler != nullptr) {
+    this->profiler->retire();
+  }
+  // whether the instruction ends a basic block, for the coverage map: set for
+  // jumps and branches at decode, and for trap entries, taken interrupts and
+  // trap returns once they are handled and the next PC is known
+  bool edge = false;
   privilege_module.paddr_fetch_instruction(exec_result);
 
   if (exec_result.type == exec_result_type_t::fetch) {
     if (this->event_buffer != nullptr) {
+      LIBVIO_PHASE(trace);
       this->event_buffer->push_back({.type = event_type_t::issue,
                                      .pc = exec_result.pc,
                                      .val1 = exec_result.instr,
                                      .val2 = 0});
     }
+    LIBVIO_PHASE(decode);
     riscv::user_core<WORD_T>::decode(exec_result);
   }
 
   if (exec_result.type == exec_result_type_t::decode) {
-    user_core.execute(exec_result);
+    // the decoded fields are overwritten by the execution
+    link_t link = link_t::none;
+    if (this->event_buffer != nullptr || this->profiler != nullptr) {
+      link = link_hint(exec_result.decode);
+    }
+    if (this->coverage != nullptr) {
+      // jumps and branches end a block whether taken or not
+      dispatch_t dispatch = exec_result.decode.dispatch;
+      edge = dispatch >= dispatch_t::jal && dispatch <= dispatch_t::bgeu;
+    }
+    {
+      LIBVIO_PHASE(execute);
+      user_core.execute(exec_result);
+    }
+    if (link != link_t::none) {
+      trace_link(link);
+    }
   }
 
   // Do privileged operations
   if (exec_result.type == exec_result_type_t::load) {
-    if (this->event_buffer != nullptr) {
-      auto [addr, width, sign_extend, rd] = exec_result.load;
-      privilege_module.paddr_load(exec_result);
-      if (exec_result.type == exec_result_type_t::retire) {
+    auto [addr, width, sign_extend, rd] = exec_result.load;
+    privilege_module.paddr_load(exec_result);
+    if (exec_result.type == exec_result_type_t::retire) {
+      if (this->event_buffer != nullptr) {
+        LIBVIO_PHASE(trace);
         this->event_buffer->push_back(
             {.type = event_type_t::load,
              .pc = exec_result.pc,
              .val1 = addr,
              .val2 = libvio::zero_truncate(exec_result.retire.value, width)});
       }
-    } else {
-      privilege_module.paddr_load(exec_result);
+      if (this->watchpoints != nullptr) {
+        this->watchpoints->check(exec_result.pc, addr, width, false);
+      }
     }
   } else if (exec_result.type == exec_result_type_t::store) {
-    if (this->event_buffer != nullptr) {
-      auto [addr, width, data] = exec_result.store;
-      privilege_module.paddr_store(exec_result);
-      if (exec_result.type == exec_result_type_t::retire) {
+    auto [addr, width, data] = exec_result.store;
+    privilege_module.paddr_store(exec_result);
+    if (exec_result.type == exec_result_type_t::retire) {
+      if (this->event_buffer != nullptr) {
+        LIBVIO_PHASE(trace);
         this->event_buffer->push_back(
             {.type = event_type_t::store,
              .pc = exec_result.pc,
              .val1 = addr,
              .val2 = libvio::zero_truncate(data, width)});
       }
-    } else {
-      privilege_module.paddr_store(exec_result);
+      if (this->watchpoints != nullptr) {
+        this->watchpoints->check(exec_result.pc, addr, width, true);
+      }
     }
   } else if (exec_result.type == exec_result_type_t::csr_op) {
     privilege_module.csr_op(exec_result);
@@ -133,6 +276,7 @@ void riscv_cpu_system<WORD_T>::next_instruction(void) {
     privilege_module.sys_op(exec_result);
     if (this->event_buffer != nullptr &&
         exec_result.type == exec_result_type_t::retire) {
+      LIBVIO_PHASE(trace);
       if (exec_result.sys_op.mret) {
         this->event_buffer->push_back({.type = event_type_t::trap_ret,
                                        .pc = exec_result.pc,
@@ -145,6 +289,14 @@ void riscv_cpu_system<WORD_T>::next_instruction(void) {
                                        .val2 = 0});
       }
     }
+    if (exec_result.type == exec_result_type_t::retire &&
+        (exec_result.sys_op.mret || exec_result.sys_op.sret)) {
+      // the return target starts a block
+      edge = true;
+      if (this->profiler != nullptr) {
+        this->profiler->trap_ret();
+      }
+    }
   }
 
   if (exec_result.type == exec_result_type_t::trap) {
@@ -153,6 +305,7 @@ void riscv_cpu_system<WORD_T>::next_instruction(void) {
       return;
     }
     if (this->event_buffer != nullptr) {
+      LIBVIO_PHASE(trace);
       this->event_buffer->push_back({.type = event_type_t::trap,
                                      .pc = exec_result.pc,
                                      .val1 = exec_result.trap.cause,
@@ -160,14 +313,28 @@ void riscv_cpu_system<WORD_T>::next_instruction(void) {
     }
     last_trap = exec_result.trap.cause;
     privilege_module.handle_exception(exec_result);
+    // the entry of the handler starts a block
+    edge = true;
+    if (this->profiler != nullptr) {
+      this->profiler->trap(exec_result.next_pc);
+    }
   } else {
     last_trap = std::nullopt;
+    WORD_T next_pc = exec_result.next_pc;
     privilege_module.handle_interrupt(exec_result);
+    // a taken interrupt shows as a redirection of the next PC
+    if (exec_result.next_pc != next_pc) {
+      edge = true;
+      if (this->profiler != nullptr) {
+        this->profiler->trap(exec_result.next_pc);
+      }
+    }
   }
 
   assert(exec_result.type == exec_result_type_t::retire);
   if (exec_result.retire.rd != 0) {
     if (this->event_buffer != nullptr) {
+      LIBVIO_PHASE(trace);
       this->event_buffer->push_back({.type = event_type_t::reg_write,
                                      .pc = exec_result.pc,
                                      .val1 = exec_result.retire.rd,
@@ -176,9 +343,111 @@ void riscv_cpu_system<WORD_T>::next_instruction(void) {
     user_core.gpr[exec_result.retire.rd] = exec_result.retire.value;
   }
 
+  if (this->coverage != nullptr && edge) {
+    this->coverage->edge(exec_result.pc, exec_result.next_pc);
+  }
   exec_result.pc = exec_result.next_pc;
 }
 
+template <typename WORD_T>
+typename riscv_cpu_system<WORD_T>::link_t
+riscv_cpu_system<WORD_T>::link_hint(const decode_t &decode) {
+  auto is_link = [](uint8_t reg) { return reg == 1 || reg == 5; };
+  if (decode.dispatch == dispatch_t::jal) {
+    return is_link(decode.rd) ? link_t::call : link_t::none;
+  }
+  if (decode.dispatch != dispatch_t::jalr) {
+    return link_t::none;
+  }
+  if (!is_link(decode.rd)) {
+    return is_link(decode.rs1) ? link_t::ret : link_t::none;
+  }
+  if (is_link(decode.rs1) && decode.rs1 != decode.rd) {
+    return link_t::ret_call;
+  }
+  return link_t::call;
+}
+
+template <typename WORD_T>
+void riscv_cpu_system<WORD_T>::trace_link(link_t link) {
+  WORD_T target = exec_result.next_pc;
+  WORD_T sp = user_core.gpr[2];
+  if (link == link_t::ret || link == link_t::ret_call) {
+    if (this->event_buffer != nullptr) {
+      LIBVIO_PHASE(trace);
+      this->event_buffer->push_back({.type = event_type_t::call_ret,
+                                     .pc = exec_result.pc,
+                                     .val1 = target,
+                                     .val2 = sp});
+    }
+    if (this->profiler != nullptr) {
+      this->profiler->ret(target);
+    }
+  }
+  if (link == link_t::call || link == link_t::ret_call) {
+    if (this->event_buffer != nullptr) {
+      LIBVIO_PHASE(trace);
+      this->event_buffer->push_back({.type = event_type_t::call,
+                                     .pc = exec_result.pc,
+                                     .val1 = target,
+                                     .val2 = sp});
+    }
+    if (this->profiler != nullptr) {
+      this->profiler->call(target, exec_result.retire.value);
+    }
+  }
+}
+
+template <typename WORD_T>
+size_t
+riscv_cpu_system<WORD_T>::run(size_t n,
+                              const breakpoint_set<WORD_T> *breakpoints) {
+  if (this->sampler == nullptr) {
+    return run_loop(n, breakpoints);
+  }
+  // the run is split where samples are due, so sampling costs nothing per
+  // instruction
+  size_t done = 0;
+  while (done < n) {
+    size_t chunk = std::min(n - done, this->sampler->countdown());
+    size_t k = run_loop(chunk, breakpoints);
+    done += k;
+    this->sampler->advance(k, exec_result.pc);
+    if (k < chunk) {
+      break;
+    }
+  }
+  return done;
+}
+
+template <typename WORD_T>
+size_t
+riscv_cpu_system<WORD_T>::run_loop(size_t n,
+                                   const breakpoint_set<WORD_T> *breakpoints) {
+  // qualified calls are not dispatched virtually, so they can be inlined
+  if ((breakpoints == nullptr || breakpoints->empty()) &&
+      this->watchpoints == nullptr) {
+    for (size_t i = 0; i < n; ++i) {
+      if (is_stopped) {
+        return i;
+      }
+      riscv_cpu_system::next_instruction();
+    }
+    return n;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (is_stopped) {
+      return i;
+    }
+    riscv_cpu_system::next_instruction();
+    if ((breakpoints != nullptr && breakpoints->contains(exec_result.pc)) ||
+        (this->watchpoints != nullptr && this->watchpoints->hit.has_value())) {
+      return i + 1;
+    }
+  }
+  return n;
+}
+
 template <typename WORD_T> bool riscv_cpu_system<WORD_T>::stopped(void) const {
   return is_stopped;
 }
@@ -188,6 +457,41 @@ std::optional<WORD_T> riscv_cpu_system<WORD_T>::get_trap(void) const {
   return last_trap;
 }
 
+template <typename WORD_T>
+std::unique_ptr<typename abstract_cpu<WORD_T>::state_t>
+riscv_cpu_system<WORD_T>::save_state(void) const {
+  auto state = std::make_unique<saved_state_t>();
+  state->exec_result = exec_result;
+  state->user_core = user_core;
+  state->privilege_module = privilege_module;
+  state->last_trap = last_trap;
+  state->is_stopped = is_stopped;
+  state->irq_poll_countdown = irq_poll_countdown;
+  return state;
+}
+
+template <typename WORD_T>
+bool riscv_cpu_system<WORD_T>::restore_state(
+    const typename abstract_cpu<WORD_T>::state_t &state) {
+  auto saved = dynamic_cast<const saved_state_t *>(&state);
+  if (saved == nullptr) {
+    return false;
+  }
+  exec_result = saved->exec_result;
+  user_core = saved->user_core;
+  privilege_module = saved->privilege_module;
+  privilege_module.mem_bus = this->mem_bus;
+  privilege_module.mmio_bus = this->mmio_bus;
+  privilege_module.host_ranges.clear();
+  if (this->mmio_bus != nullptr) {
+    privilege_module.host_ranges = this->mmio_bus->host_ranges();
+  }
+  last_trap = saved->last_trap;
+  is_stopped = saved->is_stopped;
+  irq_poll_countdown = saved->irq_poll_countdown;
+  return true;
+}
+
 } // namespace libcpu
 
 #endif
@@ -0,0 +1,189 @@
+#ifndef LIBCPU_SAMPLER_HH
+#define LIBCPU_SAMPLER_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <libcpu/symbols.hh>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief A sampling profiler recording the PC every N instructions.
+ *
+ * The CPU runs at most `countdown()` instructions at a time and reports them
+ * with `advance()`. When the countdown reaches zero, the PC of the next
+ * instruction is counted in a flat histogram. Sampling therefore costs
+ * nothing per instruction, only a split of the run loop every N
+ * instructions.
+ *
+ * With randomization, each interval is drawn uniformly from [N/2, 3N/2], so
+ * loops whose length divides N are not sampled at the same PC every time.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class pc_sampler {
+public:
+  /**
+   * @struct function_t
+   * @brief Samples of a function over all its PCs
+   */
+  struct function_t {
+    std::string name; ///< Symbol name, or the PC if not in a symbol
+    uint64_t samples; ///< Number of samples
+  };
+
+  /**
+   * @brief Start sampling
+   * @param interval Average number of instructions between samples, must
+   * not be 0
+   * @param randomize Whether to randomize each interval
+   */
+  pc_sampler(size_t interval, bool randomize)
+      : interval(interval), randomize(randomize) {
+    remaining = next_interval();
+  }
+
+  /**
+   * @brief Get the number of instructions before the next sample
+   * @return size_t Number of instructions, at least 1
+   */
+  size_t countdown(void) const { return remaining; }
+
+  /**
+   * @brief Account for executed instructions, taking a sample if due
+   * @param n Number of instructions executed, not more than `countdown()`
+   * @param pc PC of the next instruction
+   */
+  void advance(size_t n, WORD_T pc) {
+    remaining -= n;
+    if (remaining == 0) {
+      ++histogram[pc];
+      ++n_samples;
+      remaining = next_interval();
+    }
+  }
+
+  /**
+   * @brief Get the average number of instructions between samples
+   * @return size_t The interval
+   */
+  size_t get_interval(void) const { return interval; }
+
+  /**
+   * @brief Get the number of samples taken
+   * @return uint64_t Number of samples
+   */
+  uint64_t samples(void) const { return n_samples; }
+
+  /**
+   * @brief Get the sampled PCs
+   * @return Pairs of PC and number of samples, by decreasing count
+   */
+  std::vector<std::pair<WORD_T, uint64_t>> hotspots(void) const;
+
+  /**
+   * @brief Sum the samples per function
+   * @param symbols Symbols naming the functions
+   * @return The functions by decreasing number of samples
+   */
+  std::vector<function_t> functions(const symbol_table &symbols) const;
+
+  /**
+   * @brief Write the samples in the output format of `perf script`
+   *
+   * Each sampled PC becomes one event whose period is its number of
+   * instructions, i.e. samples times the interval, so tools reading `perf
+   * script` output, e.g. `stackcollapse-perf.pl`, weigh it accordingly.
+   *
+   * @param os Output stream
+   * @param symbols Symbols naming the functions
+   * @param comm Name of the program in the events
+   */
+  void write_perf_script(std::ostream &os, const symbol_table &symbols,
+                         const std::string &comm) const;
+
+private:
+  size_t interval;        ///< Average instructions between samples
+  bool randomize;         ///< Whether intervals are randomized
+  size_t remaining;       ///< Instructions before the next sample
+  uint64_t n_samples = 0; ///< Number of samples taken
+  /// State of the interval generator
+  uint64_t rng = 0x9e3779b97f4a7c15;
+  /// Number of samples per PC
+  std::unordered_map<WORD_T, uint64_t> histogram;
+
+  /**
+   * @brief Draw the length of the next interval
+   * @return size_t Number of instructions, at least 1
+   */
+  size_t next_interval(void) {
+    if (!randomize || interval < 2) {
+      return interval;
+    }
+    // xorshift64, good enough to break the phase with loops
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return interval - interval / 2 + rng % (interval + 1);
+  }
+};
+
+template <typename WORD_T>
+std::vector<std::pair<WORD_T, uint64_t>>
+pc_sampler<WORD_T>::hotspots(void) const {
+  std::vector<std::pair<WORD_T, uint64_t>> result{histogram.begin(),
+                                                  histogram.end()};
+  std::sort(result.begin(), result.end(), [](const auto &a, const auto &b) {
+    return a.second > b.second || (a.second == b.second && a.first < b.first);
+  });
+  return result;
+}
+
+template <typename WORD_T>
+std::vector<typename pc_sampler<WORD_T>::function_t>
+pc_sampler<WORD_T>::functions(const symbol_table &symbols) const {
+  std::vector<function_t> result;
+  std::unordered_map<std::string, size_t> index;
+  for (const auto &[pc, count] : histogram) {
+    const symbol_table::symbol_t *sym = symbols.lookup(pc);
+    std::string name = sym != nullptr ? sym->name : symbols.name(pc);
+    auto [pos, inserted] = index.try_emplace(name, result.size());
+    if (inserted) {
+      result.push_back({name, 0});
+    }
+    result[pos->second].samples += count;
+  }
+  std::sort(result.begin(), result.end(),
+            [](const function_t &a, const function_t &b) {
+              return a.samples > b.samples ||
+                     (a.samples == b.samples && a.name < b.name);
+            });
+  return result;
+}
+
+template <typename WORD_T>
+void pc_sampler<WORD_T>::write_perf_script(std::ostream &os,
+                                           const symbol_table &symbols,
+                                           const std::string &comm) const {
+  for (const auto &[pc, count] : hotspots()) {
+    os << comm << " 0 0.000000: " << std::dec << count * interval
+       << " instructions:\n";
+    // unknown code is named like `perf` does
+    std::string name =
+        symbols.lookup(pc) != nullptr ? symbols.name(pc) : "[unknown]";
+    os << '\t' << std::hex << static_cast<uint64_t>(pc) << ' ' << name
+       << " (" << comm << ")\n\n";
+  }
+  os << std::dec;
+  os.flush();
+}
+
+} // namespace libcpu
+
+#endif
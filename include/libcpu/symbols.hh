@@ -0,0 +1,94 @@
+#ifndef LIBCPU_SYMBOLS_HH
+#define LIBCPU_SYMBOLS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @brief Function symbols of a program, looked up by address.
+ *
+ * Symbols are kept sorted by address. A lookup finds the symbol with the
+ * greatest address not above the address looked up, and fails if the
+ * address is past the end of a symbol with a known size.
+ */
+class symbol_table {
+public:
+  /**
+   * @struct symbol_t
+   * @brief A function symbol
+   */
+  struct symbol_t {
+    uint64_t addr;    ///< Address of the first instruction
+    uint64_t size;    ///< Size in bytes, 0 if unknown
+    std::string name; ///< Name of the function
+  };
+
+  /**
+   * @brief Load the function symbols of an ELF binary (auto-detects
+   * 32/64-bit format).
+   *
+   * Functions and global untyped symbols in executable sections are loaded
+   * from `.symtab`, or from `.dynsym` if the binary is stripped.
+   *
+   * @param buffer Pointer to the ELF file data in memory
+   * @param size Size of the ELF file in bytes
+   * @return Number of symbols loaded
+   */
+  size_t load_elf(const uint8_t *buffer, size_t size);
+
+  /**
+   * @brief Load the function symbols of an ELF file.
+   *
+   * @param filename Path to the ELF file
+   * @return Number of symbols loaded, 0 if the file cannot be read
+   */
+  size_t load_elf_from_file(const char *filename);
+
+  /**
+   * @brief Add a symbol.
+   *
+   * @param addr Address of the first instruction
+   * @param size Size in bytes, 0 if unknown
+   * @param name Name of the function
+   */
+  void insert(uint64_t addr, uint64_t size, std::string name);
+
+  /**
+   * @brief Find the symbol containing an address.
+   *
+   * @param addr The address
+   * @return The symbol, nullptr if no symbol contains the address
+   */
+  const symbol_t *lookup(uint64_t addr) const;
+
+  /**
+   * @brief Get a printable name of an address.
+   *
+   * @param addr The address
+   * @return The symbol name, followed by `+0x<offset>` if the address is
+   * not the start of the symbol, or the address in hexadecimal
+   */
+  std::string name(uint64_t addr) const;
+
+  /**
+   * @brief Get the number of symbols.
+   * @return size_t Number of symbols
+   */
+  size_t size(void) const { return symbols.size(); }
+
+  /**
+   * @brief Remove all symbols.
+   */
+  void clear(void) { symbols.clear(); }
+
+private:
+  std::vector<symbol_t> symbols; ///< Symbols sorted by address
+};
+
+} // namespace libcpu
+
+#endif
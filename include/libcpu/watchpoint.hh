@@ -0,0 +1,195 @@
+#ifndef LIBCPU_WATCHPOINT_HH
+#define LIBCPU_WATCHPOINT_HH
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <libvio/width.hh>
+#include <optional>
+#include <vector>
+
+namespace libcpu {
+
+/**
+ * @enum watch_access_t
+ * @brief Types of memory accesses a data watchpoint triggers on
+ */
+enum class watch_access_t : uint8_t {
+  read = 1,      ///< Loads
+  write = 2,     ///< Stores
+  read_write = 3 ///< Loads and stores
+};
+
+/**
+ * @brief A set of data watchpoints checked on every load and store.
+ *
+ * Each watchpoint is a range of addresses. The pages touched by any range are
+ * marked in a bitmap filter indexed by a hash of the page number, so an access
+ * to an unwatched page costs one load and a bit test. Only accesses passing
+ * the filter are compared with the ranges.
+ *
+ * The CPU calls `check()` after each load or store retires. A triggered
+ * watchpoint is recorded in `hit` until the debugger clears it, and the CPU
+ * stops its run loop after the accessing instruction.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class watchpoint_set {
+public:
+  /**
+   * @struct range_t
+   * @brief A watched range of memory
+   */
+  struct range_t {
+    WORD_T addr;           ///< First address of the range
+    WORD_T len;            ///< Length of the range in bytes
+    watch_access_t access; ///< Accesses triggering the watchpoint
+  };
+
+  /**
+   * @struct hit_t
+   * @brief An access that triggered a watchpoint
+   */
+  struct hit_t {
+    size_t index;          ///< Index of the watchpoint triggered
+    WORD_T pc;             ///< PC of the accessing instruction
+    WORD_T addr;           ///< Address accessed
+    libvio::width_t width; ///< Width of the access
+    bool is_write;         ///< Whether the access is a store
+  };
+
+  std::optional<hit_t> hit; ///< The first access triggering a watchpoint
+
+  /**
+   * @brief Check a memory access
+   * @param pc PC of the accessing instruction
+   * @param addr Address accessed
+   * @param width Width of the access
+   * @param is_write Whether the access is a store
+   * @return true if the access triggers a watchpoint
+   */
+  bool check(WORD_T pc, WORD_T addr, libvio::width_t width, bool is_write) {
+    WORD_T last = addr + static_cast<WORD_T>(width) - 1;
+    if (!test_page(page(addr)) && !test_page(page(last))) {
+      return false;
+    }
+    return check_ranges(pc, addr, width, is_write);
+  }
+
+  /**
+   * @brief Add a watchpoint
+   * @param addr First address of the range
+   * @param len Length of the range in bytes, must not be 0
+   * @param access Accesses triggering the watchpoint
+   */
+  void insert(WORD_T addr, WORD_T len, watch_access_t access) {
+    ranges.push_back({addr, len, access});
+    mark_pages(ranges.back());
+  }
+
+  /**
+   * @brief Remove a watchpoint by its index in insertion order
+   * @param index Index of the watchpoint, must be less than `size()`
+   */
+  void erase(size_t index) {
+    ranges.erase(ranges.begin() + index);
+    filter.fill(0);
+    for (const range_t &range : ranges) {
+      mark_pages(range);
+    }
+  }
+
+  /**
+   * @brief Get the number of watchpoints
+   * @return size_t Number of watchpoints
+   */
+  size_t size(void) const { return ranges.size(); }
+
+  /**
+   * @brief Check whether there is no watchpoint
+   * @return true if there is no watchpoint
+   */
+  bool empty(void) const { return ranges.empty(); }
+
+  /**
+   * @brief Get a watchpoint by its index in insertion order
+   * @param index Index of the watchpoint, must be less than `size()`
+   * @return const range_t& The watched range
+   */
+  const range_t &operator[](size_t index) const { return ranges[index]; }
+
+private:
+  static constexpr unsigned page_shift = 12;  ///< 4 KiB pages
+  static constexpr size_t filter_bits = 4096; ///< Number of hash buckets
+
+  std::array<uint64_t, filter_bits / 64> filter{}; ///< Bit per hash bucket
+  std::vector<range_t> ranges; ///< Watchpoints in insertion order
+
+  /**
+   * @brief Get the hash bucket of the page of an address
+   * @param addr The address
+   * @return size_t Index of the bucket
+   */
+  static size_t page(WORD_T addr) {
+    return (static_cast<uint64_t>(addr) >> page_shift) % filter_bits;
+  }
+
+  /**
+   * @brief Check whether a bucket has a watched page
+   * @param bucket Index of the bucket
+   * @return true if the bucket is marked
+   */
+  bool test_page(size_t bucket) const {
+    return (filter[bucket / 64] >> (bucket % 64)) & 1;
+  }
+
+  /**
+   * @brief Mark the pages of a range in the filter
+   * @param range The range
+   */
+  void mark_pages(const range_t &range) {
+    uint64_t first = static_cast<uint64_t>(range.addr) >> page_shift;
+    uint64_t last =
+        static_cast<uint64_t>(WORD_T(range.addr + range.len - 1)) >>
+        page_shift;
+    // a range over all buckets, or wrapping around, marks every bucket
+    if (last < first || last - first >= filter_bits) {
+      filter.fill(UINT64_MAX);
+      return;
+    }
+    for (uint64_t p = first; p <= last; ++p) {
+      size_t bucket = p % filter_bits;
+      filter[bucket / 64] |= uint64_t(1) << (bucket % 64);
+    }
+  }
+
+  /**
+   * @brief Compare an access passing the filter with the ranges
+   * @return true if the access triggers a watchpoint
+   */
+  bool check_ranges(WORD_T pc, WORD_T addr, libvio::width_t width,
+                    bool is_write) {
+    auto needed = is_write ? watch_access_t::write : watch_access_t::read;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      const range_t &range = ranges[i];
+      if (!(static_cast<uint8_t>(range.access) &
+            static_cast<uint8_t>(needed))) {
+        continue;
+      }
+      // overlap of [addr, addr + width) and [range.addr, range.addr + len)
+      WORD_T offset = addr - range.addr;
+      WORD_T back = range.addr - addr;
+      if (offset < range.len || back < static_cast<WORD_T>(width)) {
+        if (!hit.has_value()) {
+          hit = hit_t{i, pc, addr, width, is_write};
+        }
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+} // namespace libcpu
+
+#endif
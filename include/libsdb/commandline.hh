@@ -43,7 +43,8 @@ struct command_t {
  * @return std::optional<std::vector<std::string>> List of tokens extracted from
  * the command, nullopt if syntax error.
  */
-std::optional<std::vector<std::string>> tokenize_command(std::string command);
+std::optional<std::vector<std::string>>
+tokenize_command(const std::string &command);
 
 /**
  * @brief Parses tokenized command into structured format with optional pipe
@@ -94,8 +95,42 @@ private:
   std::unique_ptr<popen_output_buffer> buffer; ///< The underlying buffer
 public:
   explicit popen_ostream(const std::string &command);
-  friend popen_ostream &operator>>(std::ostream &os,
-                                   const std::string &command);
+  popen_ostream(popen_ostream &&other);
+  friend popen_ostream operator>>(std::ostream &os,
+                                  const std::string &command);
+};
+
+/**
+ * @brief A streambuf collecting output and passing it on in large blocks.
+ *
+ * Flushing, e.g. by `std::endl`, does not reach the target. The collected
+ * output is written to the target only when the buffer is full, on `drain()`
+ * and on destruction. This avoids a system call per line when a long script
+ * prints to a terminal or a file.
+ */
+class batch_output_buffer : public std::streambuf {
+private:
+  static constexpr size_t buffer_size = 65536; ///< Size of the buffer
+  std::unique_ptr<char[]> buffer;              ///< Collected output
+  std::streambuf *target; ///< The streambuf receiving the output
+protected:
+  int sync() override;
+  int_type overflow(int_type ch) override;
+
+public:
+  /**
+   * @brief Construct a buffer in front of a streambuf
+   * @param target The streambuf receiving the output, e.g.
+   * `std::cout.rdbuf()`, must outlive the buffer
+   */
+  explicit batch_output_buffer(std::streambuf *target);
+  ~batch_output_buffer() override;
+
+  /**
+   * @brief Write the collected output to the target and flush it
+   * @return 0 on success, -1 on a write error
+   */
+  int drain(void);
 };
 
 } // namespace libsdb
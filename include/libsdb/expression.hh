@@ -301,6 +301,322 @@ evaluate_expression(const std::vector<token_t> &postfix_expr,
   }
 }
 
+/**
+ * @enum expr_op_t
+ * @brief Operations of compiled expressions
+ */
+enum class expr_op_t : uint8_t {
+  val,       ///< Push a constant
+  reg,       ///< Push a general purpose register
+  pc,        ///< Push the program counter
+  neg,       ///< Unary `-`
+  bit_not,   ///< Unary `~`
+  log_not,   ///< Unary `!`
+  zext_byte, ///< `byte`
+  zext_half, ///< `half`
+  zext_word, ///< `word`
+  sext_byte, ///< `sbyte`
+  sext_half, ///< `shalf`
+  sext_word, ///< `sword`
+  pmem,      ///< `pmem`
+  vmem,      ///< `vmem`
+  sll,       ///< `<<`
+  sra,       ///< `>>`
+  srl,       ///< `>>>`
+  ge,        ///< `>=`
+  le,        ///< `<=`
+  gt,        ///< `>`
+  lt,        ///< `<`
+  eq,        ///< `==`
+  ne,        ///< `!=`
+  mul,       ///< `*`
+  div,       ///< `/`
+  rem,       ///< `%`
+  add,       ///< Binary `+`
+  sub,       ///< Binary `-`
+  bit_and,   ///< `&`
+  bit_xor,   ///< `^`
+  bit_or,    ///< `|`
+  nop        ///< Unary `+`, not emitted
+};
+
+/**
+ * @brief Resolves the operation of an operator token
+ * @param token An operator token from a postfix expression, where unary
+ * operators have the highest precedence
+ * @return The operation, nullopt if the operator is unknown
+ */
+std::optional<expr_op_t> resolve_operator(const token_t &token);
+
+/**
+ * @brief An expression compiled for repeated evaluation
+ *
+ * Compiling resolves operators to `expr_op_t` and register names to register
+ * addresses, and checks the stack usage. Evaluation is then a single pass
+ * over the operations with a fixed-size stack, without allocation or string
+ * comparison. This is meant for watchpoints and breakpoint conditions, which
+ * are evaluated after many instructions.
+ *
+ * @tparam WORD_T The word type, must be unsigned integer.
+ */
+template <typename WORD_T> class compiled_expression {
+public:
+  static constexpr size_t max_depth = 32; ///< Maximum stack depth
+
+  /**
+   * @brief Compiles a postfix expression
+   * @param postfix_expr The expression in postfix notation (RPN)
+   * @param cpu CPU used to resolve register names. If nullptr, the expression
+   * cannot refer to CPU registers.
+   * @return The compiled expression, nullopt if the expression is malformed,
+   * refers to unknown operators or needs more than `max_depth` stack slots
+   */
+  static std::optional<compiled_expression>
+  compile(const std::vector<token_t> &postfix_expr,
+          const libcpu::abstract_cpu<WORD_T> *cpu);
+
+  /**
+   * @brief Evaluates the expression
+   * @param cpu CPU the registers and memory are read from. It must have the
+   * same registers as the CPU used in compiling. If nullptr, expressions
+   * referring to the CPU fail.
+   * @return Optional result of the evaluation if successful
+   */
+  std::optional<WORD_T>
+  evaluate(const libcpu::abstract_cpu<WORD_T> *cpu) const;
+
+private:
+  /**
+   * @struct instr_t
+   * @brief An operation with its argument
+   */
+  struct instr_t {
+    expr_op_t op; ///< Operation
+    bool imm;     ///< Binary operator with the constant `arg` as right operand
+    uint64_t arg; ///< Constant value or register address
+  };
+
+  std::vector<instr_t> code; ///< Operations in postfix order
+  bool uses_cpu = false;     ///< Whether the CPU is needed for evaluation
+};
+
+template <typename WORD_T>
+std::optional<compiled_expression<WORD_T>>
+compiled_expression<WORD_T>::compile(const std::vector<token_t> &postfix_expr,
+                                     const libcpu::abstract_cpu<WORD_T> *cpu) {
+  compiled_expression result;
+  size_t depth = 0;
+  for (const auto &token : postfix_expr) {
+    switch (token.type) {
+    case token_type_t::val:
+      result.code.push_back({expr_op_t::val, false, token.val});
+      ++depth;
+      break;
+    case token_type_t::var:
+      if (cpu == nullptr) {
+        return std::nullopt;
+      }
+      if (strcmp(token.name, "pc") == 0) {
+        result.code.push_back({expr_op_t::pc, false, 0});
+      } else {
+        result.code.push_back(
+            {expr_op_t::reg, false, cpu->gpr_addr(token.name)});
+      }
+      result.uses_cpu = true;
+      ++depth;
+      break;
+    case token_type_t::reg:
+      result.code.push_back({expr_op_t::reg, false, token.val});
+      result.uses_cpu = true;
+      ++depth;
+      break;
+    case token_type_t::pc:
+      result.code.push_back({expr_op_t::pc, false, 0});
+      result.uses_cpu = true;
+      ++depth;
+      break;
+    case token_type_t::op: {
+      std::optional<expr_op_t> op = resolve_operator(token);
+      bool unary = op.has_value() && (op.value() <= expr_op_t::vmem ||
+                                      op.value() == expr_op_t::nop);
+      if (!op.has_value() || depth < (unary ? 1 : 2)) {
+        return std::nullopt;
+      }
+      if (op.value() == expr_op_t::pmem || op.value() == expr_op_t::vmem) {
+        result.uses_cpu = true;
+      }
+      if (op.value() == expr_op_t::nop) {
+        break;
+      }
+      if (unary) {
+        result.code.push_back({op.value(), false, 0});
+      } else if (result.code.back().op == expr_op_t::val) {
+        // a constant right before a binary operator is its right operand
+        result.code.back() = {op.value(), true, result.code.back().arg};
+        --depth;
+      } else {
+        result.code.push_back({op.value(), false, 0});
+        --depth;
+      }
+      break;
+    }
+    default:
+      return std::nullopt;
+    }
+    if (depth > max_depth) {
+      return std::nullopt;
+    }
+  }
+  if (depth != 1) {
+    return std::nullopt;
+  }
+  return result;
+}
+
+template <typename WORD_T>
+std::optional<WORD_T> compiled_expression<WORD_T>::evaluate(
+    const libcpu::abstract_cpu<WORD_T> *cpu) const {
+  if (uses_cpu && cpu == nullptr) {
+    return std::nullopt;
+  }
+  // read registers directly from the register file if there is one
+  const WORD_T *gpr = cpu != nullptr ? cpu->get_gpr() : nullptr;
+  constexpr auto word_width = static_cast<libvio::width_t>(sizeof(WORD_T));
+  WORD_T stack[max_depth];
+  size_t sp = 0;
+
+  for (const instr_t &instr : code) {
+    switch (instr.op) {
+    case expr_op_t::val:
+      stack[sp++] = instr.arg;
+      continue;
+    case expr_op_t::reg:
+      stack[sp++] = gpr != nullptr ? gpr[instr.arg] : cpu->get_gpr(instr.arg);
+      continue;
+    case expr_op_t::pc:
+      stack[sp++] = cpu->get_pc();
+      continue;
+    default:
+      break;
+    }
+
+    uint64_t operand = stack[sp - 1];
+    if (instr.op <= expr_op_t::vmem) {
+      switch (instr.op) {
+      case expr_op_t::neg:
+        stack[sp - 1] = 0 - operand;
+        break;
+      case expr_op_t::bit_not:
+        stack[sp - 1] = ~operand;
+        break;
+      case expr_op_t::log_not:
+        stack[sp - 1] = operand ? 0 : 1;
+        break;
+      case expr_op_t::zext_byte:
+        stack[sp - 1] = libvio::zero_truncate(operand, libvio::width_t::byte);
+        break;
+      case expr_op_t::zext_half:
+        stack[sp - 1] = libvio::zero_truncate(operand, libvio::width_t::half);
+        break;
+      case expr_op_t::zext_word:
+        stack[sp - 1] = libvio::zero_truncate(operand, libvio::width_t::word);
+        break;
+      case expr_op_t::sext_byte:
+        stack[sp - 1] = libvio::sign_extend(operand, libvio::width_t::byte);
+        break;
+      case expr_op_t::sext_half:
+        stack[sp - 1] = libvio::sign_extend(operand, libvio::width_t::half);
+        break;
+      case expr_op_t::sext_word:
+        stack[sp - 1] = libvio::sign_extend(operand, libvio::width_t::word);
+        break;
+      default: {
+        std::optional<WORD_T> val = instr.op == expr_op_t::pmem
+                                        ? cpu->pmem_peek(operand, word_width)
+                                        : cpu->vmem_peek(operand, word_width);
+        if (!val.has_value()) {
+          return std::nullopt;
+        }
+        stack[sp - 1] = val.value();
+        break;
+      }
+      }
+      continue;
+    }
+
+    // binary operators, the right operand is either a constant or on the stack
+    uint64_t right = instr.imm ? instr.arg : operand;
+    if (!instr.imm) {
+      --sp;
+    }
+    uint64_t left = stack[sp - 1];
+    WORD_T &value = stack[sp - 1];
+    switch (instr.op) {
+    case expr_op_t::sll:
+      value = left << (right & 0x3f);
+      break;
+    case expr_op_t::sra:
+      value = static_cast<uint64_t>(static_cast<int64_t>(left) >>
+                                    (right & 0x3f));
+      break;
+    case expr_op_t::srl:
+      value = left >> (right & 0x3f);
+      break;
+    case expr_op_t::ge:
+      value = left >= right ? 1 : 0;
+      break;
+    case expr_op_t::le:
+      value = left <= right ? 1 : 0;
+      break;
+    case expr_op_t::gt:
+      value = left > right ? 1 : 0;
+      break;
+    case expr_op_t::lt:
+      value = left < right ? 1 : 0;
+      break;
+    case expr_op_t::eq:
+      value = left == right ? 1 : 0;
+      break;
+    case expr_op_t::ne:
+      value = left != right ? 1 : 0;
+      break;
+    case expr_op_t::mul:
+      value = left * right;
+      break;
+    case expr_op_t::div:
+      if (right == 0) {
+        return std::nullopt;
+      }
+      value = left / right;
+      break;
+    case expr_op_t::rem:
+      if (right == 0) {
+        return std::nullopt;
+      }
+      value = left % right;
+      break;
+    case expr_op_t::add:
+      value = left + right;
+      break;
+    case expr_op_t::sub:
+      value = left - right;
+      break;
+    case expr_op_t::bit_and:
+      value = left & right;
+      break;
+    case expr_op_t::bit_xor:
+      value = left ^ right;
+      break;
+    case expr_op_t::bit_or:
+      value = left | right;
+      break;
+    default:
+      return std::nullopt;
+    }
+  }
+  return stack[0];
+}
+
 /**
  * @brief Evaluates an expression represented with a string
  *
@@ -0,0 +1,312 @@
+#ifndef LIBSDB_REVERSE_HH
+#define LIBSDB_REVERSE_HH
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <libcpu/abstract_cpu.hh>
+#include <libcpu/difftest.hh>
+#include <libcpu/memory.hh>
+#include <libvio/agent.hh>
+#include <libvio/replay.hh>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace libsdb {
+
+/**
+ * @class recorder
+ * @brief Records the execution of a CPU, so it can be moved backwards.
+ *
+ * The recorder takes a checkpoint every `interval` instructions. A checkpoint
+ * is the architectural state of the CPU and the positions in the MMIO logs.
+ * Memory is journaled with `libcpu::memory_journal`, so a checkpoint only
+ * holds the pages written before the next checkpoint, in their content before
+ * the first write. MMIO requests go through a `libvio::replay_agent`, so
+ * execution after restoring a checkpoint gets the same MMIO results and
+ * interrupts without touching the devices.
+ *
+ * Moving to an earlier point restores the latest checkpoint before it and
+ * executes forward from there, which costs at most one interval. The oldest
+ * checkpoints are dropped to keep the history within the memory budget, but
+ * the latest checkpoint is always kept.
+ *
+ * Differential tests are recorded by recording both the DUT and the REF.
+ *
+ * @tparam WORD_T The word type of the CPU
+ */
+template <typename WORD_T> class recorder {
+public:
+  using cpu_t = libcpu::abstract_cpu<WORD_T>;
+
+  /**
+   * @brief Start recording a CPU at its current state
+   *
+   * Steps taken by the CPU must be passed to `advance()` from now on. The
+   * memories of the CPU are journaled and its MMIO agents are replaced by
+   * replay agents until the recorder is destroyed.
+   *
+   * @param cpu The CPU, must support `abstract_cpu::save_state()`
+   * @param interval Number of steps between checkpoints, must not be 0
+   * @param budget Maximum size of the history in bytes
+   */
+  recorder(cpu_t *cpu, size_t interval, size_t budget);
+
+  /**
+   * @brief Stop recording and give the MMIO agents back to the CPU
+   */
+  ~recorder();
+
+  recorder(const recorder &) = delete;
+  recorder &operator=(const recorder &) = delete;
+
+  /**
+   * @brief Get the recorded CPU
+   * @return cpu_t* The CPU
+   */
+  cpu_t *get_cpu(void) const { return cpu; }
+
+  /**
+   * @brief Get the number of steps executed since the recording started
+   * @return size_t Current position
+   */
+  size_t position(void) const { return pos; }
+
+  /**
+   * @brief Get the earliest position that can be moved to
+   * @return size_t Position of the oldest checkpoint
+   */
+  size_t first(void) const { return checkpoints.front().position; }
+
+  /**
+   * @brief Get the number of steps before the next checkpoint is due
+   * @return size_t Number of steps, callers should not run the CPU further
+   * before calling `advance()`
+   */
+  size_t until_checkpoint(void) const {
+    return checkpoints.back().position + interval - pos;
+  }
+
+  /**
+   * @brief Account for steps executed, taking a checkpoint if due
+   * @param n Number of steps executed by the caller
+   */
+  void advance(size_t n);
+
+  /**
+   * @brief Restore the latest checkpoint at or before a position
+   *
+   * Checkpoints after the restored one are dropped, they are taken again as
+   * the CPU executes forward.
+   *
+   * @param target The position, not before `first()`
+   * @return size_t Position of the restored checkpoint
+   */
+  size_t restore(size_t target);
+
+  /**
+   * @brief Move the CPU to a position
+   *
+   * Earlier positions are reached by restoring a checkpoint and executing
+   * forward. Data watchpoints and breakpoints are not checked.
+   *
+   * @param target The position, not before `first()`
+   * @return true if the position is reached, false if the CPU stops earlier
+   */
+  bool seek(size_t target);
+
+  /**
+   * @brief Get the number of checkpoints
+   * @return size_t Number of checkpoints
+   */
+  size_t size(void) const { return checkpoints.size(); }
+
+  /**
+   * @brief Get the memory held by the history
+   * @return size_t Approximate size in bytes
+   */
+  size_t memory_usage(void) const;
+
+private:
+  /**
+   * @struct checkpoint_t
+   * @brief A point in the history that can be restored directly
+   */
+  struct checkpoint_t {
+    size_t position; /**< Steps executed before the checkpoint */
+    std::unique_ptr<typename cpu_t::state_t> state; /**< CPU state */
+    std::vector<size_t> replay_pos; /**< Positions in the MMIO logs */
+    std::vector<std::vector<libcpu::memory_journal::page_t>>
+        pages; /**< Pages written before the next checkpoint, per journal */
+  };
+
+  cpu_t *cpu;            /**< The recorded CPU */
+  size_t interval;       /**< Steps between checkpoints */
+  size_t budget;         /**< Maximum size of the history in bytes */
+  size_t pos = 0;        /**< Steps executed since the recording started */
+  size_t page_bytes = 0; /**< Size of the pages held by the checkpoints */
+  std::vector<std::unique_ptr<libcpu::memory_journal>>
+      journals; /**< Journals of the memories of the CPU */
+  std::vector<cpu_t *> agent_cpus; /**< CPUs whose MMIO agents are replaced */
+  std::vector<libvio::io_agent *> targets; /**< The replaced MMIO agents */
+  std::vector<std::unique_ptr<libvio::replay_agent>>
+      agents; /**< Replay agents replacing `targets` */
+  std::deque<checkpoint_t> checkpoints; /**< Checkpoints from the oldest */
+
+  /**
+   * @brief Take a checkpoint at the current position
+   */
+  void take_checkpoint(void);
+
+  /**
+   * @brief Get the size of the pages of a checkpoint
+   * @param checkpoint The checkpoint
+   * @return size_t Size in bytes
+   */
+  static size_t pages_bytes(const checkpoint_t &checkpoint);
+};
+
+template <typename WORD_T>
+recorder<WORD_T>::recorder(cpu_t *cpu, size_t interval, size_t budget)
+    : cpu(cpu), interval(interval), budget(budget) {
+  // a differential test is recorded through the CPUs it drives
+  std::vector<cpu_t *> leaves{cpu};
+  auto difftest = dynamic_cast<libcpu::abstract_difftest<WORD_T> *>(cpu);
+  if (difftest != nullptr) {
+    leaves = {difftest->dut, difftest->ref};
+  }
+  std::vector<libcpu::memory_view *> memories;
+  for (cpu_t *leaf : leaves) {
+    if (leaf->mem_bus != nullptr &&
+        std::find(memories.begin(), memories.end(), leaf->mem_bus) ==
+            memories.end()) {
+      memories.push_back(leaf->mem_bus);
+      journals.push_back(
+          std::make_unique<libcpu::memory_journal>(*leaf->mem_bus));
+    }
+    if (leaf->mmio_bus != nullptr) {
+      agent_cpus.push_back(leaf);
+      targets.push_back(leaf->mmio_bus);
+      agents.push_back(std::make_unique<libvio::replay_agent>(leaf->mmio_bus));
+      leaf->mmio_bus = agents.back().get();
+    }
+  }
+  take_checkpoint();
+  // restoring the state makes the CPU use the replay agents
+  cpu->restore_state(*checkpoints.back().state);
+}
+
+template <typename WORD_T> recorder<WORD_T>::~recorder() {
+  auto state = cpu->save_state();
+  for (size_t i = 0; i < agents.size(); ++i) {
+    agent_cpus[i]->mmio_bus = targets[i];
+  }
+  agents.clear();
+  if (state != nullptr) {
+    cpu->restore_state(*state);
+  }
+}
+
+template <typename WORD_T> void recorder<WORD_T>::advance(size_t n) {
+  pos += n;
+  if (pos - checkpoints.back().position >= interval) {
+    take_checkpoint();
+  }
+}
+
+template <typename WORD_T> size_t recorder<WORD_T>::restore(size_t target) {
+  size_t k = checkpoints.size() - 1;
+  while (k > 0 && checkpoints[k].position > target) {
+    --k;
+  }
+  // undo the epochs from the latest, the memory ends up as it was at `k`
+  for (auto &journal : journals) {
+    journal->undo(journal->take());
+  }
+  for (size_t i = checkpoints.size() - 1; i-- > k;) {
+    for (size_t j = 0; j < journals.size(); ++j) {
+      journals[j]->undo(checkpoints[i].pages[j]);
+    }
+  }
+  while (checkpoints.size() > k + 1) {
+    page_bytes -= pages_bytes(checkpoints.back());
+    checkpoints.pop_back();
+  }
+  checkpoint_t &checkpoint = checkpoints.back();
+  page_bytes -= pages_bytes(checkpoint);
+  for (auto &pages : checkpoint.pages) {
+    pages.clear();
+  }
+  cpu->restore_state(*checkpoint.state);
+  for (size_t i = 0; i < agents.size(); ++i) {
+    agents[i]->seek(checkpoint.replay_pos[i]);
+  }
+  pos = checkpoint.position;
+  return pos;
+}
+
+template <typename WORD_T> bool recorder<WORD_T>::seek(size_t target) {
+  if (target < pos) {
+    restore(target);
+  }
+  while (pos < target) {
+    size_t chunk = std::min(target - pos, until_checkpoint());
+    size_t done = cpu->run(chunk, nullptr);
+    advance(done);
+    if (done < chunk) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename WORD_T>
+size_t recorder<WORD_T>::memory_usage(void) const {
+  size_t bytes = page_bytes + checkpoints.size() * sizeof(checkpoint_t);
+  for (const auto &journal : journals) {
+    bytes += journal->size() * libcpu::memory_journal::page_size;
+  }
+  for (const auto &agent : agents) {
+    bytes += agent->memory_usage();
+  }
+  return bytes;
+}
+
+template <typename WORD_T> void recorder<WORD_T>::take_checkpoint(void) {
+  if (!checkpoints.empty()) {
+    checkpoint_t &last = checkpoints.back();
+    for (size_t j = 0; j < journals.size(); ++j) {
+      last.pages[j] = journals[j]->take();
+    }
+    page_bytes += pages_bytes(last);
+  }
+  checkpoint_t checkpoint{pos, cpu->save_state(), {}, {}};
+  for (const auto &agent : agents) {
+    checkpoint.replay_pos.push_back(agent->position());
+  }
+  checkpoint.pages.resize(journals.size());
+  checkpoints.push_back(std::move(checkpoint));
+  // drop the oldest checkpoints until the history fits in the budget
+  while (checkpoints.size() > 1 && memory_usage() > budget) {
+    page_bytes -= pages_bytes(checkpoints.front());
+    checkpoints.pop_front();
+    for (size_t i = 0; i < agents.size(); ++i) {
+      agents[i]->discard(checkpoints.front().replay_pos[i]);
+    }
+  }
+}
+
+template <typename WORD_T>
+size_t recorder<WORD_T>::pages_bytes(const checkpoint_t &checkpoint) {
+  size_t n = 0;
+  for (const auto &pages : checkpoint.pages) {
+    n += pages.size();
+  }
+  return n * libcpu::memory_journal::page_size;
+}
+
+} // namespace libsdb
+
+#endif
@@ -1,17 +1,32 @@
 #ifndef LIBSDB_SDB_HH
 #define LIBSDB_SDB_HH
 
+#include <chrono>
 #include <climits>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
 #include <iomanip>
 #include <ios>
 #include <iostream>
+#include <istream>
+#include <map>
 #include <libcpu/abstract_cpu.hh>
+#include <libcpu/breakpoint.hh>
+#include <libcpu/coverage.hh>
+#include <libcpu/cache.hh>
+#include <libcpu/dataflow.hh>
 #include <libcpu/event.hh>
+#include <libcpu/profiler.hh>
+#include <libcpu/sampler.hh>
+#include <libcpu/symbols.hh>
+#include <libcpu/watchpoint.hh>
 #include <libsdb/commandline.hh>
 #include <libsdb/expression.hh>
+#include <libsdb/reverse.hh>
+#include <libvio/phase.hh>
+#include <memory>
 #include <ostream>
 #include <stddef.h>
 #include <string>
@@ -39,16 +54,59 @@ public:
     const char *help; /**< Help text for the command */
   };
 
+  /**
+   * @struct script_line_t
+   * @brief A command of a script, parsed and resolved in advance.
+   */
+  using script_line_t = struct {
+    size_t line_no;           /**< Line number in the script, from 1 */
+    const command_def_t *def; /**< Command, nullptr if not in `commands` */
+    command_t cmd;            /**< The parsed command */
+  };
+
+  /**
+   * @enum stop_reason_t
+   * @brief Why the last execution of instructions ended.
+   */
+  enum class stop_reason_t {
+    none,       /**< No instruction has been executed */
+    steps_done, /**< The requested number of steps were executed */
+    breakpoint, /**< A breakpoint was hit */
+    watchpoint, /**< A watchpoint was triggered */
+    trap,       /**< A trap was taken with `break trap on` */
+    cpu_stopped /**< The CPU stopped, e.g. on `ebreak` or difftest error */
+  };
+
+  /**
+   * @struct run_stats_t
+   * @brief Statistics of running a script.
+   */
+  using run_stats_t = struct {
+    size_t lines;              /**< Number of commands executed */
+    size_t instructions;       /**< Number of instructions executed */
+    double host_seconds;       /**< Host time spent on the script */
+    stop_reason_t stop_reason; /**< Why the last execution ended */
+  };
+
   /**
    * @struct watchpoint_t
    * @brief Watchpoint definition structure.
    */
   using watchpoint_t = struct {
     std::string str; /**< String representation of the watch expression */
-    std::vector<token_t> expr; /**< Parsed post-fix expression for evaluation */
+    compiled_expression<WORD_T> expr; /**< Compiled expression to evaluate */
     std::optional<WORD_T> old_value; /**< Previous value for change detection */
   };
 
+  /**
+   * @struct condition_t
+   * @brief Condition of a conditional breakpoint.
+   */
+  using condition_t = struct {
+    std::string str; /**< String representation of the condition */
+    compiled_expression<WORD_T> expr; /**< Compiled expression to evaluate */
+  };
+
   // Command function declarations
   static void cmd_help(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
                        std::ostream &os);
@@ -72,6 +130,28 @@ public:
                         std::ostream &os);
   static void cmd_reset(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
                         std::ostream &os);
+  static void cmd_record(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                         std::ostream &os);
+  static void cmd_reverse_step(std::vector<std::string> args,
+                               sdb<WORD_T> *sdb_inst, std::ostream &os);
+  static void cmd_reverse_continue(std::vector<std::string> args,
+                                   sdb<WORD_T> *sdb_inst, std::ostream &os);
+  static void cmd_reverse_watch(std::vector<std::string> args,
+                                sdb<WORD_T> *sdb_inst, std::ostream &os);
+  static void cmd_profile(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                          std::ostream &os);
+  static void cmd_symbols(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                          std::ostream &os);
+  static void cmd_sample(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                         std::ostream &os);
+  static void cmd_coverage(std::vector<std::string> args,
+                           sdb<WORD_T> *sdb_inst, std::ostream &os);
+  static void cmd_phases(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                         std::ostream &os);
+  static void cmd_dataflow(std::vector<std::string> args,
+                           sdb<WORD_T> *sdb_inst, std::ostream &os);
+  static void cmd_cache(std::vector<std::string> args, sdb<WORD_T> *sdb_inst,
+                        std::ostream &os);
 
   /**
    * @var commands
@@ -79,7 +159,7 @@ public:
    * @details Contains all debugger commands with their handlers, aliases, and
    * help text.
    */
-  static inline command_def_t commands[] = {
+  static inline const command_def_t commands[] = {
       {cmd_help, (const char *const[]){"help", "h", nullptr},
        "help: Show help for commands\n"
        "Usage:\n"
@@ -97,6 +177,43 @@ public:
        "step: Execute one or more instructions\n"
        "Usage:\n"
        "  step [n=1]"},
+      {cmd_record, (const char *const[]){"record", "rec", nullptr},
+       "record: Record execution, so it can be reversed\n"
+       "Usage:\n"
+       "  record start [interval] [budget]\n"
+       "               - Start recording from the current state\n"
+       "  record stop  - Stop recording and drop the history\n"
+       "  record       - Show the recorded history\n"
+       "Arguments:\n"
+       "  interval - Instructions between snapshots (default 100000)\n"
+       "  budget   - Maximum size of the history in MiB (default 256)\n"
+       "Note:\n"
+       "  Reversing costs at most <interval> instructions of re-execution.\n"
+       "  The oldest snapshots are dropped to stay within the budget."},
+      {cmd_reverse_step,
+       (const char *const[]){"reverse-step", "rs", "rsi", nullptr},
+       "reverse-step: Move back one or more instructions\n"
+       "Usage:\n"
+       "  reverse-step [n=1]"},
+      {cmd_reverse_continue,
+       (const char *const[]){"reverse-continue", "rc", nullptr},
+       "reverse-continue: Move back to the last breakpoint or data "
+       "watchpoint\n"
+       "Usage:\n"
+       "  reverse-continue\n"
+       "Note:\n"
+       "  Expression watchpoints and trap breakpoints are not checked."},
+      {cmd_reverse_watch,
+       (const char *const[]){"reverse-watch", "rw", nullptr},
+       "reverse-watch: Move back to the last access to watched memory\n"
+       "Usage:\n"
+       "  reverse-watch              - Stop at any data watchpoint\n"
+       "  reverse-watch <addr> [len] - Stop at the last store to a range\n"
+       "Arguments:\n"
+       "  <addr> - Starting address of the range (expression)\n"
+       "  [len]  - Length of the range in bytes (default: word size)\n"
+       "Note:\n"
+       "  The CPU stops right after the accessing instruction."},
       {cmd_status, (const char *const[]){"status", "st", "regs", "r", nullptr},
        "status: Show current PC and general purpose registers\n"
        "Usage:\n"
@@ -112,19 +229,31 @@ public:
        "watch: Manage watchpoints\n"
        "Usage:\n"
        "  watch <expr> - Set a watchpoint on an expression\n"
+       "  watch mem <addr> <len> [r|w|rw]\n"
+       "               - Set a data watchpoint on a range of memory\n"
        "  watch ls     - List all watchpoints\n"
        "  watch rm <n> - Remove watchpoint by index\n"
        "Arguments:\n"
        "  <expr> - Expression to monitor\n"
-       "  <n>    - Index of watchpoint to remove"},
+       "  <addr> - Starting address of the range (expression)\n"
+       "  <len>  - Length of the range in bytes (expression)\n"
+       "  r|w|rw - Stop on loads, stores (default) or both\n"
+       "  <n>    - Index of watchpoint to remove\n"
+       "Note:\n"
+       "  Data watchpoints stop right after the accessing instruction and\n"
+       "  cost nothing on unwatched pages, expression watchpoints are\n"
+       "  evaluated after every instruction."},
       {cmd_break, (const char *const[]){"break", "b", "br", nullptr},
        "break: Manage breakpoints\nUsage:\n"
        "  break <addr>      - Set breakpoint at address\n"
+       "  break <addr> if <cond>\n"
+       "                    - Set breakpoint stopping only if <cond> is not 0\n"
        "  break ls          - List all breakpoints\n"
        "  break rm <n>      - Remove breakpoint by index\n"
        "  break trap on|off - Enable/disable trap breakpoints\n"
        "Arguments:\n"
        "  <addr> - Address expression for breakpoint\n"
+       "  <cond> - Expression evaluated when the PC reaches <addr>\n"
        "  <n>    - Index of breakpoint to remove\n"
        "  on|off - Enable or disable trap breakpoints"},
       {cmd_eval,
@@ -135,6 +264,86 @@ public:
       {cmd_trace, (const char *const[]){"trace", "t", "log", "events", nullptr},
        "trace: show event logs\nUsage:\n"
        "  trace [instr] [mem] [func] [trap]"},
+      {cmd_profile, (const char *const[]){"profile", "prof", nullptr},
+       "profile: Count instructions per function and call stack\n"
+       "Usage:\n"
+       "  profile start   - Start profiling in the current function\n"
+       "  profile stop    - Stop profiling and drop the profile\n"
+       "  profile [n=20]  - Show the <n> functions with most instructions\n"
+       "  profile folded <file>\n"
+       "                  - Write the call stacks for flame graph tools\n"
+       "Note:\n"
+       "  Calls and returns are detected from jal and jalr with ra or t0\n"
+       "  as the link register. Functions are named by `symbols`."},
+      {cmd_sample, (const char *const[]){"sample", "samp", nullptr},
+       "sample: Sample the PC to find hotspots\n"
+       "Usage:\n"
+       "  sample start [interval=10007] [random]\n"
+       "                 - Start sampling every <interval> instructions\n"
+       "  sample stop    - Stop sampling and drop the samples\n"
+       "  sample [n=20]  - Show the <n> hottest functions and PCs\n"
+       "  sample perf <file>\n"
+       "                 - Write the samples as `perf script` output\n"
+       "Arguments:\n"
+       "  random - Draw each interval from [interval/2, 3*interval/2]\n"
+       "Note:\n"
+       "  Sampling costs nothing per instruction. Functions are named by\n"
+       "  `symbols`."},
+      {cmd_coverage, (const char *const[]){"coverage", "cov", nullptr},
+       "coverage: Record the control flow edges and basic blocks executed\n"
+       "Usage:\n"
+       "  coverage start [blocks]\n"
+       "                   - Start recording the edges, and the basic blocks\n"
+       "                     with `blocks`\n"
+       "  coverage stop    - Stop recording and drop the coverage\n"
+       "  coverage         - Show the number of edges and blocks covered\n"
+       "  coverage blocks  - List the basic blocks covered\n"
+       "  coverage save <file>\n"
+       "                   - Save the coverage to a file\n"
+       "  coverage merge <file>...\n"
+       "                   - Merge the coverage saved in files\n"
+       "Note:\n"
+       "  Edges are jumps, branches taken or not, traps and trap returns.\n"
+       "  They are hashed into a 64 KiB bitmap as in AFL, so two edges may\n"
+       "  share an entry. Basic blocks are recorded exactly."},
+      {cmd_phases, (const char *const[]){"phases", "phase", nullptr},
+       "phases: Show the host time spent in each phase of the simulation\n"
+       "Usage:\n"
+       "  phases       - Show the ticks per phase and per instruction\n"
+       "  phases reset - Clear the ticks\n"
+       "Note:\n"
+       "  Ticks are read from the time stamp counter on x86. Phase profiling\n"
+       "  is compiled in with the meson option `-Dphase_profile=true`."},
+      {cmd_dataflow, (const char *const[]){"dataflow", "df", nullptr},
+       "dataflow: Estimate the ILP of the instructions executed\n"
+       "Usage:\n"
+       "  dataflow start [window=256]\n"
+       "                 - Start analyzing, with up to <window> instructions\n"
+       "                   in flight\n"
+       "  dataflow stop  - Stop analyzing and drop the results\n"
+       "  dataflow       - Show the ILP, the critical path and the\n"
+       "                   dependence distances\n"
+       "Note:\n"
+       "  Registers and memory are renamed as in SSA form, so only true\n"
+       "  dependences are kept. The analysis reads the event buffer, so\n"
+       "  event tracing must be on, and `source_gprs` must be set."},
+      {cmd_cache, (const char *const[]){"cache", "ca", nullptr},
+       "cache: Simulate caches on the accesses executed\n"
+       "Usage:\n"
+       "  cache start [l1i=<spec>] [l1d=<spec>] [l2=<spec>|none]\n"
+       "              - Start simulating, by default with 32k:8:64 L1s and\n"
+       "                a 512k:16:64 L2\n"
+       "  cache stop  - Stop simulating and drop the results\n"
+       "  cache       - Show the hit rates, MPKI and reuse distances\n"
+       "Note:\n"
+       "  A spec is size:ways:line[:lru|plru|random][:wb|wt][:wa|nwa], with\n"
+       "  the size in bytes or with a k or m suffix. The simulation reads the\n"
+       "  event buffer, so event tracing must be on."},
+      {cmd_symbols, (const char *const[]){"symbols", "sym", nullptr},
+       "symbols: Load function symbols\n"
+       "Usage:\n"
+       "  symbols <file> - Load the function symbols of an ELF file\n"
+       "  symbols        - Show the number of symbols"},
       {cmd_reset, (const char *const[]){"reset", "rst", nullptr},
        "reset: reset the cpu\n"
        "Usage:\n"
@@ -144,6 +353,12 @@ public:
 
   libcpu::abstract_cpu<WORD_T> *cpu =
       nullptr; /**< Pointer to CPU instance being debugged */
+  std::ostream *out =
+      &std::cout; /**< Output of commands not piped to a shell command */
+  libcpu::symbol_table symbols = {}; /**< Symbols naming the functions */
+  typename libcpu::dataflow_analyzer<WORD_T>::source_fn source_gprs =
+      nullptr; /**< Decoder of the registers read by an instruction, e.g.
+                  `libcpu::riscv::source_gprs`, needed by `dataflow` */
 
   /**
    * @brief Check if debugger is in stopped state
@@ -183,15 +398,86 @@ public:
    */
   virtual const char *get_prompt(void) const;
 
+  /**
+   * @brief Find a command by name or alias
+   * @param name Name of the command
+   * @return The command definition, nullptr if not found
+   */
+  static const command_def_t *find_command(const std::string &name);
+
+  /**
+   * @brief Parse a script of commands, one per line
+   *
+   * Empty lines and lines starting with `#` are skipped. Commands are looked
+   * up once here instead of on each execution. Commands not in `commands`
+   * are left for `execute_command()`, so derived debuggers can handle them.
+   *
+   * @param in Input stream of the script
+   * @param err Output stream for syntax errors
+   * @return The parsed script, nullopt if any line has a syntax error
+   */
+  static std::optional<std::vector<script_line_t>>
+  parse_script(std::istream &in, std::ostream &err);
+
+  /**
+   * @brief Run a parsed script without interaction
+   *
+   * The script runs until its end or until `quit`. Output to `out` is
+   * passed on in large blocks instead of being flushed on each line.
+   *
+   * @param script The parsed script
+   * @return Statistics of the run
+   */
+  run_stats_t run_script(const std::vector<script_line_t> &script);
+
+  /**
+   * @brief Print the statistics of running a script
+   * @param stats The statistics
+   * @param os Output stream for the summary
+   */
+  static void print_stats(const run_stats_t &stats, std::ostream &os);
+
 protected:
   bool is_stopped = false; /**< Internal stopped state flag */
+  size_t instructions = 0; /**< Instructions executed by the debugger */
+  size_t phase_instructions =
+      0; /**< Instructions executed when the phase profile was reset */
+  stop_reason_t stop_reason =
+      stop_reason_t::none; /**< Why the last execution ended */
 
-  std::vector<WORD_T> breakpoints = {}; /**< Active breakpoint addresses */
+  libcpu::breakpoint_set<WORD_T>
+      breakpoints = {}; /**< Active breakpoint addresses */
+  std::map<WORD_T, condition_t>
+      conditions = {}; /**< Conditions of conditional breakpoints */
   std::vector<watchpoint_t> watchpoints = {}; /**< Active watchpoints */
+  libcpu::watchpoint_set<WORD_T>
+      data_watchpoints = {}; /**< Active data watchpoints, numbered after
+                                `watchpoints` */
   bool breakpoint_on_trap = false; /**< Whether to break on CPU traps */
+  std::unique_ptr<recorder<WORD_T>>
+      recording = nullptr; /**< Recorded history, nullptr if not recording */
+  std::unique_ptr<libcpu::call_profiler<WORD_T>>
+      profile = nullptr; /**< Function profile, nullptr if not profiling */
+  std::unique_ptr<libcpu::pc_sampler<WORD_T>>
+      sampler = nullptr; /**< PC samples, nullptr if not sampling */
+  std::unique_ptr<libcpu::coverage_map>
+      coverage = nullptr; /**< Coverage, nullptr if not recording coverage */
+  std::unique_ptr<libcpu::dataflow_analyzer<WORD_T>>
+      dataflow = nullptr; /**< ILP analysis, nullptr if not analyzing */
+  size_t dataflow_index = 0; /**< Next event for the ILP analysis */
+  std::unique_ptr<libcpu::cache_hierarchy>
+      cache = nullptr; /**< Cache simulation, nullptr if not simulating */
+  size_t cache_index = 0; /**< Next event for the cache simulation */
+
+  /**
+   * @brief Compile an expression for repeated evaluation on the current CPU
+   * @param expr The expression
+   * @return The compiled expression, nullopt if invalid
+   */
+  std::optional<compiled_expression<WORD_T>> compile(const std::string &expr);
 
   /**
-   * @brief Check if current PC matches any breakpoint
+   * @brief Check if current PC matches any breakpoint whose condition holds
    * @param os Output stream for notifications
    * @return true if breakpoint hit, false otherwise
    */
@@ -204,6 +490,13 @@ protected:
    */
   bool check_watchpoints(std::ostream &os);
 
+  /**
+   * @brief Report and clear a triggered data watchpoint
+   * @param os Output stream for notifications
+   * @return true if a data watchpoint triggered, false otherwise
+   */
+  bool check_data_watchpoints(std::ostream &os);
+
   /**
    * @brief Check if CPU is in trap state
    * @param os Output stream for notifications
@@ -211,12 +504,65 @@ protected:
    */
   bool check_trap(std::ostream &os);
 
+  /**
+   * @brief Pass the new events to the ILP analysis and the cache simulation,
+   * if any
+   *
+   * It must be called at least once per `event_chunk()` instructions, so the
+   * event buffer does not overwrite events not consumed yet.
+   */
+  void feed_events(void);
+
+  /**
+   * @brief Get the number of instructions that fit in the event buffer
+   * @return Instructions to run between calls to `feed_events()`
+   */
+  size_t event_chunk(void) const {
+    // an instruction logs its issue, a memory access, a register write and
+    // at most two calls or returns
+    return std::max<size_t>(cpu->event_buffer->capacity() / 5, 1);
+  }
+
+  /**
+   * @brief Run a resolved command, writing to `out` or to its pipe
+   * @param def The command definition
+   * @param cmd The parsed command
+   */
+  void run_command(const command_def_t &def, const command_t &cmd);
+
   /**
    * @brief Execute single-step operations
    * @param n Number of steps to execute
    * @param os Output stream for step notifications
    */
   void execute_steps(size_t n, std::ostream &os);
+
+  /**
+   * @brief Get the recording of the current CPU
+   * @param os Output stream for notifications
+   * @return The recorder, nullptr if the current CPU is not recorded
+   */
+  recorder<WORD_T> *get_recording(std::ostream &os);
+
+  /**
+   * @brief Move back to the last point where execution would have stopped
+   *
+   * The history is searched backwards one snapshot interval at a time. On
+   * success, the CPU is right after the instruction causing the stop, with
+   * the data watchpoint hit, if any, recorded in `data->hit`.
+   *
+   * @param use_breakpoints Whether to stop at breakpoints
+   * @param data Data watchpoints to stop at, may be nullptr
+   * @return true if such a point is found, false if the CPU is moved to the
+   * start of the history
+   */
+  bool reverse_search(bool use_breakpoints,
+                      libcpu::watchpoint_set<WORD_T> *data);
+
+  /**
+   * @brief Update the old values of expression watchpoints after moving back
+   */
+  void refresh_watchpoints(void);
 };
 
 template <typename WORD_T> bool sdb<WORD_T>::stopped(void) const {
@@ -270,20 +616,120 @@ template <typename WORD_T> void sdb<WORD_T>::execute_command(command_t cmd) {
   if (cpu == nullptr) {
     return;
   }
+  const command_def_t *def = find_command(cmd.sdb_command);
+  if (def == nullptr) {
+    std::cerr << "libsdb: Command not found." << std::endl;
+    return;
+  }
+  run_command(*def, cmd);
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::run_command(const command_def_t &def, const command_t &cmd) {
+  if (cmd.pipe_command.has_value()) {
+    popen_ostream os{cmd.pipe_command.value()};
+    def.func(cmd.args, this, os);
+  } else {
+    def.func(cmd.args, this, *out);
+  }
+}
+
+template <typename WORD_T>
+const typename sdb<WORD_T>::command_def_t *
+sdb<WORD_T>::find_command(const std::string &name) {
   for (const command_def_t &def : commands) {
     for (size_t i = 0; def.names[i] != nullptr; ++i) {
-      if (std::strcmp(def.names[i], cmd.sdb_command.c_str()) == 0) {
-        if (cmd.pipe_command.has_value()) {
-          popen_ostream os{cmd.pipe_command.value()};
-          def.func(cmd.args, this, os);
-        } else {
-          def.func(cmd.args, this, std::cout);
-        }
-        return;
+      if (name == def.names[i]) {
+        return &def;
       }
     }
   }
-  std::cerr << "libsdb: Command not found." << std::endl;
+  return nullptr;
+}
+
+template <typename WORD_T>
+std::optional<std::vector<typename sdb<WORD_T>::script_line_t>>
+sdb<WORD_T>::parse_script(std::istream &in, std::ostream &err) {
+  std::vector<script_line_t> script;
+  bool valid = true;
+  std::string line;
+  for (size_t line_no = 1; std::getline(in, line); ++line_no) {
+    size_t begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos || line[begin] == '#') {
+      continue;
+    }
+    auto tokens = tokenize_command(line);
+    auto cmd = tokens.has_value() ? parse_command(tokens.value())
+                                  : std::optional<command_t>{};
+    if (!cmd.has_value()) {
+      err << "libsdb: command syntax error at line " << std::dec << line_no
+          << "." << std::endl;
+      valid = false;
+      continue;
+    }
+    script.push_back({line_no, find_command(cmd->sdb_command),
+                      std::move(cmd.value())});
+  }
+  if (!valid) {
+    return std::nullopt;
+  }
+  return script;
+}
+
+template <typename WORD_T>
+typename sdb<WORD_T>::run_stats_t
+sdb<WORD_T>::run_script(const std::vector<script_line_t> &script) {
+  // collect the output, the original stream gets it in large blocks
+  std::ostream *original = out;
+  batch_output_buffer buffer{original->rdbuf()};
+  std::ostream batch{&buffer};
+  batch.copyfmt(*original);
+  out = &batch;
+  // commands may throw, the stream must not be left pointing at `batch`
+  struct restore_t {
+    std::ostream *&out;
+    std::ostream *original;
+    batch_output_buffer &buffer;
+    ~restore_t() {
+      buffer.drain();
+      out = original;
+    }
+  } restore{out, original, buffer};
+
+  size_t start_instructions = instructions;
+  auto begin = std::chrono::steady_clock::now();
+  size_t lines = 0;
+  for (const script_line_t &line : script) {
+    if (is_stopped || cpu == nullptr) {
+      break;
+    }
+    if (line.def != nullptr) {
+      run_command(*line.def, line.cmd);
+    } else {
+      execute_command(line.cmd);
+    }
+    ++lines;
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  return {lines, instructions - start_instructions,
+          std::chrono::duration<double>(end - begin).count(), stop_reason};
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::print_stats(const run_stats_t &stats, std::ostream &os) {
+  const char *reasons[] = {"none",       "steps done", "breakpoint",
+                           "watchpoint", "trap",       "CPU stopped"};
+  double mips = stats.host_seconds > 0
+                    ? stats.instructions / stats.host_seconds / 1e6
+                    : 0;
+  os << std::dec << "Commands:     " << stats.lines << "\n"
+     << "Instructions: " << stats.instructions << "\n"
+     << "Host time:    " << std::fixed << std::setprecision(3)
+     << stats.host_seconds << " s\n"
+     << "MIPS:         " << std::setprecision(2) << mips << "\n"
+     << "Stop reason:  " << reasons[static_cast<size_t>(stats.stop_reason)]
+     << std::defaultfloat << std::endl;
 }
 
 // Command function implementations
@@ -420,20 +866,57 @@ void sdb<WORD_T>::cmd_watch(std::vector<std::string> args,
     return;
   }
 
+  size_t n_expr = sdb_inst->watchpoints.size();
   if (args[0] == "ls") {
     // List watchpoints
-    if (sdb_inst->watchpoints.empty()) {
+    if (sdb_inst->watchpoints.empty() && sdb_inst->data_watchpoints.empty()) {
       os << "No watchpoints set\n";
       return;
     }
 
-    for (size_t i = 0; i < sdb_inst->watchpoints.size(); i++) {
+    for (size_t i = 0; i < n_expr; i++) {
       os << "[" << i << "] " << sdb_inst->watchpoints[i].str;
       if (sdb_inst->watchpoints[i].old_value.has_value()) {
         os << " = 0x" << std::hex << sdb_inst->watchpoints[i].old_value.value();
       }
       os << "\n";
     }
+    for (size_t i = 0; i < sdb_inst->data_watchpoints.size(); i++) {
+      const auto &range = sdb_inst->data_watchpoints[i];
+      const char *access =
+          range.access == libcpu::watch_access_t::read    ? "r"
+          : range.access == libcpu::watch_access_t::write ? "w"
+                                                          : "rw";
+      os << "[" << n_expr + i << "] mem 0x" << std::hex << range.addr
+         << " 0x" << range.len << " " << access << "\n";
+    }
+  } else if (args[0] == "mem") {
+    // Set data watchpoint
+    if (args.size() != 3 && args.size() != 4) {
+      show_command_help("watch", os);
+      return;
+    }
+    auto addr = evaluate_expression(args[1], sdb_inst->cpu);
+    auto len = evaluate_expression(args[2], sdb_inst->cpu);
+    if (!addr.has_value() || !len.has_value() || len.value() == 0) {
+      os << "libsdb: Invalid expression in arguments." << std::endl;
+      return;
+    }
+    auto access = libcpu::watch_access_t::write;
+    if (args.size() == 4) {
+      if (args[3] == "r") {
+        access = libcpu::watch_access_t::read;
+      } else if (args[3] == "rw") {
+        access = libcpu::watch_access_t::read_write;
+      } else if (args[3] != "w") {
+        os << "Invalid access type (must be 'r', 'w' or 'rw')\n";
+        return;
+      }
+    }
+    sdb_inst->data_watchpoints.insert(addr.value(), len.value(), access);
+    os << "Watchpoint [" << n_expr + sdb_inst->data_watchpoints.size() - 1
+       << "] set: mem 0x" << std::hex << addr.value() << " 0x" << len.value()
+       << "\n";
   } else if (args[0] == "rm") {
     // Remove watchpoint
     if (args.size() < 2) {
@@ -442,11 +925,15 @@ void sdb<WORD_T>::cmd_watch(std::vector<std::string> args,
     }
 
     size_t idx = std::stoul(args[1]);
-    if (idx >= sdb_inst->watchpoints.size()) {
+    if (idx >= n_expr + sdb_inst->data_watchpoints.size()) {
       os << "Invalid watchpoint index\n";
       return;
     }
-    sdb_inst->watchpoints.erase(sdb_inst->watchpoints.begin() + idx);
+    if (idx < n_expr) {
+      sdb_inst->watchpoints.erase(sdb_inst->watchpoints.begin() + idx);
+    } else {
+      sdb_inst->data_watchpoints.erase(idx - n_expr);
+    }
     os << "Removed watchpoint " << idx << "\n";
   } else {
     // Set watchpoint
@@ -455,18 +942,16 @@ void sdb<WORD_T>::cmd_watch(std::vector<std::string> args,
       expr_str += arg + " ";
     }
 
-    auto tokens = tokenize_expression(expr_str);
-    auto parsed = parse_expression(tokens);
-    if (!parsed.has_value()) {
+    auto compiled = sdb_inst->compile(expr_str);
+    if (!compiled.has_value()) {
       os << "Invalid expression\n";
       return;
     }
 
     watchpoint_t wp;
     wp.str = expr_str;
-    wp.expr = parsed.value();
-    specialize_expression(wp.expr, *(sdb_inst->cpu));
-    auto val = evaluate_expression(wp.expr, sdb_inst->cpu);
+    wp.expr = compiled.value();
+    auto val = wp.expr.evaluate(sdb_inst->cpu);
     if (val.has_value()) {
       wp.old_value = val.value();
     }
@@ -494,7 +979,13 @@ void sdb<WORD_T>::cmd_break(std::vector<std::string> args,
     }
 
     for (size_t i = 0; i < sdb_inst->breakpoints.size(); i++) {
-      os << "[" << i << "] 0x" << std::hex << sdb_inst->breakpoints[i] << "\n";
+      WORD_T addr = sdb_inst->breakpoints[i];
+      os << "[" << i << "] 0x" << std::hex << addr;
+      auto it = sdb_inst->conditions.find(addr);
+      if (it != sdb_inst->conditions.end()) {
+        os << " if " << it->second.str;
+      }
+      os << "\n";
     }
   } else if (args[0] == "rm") {
     // Remove breakpoint by index
@@ -508,8 +999,8 @@ void sdb<WORD_T>::cmd_break(std::vector<std::string> args,
       os << "Invalid breakpoint index\n";
       return;
     }
-    WORD_T addr = sdb_inst->breakpoints[idx];
-    sdb_inst->breakpoints.erase(sdb_inst->breakpoints.begin() + idx);
+    WORD_T addr = sdb_inst->breakpoints.erase(idx);
+    sdb_inst->conditions.erase(addr);
     os << "Removed breakpoint [" << idx << "] at 0x" << std::hex << addr
        << "\n";
   } else if (args[0] == "trap") {
@@ -529,42 +1020,76 @@ void sdb<WORD_T>::cmd_break(std::vector<std::string> args,
       os << "Invalid argument (must be 'on' or 'off')\n";
     }
   } else {
-    // Set breakpoint at address
-    std::string expr_str;
+    // Set breakpoint at address, with an optional condition after `if`
+    std::string expr_str, cond_str;
+    bool has_cond = false;
     for (const auto &arg : args) {
-      expr_str += arg + " ";
+      if (arg == "if" && !has_cond) {
+        has_cond = true;
+      } else {
+        (has_cond ? cond_str : expr_str) += arg + " ";
+      }
     }
     auto addr = evaluate_expression(expr_str, sdb_inst->cpu);
     if (!addr.has_value()) {
       os << "libsdb: Invalid expression in arguments." << std::endl;
       return;
     }
+    std::optional<compiled_expression<WORD_T>> cond;
+    if (has_cond) {
+      cond = sdb_inst->compile(cond_str);
+      if (!cond.has_value()) {
+        os << "libsdb: Invalid expression in condition." << std::endl;
+        return;
+      }
+    }
 
-    // Check if breakpoint already exists
-    auto it = std::find(sdb_inst->breakpoints.begin(),
-                        sdb_inst->breakpoints.end(), addr.value());
-    if (it != sdb_inst->breakpoints.end()) {
+    if (!sdb_inst->breakpoints.insert(addr.value())) {
       os << "Breakpoint already exists at 0x" << std::hex << addr.value()
          << "\n";
       return;
     }
+    if (cond.has_value()) {
+      sdb_inst->conditions[addr.value()] = {cond_str, cond.value()};
+    }
 
-    sdb_inst->breakpoints.push_back(addr.value());
     os << "Breakpoint [" << sdb_inst->breakpoints.size() - 1 << "] set at 0x"
        << std::hex << addr.value() << "\n";
   }
 }
 
+template <typename WORD_T>
+std::optional<compiled_expression<WORD_T>>
+sdb<WORD_T>::compile(const std::string &expr) {
+  auto parsed = parse_expression(tokenize_expression(expr));
+  if (!parsed.has_value()) {
+    return std::nullopt;
+  }
+  return compiled_expression<WORD_T>::compile(parsed.value(), cpu);
+}
+
 template <typename WORD_T>
 bool sdb<WORD_T>::check_breakpoints(std::ostream &os) {
   WORD_T pc = cpu->get_pc();
-  for (const WORD_T &bp : breakpoints) {
-    if (bp == pc) {
-      os << "Breakpoint at 0x" << std::hex << pc << std::endl;
-      return true;
+  if (!breakpoints.contains(pc)) {
+    return false;
+  }
+  auto it = conditions.find(pc);
+  if (it != conditions.end()) {
+    // a condition failing to evaluate also stops, so the user can look at it
+    auto val = it->second.expr.evaluate(cpu);
+    if (val.has_value() && val.value() == 0) {
+      return false;
+    }
+    os << "Breakpoint at 0x" << std::hex << pc << " if " << it->second.str;
+    if (!val.has_value()) {
+      os << "(evaluation failed)";
     }
+    os << std::endl;
+    return true;
   }
-  return false;
+  os << "Breakpoint at 0x" << std::hex << pc << std::endl;
+  return true;
 }
 
 template <typename WORD_T>
@@ -679,6 +1204,11 @@ void sdb<WORD_T>::cmd_reset(std::vector<std::string> args,
     auto init_pc_opt = evaluate_expression(expr_str, sdb_inst->cpu);
     if (init_pc_opt.has_value()) {
       WORD_T init_pc = init_pc_opt.value();
+      // the history cannot be replayed across a reset
+      if (sdb_inst->recording != nullptr) {
+        sdb_inst->recording.reset();
+        os << "Recording stopped" << std::endl;
+      }
       sdb_inst->cpu->reset(init_pc);
     } else {
       os << "libsdb: Invalid expression in arguments." << std::endl;
@@ -690,7 +1220,7 @@ void sdb<WORD_T>::cmd_reset(std::vector<std::string> args,
 template <typename WORD_T>
 bool sdb<WORD_T>::check_watchpoints(std::ostream &os) {
   for (auto &wp : watchpoints) {
-    auto new_val = evaluate_expression(wp.expr, cpu);
+    auto new_val = wp.expr.evaluate(cpu);
     if (new_val.has_value() && wp.old_value.has_value() &&
         wp.old_value.value() != new_val.value()) {
       os << "Watchpoint " << wp.str << " changed: old = ";
@@ -707,6 +1237,25 @@ bool sdb<WORD_T>::check_watchpoints(std::ostream &os) {
   return false;
 }
 
+template <typename WORD_T>
+bool sdb<WORD_T>::check_data_watchpoints(std::ostream &os) {
+  if (!data_watchpoints.hit.has_value()) {
+    return false;
+  }
+  auto hit = data_watchpoints.hit.value();
+  data_watchpoints.hit.reset();
+  os << "Watchpoint [" << std::dec << watchpoints.size() + hit.index
+     << "] triggered: " << (hit.is_write ? "store" : "load") << " of "
+     << static_cast<unsigned>(hit.width) << " bytes at 0x" << std::hex
+     << hit.addr << " by instruction at 0x" << hit.pc;
+  auto val = cpu->vmem_peek(hit.addr, hit.width);
+  if (val.has_value()) {
+    os << ", value = 0x" << val.value();
+  }
+  os << std::endl;
+  return true;
+}
+
 template <typename WORD_T> bool sdb<WORD_T>::check_trap(std::ostream &os) {
   if (breakpoint_on_trap && cpu->get_trap().has_value()) {
     os << "Trap encountered: cause=0x" << std::hex << cpu->get_trap().value()
@@ -718,16 +1267,620 @@ template <typename WORD_T> bool sdb<WORD_T>::check_trap(std::ostream &os) {
 
 template <typename WORD_T>
 void sdb<WORD_T>::execute_steps(size_t n, std::ostream &os) {
-  for (size_t i = 0; i < n; i++) {
+  // data watchpoints are checked by the CPU on loads and stores
+  cpu->watchpoints = data_watchpoints.empty() ? nullptr : &data_watchpoints;
+  cpu->profiler = profile.get();
+  cpu->sampler = sampler.get();
+  cpu->coverage = coverage.get();
+  data_watchpoints.hit.reset();
+  // without expression watchpoints and trap breakpoints, the rest is checked
+  // inside the run loop of the CPU
+  bool run_fast = watchpoints.empty() && !breakpoint_on_trap;
+  // the recorded CPU must not run past a due snapshot
+  if (recording != nullptr && recording->get_cpu() != cpu) {
+    recording.reset();
+    os << "Recording stopped, another CPU is running" << std::endl;
+  }
+  size_t i = 0;
+  stop_reason = stop_reason_t::steps_done;
+  while (i < n) {
     if (cpu->stopped()) {
       os << "CPU stopped" << std::endl;
+      stop_reason = stop_reason_t::cpu_stopped;
       break;
     }
-    cpu->next_instruction();
-    if (check_breakpoints(os) || check_watchpoints(os) || check_trap(os)) {
+    if (run_fast) {
+      size_t chunk = n - i;
+      if (recording != nullptr) {
+        chunk = std::min(chunk, recording->until_checkpoint());
+      }
+      if ((dataflow != nullptr || cache != nullptr) &&
+          cpu->event_buffer != nullptr) {
+        chunk = std::min(chunk, event_chunk());
+      }
+      size_t done = cpu->run(chunk, &breakpoints);
+      i += done;
+      feed_events();
+      if (recording != nullptr) {
+        recording->advance(done);
+      }
+      bool data_hit = check_data_watchpoints(os);
+      // the last step may land on a breakpoint too, reported as when stepping
+      bool breakpoint_hit = check_breakpoints(os);
+      if (breakpoint_hit || data_hit) {
+        stop_reason = breakpoint_hit ? stop_reason_t::breakpoint
+                                     : stop_reason_t::watchpoint;
+        break;
+      }
+    } else {
+      // a single step through `run()` is sampled like the fast path
+      cpu->run(1, nullptr);
+      ++i;
+      feed_events();
+      if (recording != nullptr) {
+        recording->advance(1);
+      }
+      bool data_hit = check_data_watchpoints(os);
+      if (check_breakpoints(os)) {
+        stop_reason = stop_reason_t::breakpoint;
+      } else if (data_hit || check_watchpoints(os)) {
+        stop_reason = stop_reason_t::watchpoint;
+      } else if (check_trap(os)) {
+        stop_reason = stop_reason_t::trap;
+      } else {
+        continue;
+      }
       break;
     }
   }
+  if (stop_reason == stop_reason_t::steps_done && cpu->stopped()) {
+    stop_reason = stop_reason_t::cpu_stopped;
+  }
+  instructions += i;
+  cpu->watchpoints = nullptr;
+  cpu->profiler = nullptr;
+  cpu->sampler = nullptr;
+  cpu->coverage = nullptr;
+}
+
+template <typename WORD_T> void sdb<WORD_T>::feed_events(void) {
+  if (cpu->event_buffer == nullptr) {
+    return;
+  }
+  if (dataflow != nullptr) {
+    dataflow_index = dataflow->consume(*cpu->event_buffer, dataflow_index);
+    // runs end at instruction boundaries
+    dataflow->flush();
+  }
+  if (cache != nullptr) {
+    cache_index = cache->consume(*cpu->event_buffer, cache_index);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_record(std::vector<std::string> args,
+                             sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  if (args.empty()) {
+    auto rec = sdb_inst->get_recording(os);
+    if (rec != nullptr) {
+      os << "Recording " << std::dec << rec->position() - rec->first()
+         << " instructions in " << rec->size() << " snapshots, "
+         << rec->memory_usage() / 1024 << " KiB" << std::endl;
+    }
+  } else if (args[0] == "start" && args.size() <= 3) {
+    size_t interval = 100000;
+    size_t budget = 256;
+    for (size_t i = 1; i < args.size(); ++i) {
+      auto val = evaluate_expression(args[i], sdb_inst->cpu);
+      if (!val.has_value() || val.value() == 0) {
+        os << "libsdb: Invalid expression in arguments." << std::endl;
+        return;
+      }
+      (i == 1 ? interval : budget) = val.value();
+    }
+    if (sdb_inst->cpu->save_state() == nullptr) {
+      os << "The CPU does not support saving its state" << std::endl;
+      return;
+    }
+    sdb_inst->recording.reset();
+    sdb_inst->recording = std::make_unique<recorder<WORD_T>>(
+        sdb_inst->cpu, interval, budget << 20);
+    os << "Recording started" << std::endl;
+  } else if (args[0] == "stop" && args.size() == 1) {
+    sdb_inst->recording.reset();
+    os << "Recording stopped" << std::endl;
+  } else {
+    show_command_help("record", os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_profile(std::vector<std::string> args,
+                              sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto &profile = sdb_inst->profile;
+  if (!args.empty() && args[0] == "start" && args.size() == 1) {
+    profile = std::make_unique<libcpu::call_profiler<WORD_T>>(
+        sdb_inst->cpu->get_pc());
+    os << "Profiling started" << std::endl;
+  } else if (!args.empty() && args[0] == "stop" && args.size() == 1) {
+    profile.reset();
+    os << "Profiling stopped" << std::endl;
+  } else if (profile == nullptr && args.size() <= 2) {
+    os << "Not profiling, use `profile start` first" << std::endl;
+  } else if (!args.empty() && args[0] == "folded" && args.size() == 2) {
+    std::ofstream file{args[1]};
+    if (!file) {
+      os << "libsdb: Cannot open " << args[1] << "." << std::endl;
+      return;
+    }
+    profile->write_folded(file, sdb_inst->symbols);
+    os << "Wrote " << std::dec << profile->tree().size() << " call stacks to "
+       << args[1] << std::endl;
+  } else if (args.size() <= 1) {
+    size_t n = 20;
+    if (!args.empty()) {
+      auto val = evaluate_expression(args[0], sdb_inst->cpu);
+      if (!val.has_value()) {
+        os << "libsdb: Invalid expression in arguments." << std::endl;
+        return;
+      }
+      n = val.value();
+    }
+    auto functions = profile->functions(sdb_inst->symbols);
+    uint64_t total = std::max<uint64_t>(profile->total(), 1);
+    os << std::dec << profile->total() << " instructions, "
+       << profile->tree().size() << " call stacks, depth "
+       << profile->depth() << std::endl;
+    os << std::setw(12) << "inclusive" << std::setw(8) << "%" << std::setw(12)
+       << "exclusive" << std::setw(8) << "%" << std::setw(10) << "calls"
+       << "  function" << std::endl;
+    os << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < functions.size() && i < n; ++i) {
+      const auto &f = functions[i];
+      os << std::setw(12) << f.inclusive << std::setw(8)
+         << 100.0 * f.inclusive / total << std::setw(12) << f.exclusive
+         << std::setw(8) << 100.0 * f.exclusive / total << std::setw(10)
+         << f.calls << "  " << f.name << std::endl;
+    }
+    os << std::defaultfloat;
+  } else {
+    show_command_help("profile", os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_sample(std::vector<std::string> args,
+                             sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto &sampler = sdb_inst->sampler;
+  if (!args.empty() && args[0] == "start" && args.size() <= 3) {
+    size_t interval = 10007;
+    bool randomize = false;
+    for (size_t i = 1; i < args.size(); ++i) {
+      if (args[i] == "random") {
+        randomize = true;
+        continue;
+      }
+      auto val = evaluate_expression(args[i], sdb_inst->cpu);
+      if (!val.has_value() || val.value() == 0) {
+        os << "libsdb: Invalid expression in arguments." << std::endl;
+        return;
+      }
+      interval = val.value();
+    }
+    sampler =
+        std::make_unique<libcpu::pc_sampler<WORD_T>>(interval, randomize);
+    os << "Sampling started" << std::endl;
+  } else if (!args.empty() && args[0] == "stop" && args.size() == 1) {
+    sampler.reset();
+    os << "Sampling stopped" << std::endl;
+  } else if (sampler == nullptr && args.size() <= 2) {
+    os << "Not sampling, use `sample start` first" << std::endl;
+  } else if (!args.empty() && args[0] == "perf" && args.size() == 2) {
+    std::ofstream file{args[1]};
+    if (!file) {
+      os << "libsdb: Cannot open " << args[1] << "." << std::endl;
+      return;
+    }
+    sampler->write_perf_script(file, sdb_inst->symbols, "anemo");
+    os << "Wrote " << std::dec << sampler->samples() << " samples to "
+       << args[1] << std::endl;
+  } else if (args.size() <= 1) {
+    size_t n = 20;
+    if (!args.empty()) {
+      auto val = evaluate_expression(args[0], sdb_inst->cpu);
+      if (!val.has_value()) {
+        os << "libsdb: Invalid expression in arguments." << std::endl;
+        return;
+      }
+      n = val.value();
+    }
+    uint64_t total = std::max<uint64_t>(sampler->samples(), 1);
+    os << std::dec << sampler->samples() << " samples, one every "
+       << sampler->get_interval() << " instructions" << std::endl;
+    os << std::setw(10) << "samples" << std::setw(8) << "%"
+       << "  function" << std::endl;
+    os << std::fixed << std::setprecision(2);
+    auto functions = sampler->functions(sdb_inst->symbols);
+    for (size_t i = 0; i < functions.size() && i < n; ++i) {
+      os << std::setw(10) << functions[i].samples << std::setw(8)
+         << 100.0 * functions[i].samples / total << "  "
+         << functions[i].name << std::endl;
+    }
+    os << std::setw(10) << "samples" << std::setw(8) << "%"
+       << "  pc" << std::endl;
+    auto hotspots = sampler->hotspots();
+    for (size_t i = 0; i < hotspots.size() && i < n; ++i) {
+      auto [pc, count] = hotspots[i];
+      os << std::dec << std::setw(10) << count << std::setw(8)
+         << 100.0 * count / total << "  0x" << std::hex << pc;
+      if (sdb_inst->symbols.lookup(pc) != nullptr) {
+        os << " " << sdb_inst->symbols.name(pc);
+      }
+      os << std::endl;
+    }
+    os << std::dec << std::defaultfloat;
+  } else {
+    show_command_help("sample", os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_coverage(std::vector<std::string> args,
+                               sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto &coverage = sdb_inst->coverage;
+  if (!args.empty() && args[0] == "start" && args.size() <= 2) {
+    if (args.size() == 2 && args[1] != "blocks") {
+      show_command_help("coverage", os);
+      return;
+    }
+    coverage = std::make_unique<libcpu::coverage_map>(args.size() == 2);
+    coverage->block(sdb_inst->cpu->get_pc());
+    os << "Coverage started" << std::endl;
+  } else if (!args.empty() && args[0] == "stop" && args.size() == 1) {
+    coverage.reset();
+    os << "Coverage stopped" << std::endl;
+  } else if (coverage == nullptr) {
+    os << "Not recording coverage, use `coverage start` first" << std::endl;
+  } else if (args.empty()) {
+    os << std::dec << coverage->edges() << " of "
+       << libcpu::coverage_map::map_size << " edge entries";
+    if (coverage->tracks_blocks()) {
+      os << ", " << coverage->n_blocks() << " basic blocks";
+    }
+    os << std::endl;
+  } else if (args[0] == "blocks" && args.size() == 1) {
+    if (!coverage->tracks_blocks()) {
+      os << "Not recording basic blocks, use `coverage start blocks`"
+         << std::endl;
+      return;
+    }
+    for (uint64_t addr : coverage->get_blocks()) {
+      os << "0x" << std::hex << addr;
+      if (sdb_inst->symbols.lookup(addr) != nullptr) {
+        os << " " << sdb_inst->symbols.name(addr);
+      }
+      os << std::endl;
+    }
+    os << std::dec;
+  } else if (args[0] == "save" && args.size() == 2) {
+    if (!coverage->save(args[1].c_str())) {
+      os << "libsdb: Cannot write " << args[1] << "." << std::endl;
+      return;
+    }
+    os << "Coverage saved to " << args[1] << std::endl;
+  } else if (args[0] == "merge" && args.size() >= 2) {
+    size_t n_new = 0;
+    for (size_t i = 1; i < args.size(); ++i) {
+      auto merged = coverage->merge(args[i].c_str());
+      if (!merged.has_value()) {
+        os << "libsdb: Cannot read coverage from " << args[i] << "."
+           << std::endl;
+        continue;
+      }
+      n_new += merged.value();
+    }
+    os << std::dec << n_new << " new edge entries and blocks" << std::endl;
+  } else {
+    show_command_help("coverage", os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_phases(std::vector<std::string> args,
+                             sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  if (!libvio::phase_profile_enabled) {
+    os << "Phase profiling is not compiled in, rebuild with "
+          "`-Dphase_profile=true`"
+       << std::endl;
+  } else if (args.empty()) {
+    libvio::write_phase_profile(os, sdb_inst->instructions -
+                                        sdb_inst->phase_instructions);
+  } else if (args[0] == "reset" && args.size() == 1) {
+    libvio::reset_phase_profile();
+    sdb_inst->phase_instructions = sdb_inst->instructions;
+    os << "Phase profile cleared" << std::endl;
+  } else {
+    show_command_help("phases", os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_dataflow(std::vector<std::string> args,
+                               sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto &dataflow = sdb_inst->dataflow;
+  if (!args.empty() && args[0] == "start" && args.size() <= 2) {
+    const auto *buffer = sdb_inst->cpu->event_buffer;
+    if (buffer == nullptr) {
+      os << "libsdb: Event tracing is off." << std::endl;
+      return;
+    }
+    if (sdb_inst->source_gprs == nullptr) {
+      os << "libsdb: No decoder of source registers, set `source_gprs`."
+         << std::endl;
+      return;
+    }
+    size_t window = 256;
+    if (args.size() == 2) {
+      auto val = evaluate_expression(args[1], sdb_inst->cpu);
+      if (!val.has_value() || val.value() == 0) {
+        os << "libsdb: Invalid expression in arguments." << std::endl;
+        return;
+      }
+      window = val.value();
+    }
+    dataflow = std::make_unique<libcpu::dataflow_analyzer<WORD_T>>(
+        window, sdb_inst->source_gprs);
+    sdb_inst->dataflow_index = buffer->lastindex();
+    os << "Dataflow analysis started" << std::endl;
+  } else if (!args.empty() && args[0] == "stop" && args.size() == 1) {
+    dataflow.reset();
+    os << "Dataflow analysis stopped" << std::endl;
+  } else if (!args.empty()) {
+    show_command_help("dataflow", os);
+  } else if (dataflow == nullptr) {
+    os << "Not analyzing, use `dataflow start` first" << std::endl;
+  } else {
+    dataflow->write_report(os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_cache(std::vector<std::string> args,
+                            sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto &cache = sdb_inst->cache;
+  if (!args.empty() && args[0] == "start" && args.size() <= 4) {
+    const auto *buffer = sdb_inst->cpu->event_buffer;
+    if (buffer == nullptr) {
+      os << "libsdb: Event tracing is off." << std::endl;
+      return;
+    }
+    libcpu::cache_config_t l1i;
+    libcpu::cache_config_t l1d;
+    std::optional<libcpu::cache_config_t> l2 = libcpu::cache_config_t{};
+    l2->size = 512 * 1024;
+    l2->ways = 16;
+    for (size_t i = 1; i < args.size(); ++i) {
+      size_t eq = args[i].find('=');
+      std::string name = args[i].substr(0, eq);
+      std::string spec = eq == std::string::npos ? "" : args[i].substr(eq + 1);
+      auto config = libcpu::cache_config_t::parse(spec);
+      if (name == "l2" && spec == "none") {
+        l2.reset();
+      } else if (!config.has_value()) {
+        os << "libsdb: Invalid cache configuration `" << args[i] << "`."
+           << std::endl;
+        return;
+      } else if (name == "l1i") {
+        l1i = config.value();
+      } else if (name == "l1d") {
+        l1d = config.value();
+      } else if (name == "l2") {
+        l2 = config;
+      } else {
+        os << "libsdb: Unknown cache `" << name << "`." << std::endl;
+        return;
+      }
+    }
+    cache = std::make_unique<libcpu::cache_hierarchy>(l1i, l1d, l2);
+    sdb_inst->cache_index = buffer->lastindex();
+    os << "Cache simulation started" << std::endl;
+  } else if (!args.empty() && args[0] == "stop" && args.size() == 1) {
+    cache.reset();
+    os << "Cache simulation stopped" << std::endl;
+  } else if (!args.empty()) {
+    show_command_help("cache", os);
+  } else if (cache == nullptr) {
+    os << "Not simulating, use `cache start` first" << std::endl;
+  } else {
+    cache->write_report(os);
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_symbols(std::vector<std::string> args,
+                              sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  if (args.size() > 1) {
+    show_command_help("symbols", os);
+    return;
+  }
+  if (args.size() == 1) {
+    size_t n = sdb_inst->symbols.load_elf_from_file(args[0].c_str());
+    if (n == 0) {
+      os << "libsdb: No symbols loaded from " << args[0] << "." << std::endl;
+      return;
+    }
+  }
+  os << std::dec << sdb_inst->symbols.size() << " symbols" << std::endl;
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_reverse_step(std::vector<std::string> args,
+                                   sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  auto rec = sdb_inst->get_recording(os);
+  if (rec == nullptr) {
+    return;
+  }
+  size_t n = 1;
+  if (!args.empty()) {
+    std::string expr_str;
+    for (const auto &arg : args) {
+      expr_str += arg + " ";
+    }
+    auto n_opt = evaluate_expression(expr_str, sdb_inst->cpu);
+    if (!n_opt.has_value()) {
+      os << "libsdb: Invalid expression in arguments." << std::endl;
+      return;
+    }
+    n = n_opt.value();
+  }
+  size_t available = rec->position() - rec->first();
+  rec->seek(rec->position() - std::min(n, available));
+  sdb_inst->refresh_watchpoints();
+  if (n > available) {
+    os << "Reached the start of the recording" << std::endl;
+  }
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_reverse_continue(std::vector<std::string> args,
+                                       sdb<WORD_T> *sdb_inst,
+                                       std::ostream &os) {
+  if (!args.empty()) {
+    show_command_help("reverse-continue", os);
+    return;
+  }
+  if (sdb_inst->get_recording(os) == nullptr) {
+    return;
+  }
+  auto data = sdb_inst->data_watchpoints.empty() ? nullptr
+                                                 : &sdb_inst->data_watchpoints;
+  if (sdb_inst->reverse_search(true, data)) {
+    bool data_hit = sdb_inst->check_data_watchpoints(os);
+    if (!data_hit) {
+      sdb_inst->check_breakpoints(os);
+    }
+  } else {
+    os << "Reached the start of the recording" << std::endl;
+  }
+  sdb_inst->refresh_watchpoints();
+}
+
+template <typename WORD_T>
+void sdb<WORD_T>::cmd_reverse_watch(std::vector<std::string> args,
+                                    sdb<WORD_T> *sdb_inst, std::ostream &os) {
+  if (args.size() > 2) {
+    show_command_help("reverse-watch", os);
+    return;
+  }
+  if (sdb_inst->get_recording(os) == nullptr) {
+    return;
+  }
+  if (args.empty()) {
+    if (sdb_inst->data_watchpoints.empty()) {
+      os << "No data watchpoints set" << std::endl;
+      return;
+    }
+    if (sdb_inst->reverse_search(false, &sdb_inst->data_watchpoints)) {
+      sdb_inst->check_data_watchpoints(os);
+    } else {
+      os << "Reached the start of the recording" << std::endl;
+    }
+    sdb_inst->refresh_watchpoints();
+    return;
+  }
+
+  // a temporary data watchpoint on stores to the range
+  auto addr = evaluate_expression(args[0], sdb_inst->cpu);
+  std::optional<WORD_T> len = sizeof(WORD_T);
+  if (args.size() == 2) {
+    len = evaluate_expression(args[1], sdb_inst->cpu);
+  }
+  if (!addr.has_value() || !len.has_value() || len.value() == 0) {
+    os << "libsdb: Invalid expression in arguments." << std::endl;
+    return;
+  }
+  libcpu::watchpoint_set<WORD_T> range;
+  range.insert(addr.value(), len.value(), libcpu::watch_access_t::write);
+  if (sdb_inst->reverse_search(false, &range)) {
+    auto hit = range.hit.value();
+    os << "Last store to 0x" << std::hex << addr.value() << ": "
+       << static_cast<unsigned>(hit.width) << " bytes at 0x" << hit.addr
+       << " by instruction at 0x" << hit.pc;
+    auto val = sdb_inst->cpu->vmem_peek(hit.addr, hit.width);
+    if (val.has_value()) {
+      os << ", value = 0x" << val.value();
+    }
+    os << std::endl;
+  } else {
+    os << "No store found, reached the start of the recording" << std::endl;
+  }
+  sdb_inst->refresh_watchpoints();
+}
+
+template <typename WORD_T>
+recorder<WORD_T> *sdb<WORD_T>::get_recording(std::ostream &os) {
+  if (recording == nullptr) {
+    os << "Not recording, see `help record`" << std::endl;
+    return nullptr;
+  }
+  if (recording->get_cpu() != cpu) {
+    os << "The recording is of another CPU" << std::endl;
+    return nullptr;
+  }
+  return recording.get();
+}
+
+template <typename WORD_T>
+bool sdb<WORD_T>::reverse_search(bool use_breakpoints,
+                                 libcpu::watchpoint_set<WORD_T> *data) {
+  // stops are detected quietly while scanning
+  std::ostream quiet{nullptr};
+  const libcpu::breakpoint_set<WORD_T> *bps =
+      use_breakpoints ? &breakpoints : nullptr;
+  // look for the last stop in (checkpoint, end], from the latest interval
+  if (recording->position() == recording->first()) {
+    return false;
+  }
+  size_t end = recording->position() - 1;
+  while (end > recording->first()) {
+    size_t begin = recording->restore(end - 1);
+    size_t last_stop = SIZE_MAX;
+    cpu->watchpoints = data;
+    while (recording->position() < end && !cpu->stopped()) {
+      size_t chunk = std::min(end - recording->position(),
+                              recording->until_checkpoint());
+      recording->advance(cpu->run(chunk, bps));
+      bool hit = data != nullptr && data->hit.has_value();
+      if (data != nullptr) {
+        data->hit.reset();
+      }
+      if (hit || (use_breakpoints && check_breakpoints(quiet))) {
+        last_stop = recording->position();
+      }
+    }
+    cpu->watchpoints = nullptr;
+    if (last_stop != SIZE_MAX) {
+      // execute the instruction causing the stop again, with the checks
+      recording->seek(last_stop - 1);
+      cpu->watchpoints = data;
+      recording->advance(cpu->run(1, nullptr));
+      cpu->watchpoints = nullptr;
+      return true;
+    }
+    end = begin;
+  }
+  // only a breakpoint can stop at the start of the history
+  recording->restore(recording->first());
+  return use_breakpoints && check_breakpoints(quiet);
+}
+
+template <typename WORD_T> void sdb<WORD_T>::refresh_watchpoints(void) {
+  for (auto &wp : watchpoints) {
+    auto val = wp.expr.evaluate(cpu);
+    if (val.has_value()) {
+      wp.old_value = val.value();
+    }
+  }
 }
 
 template <typename WORD_T> const char *sdb<WORD_T>::get_prompt(void) const {
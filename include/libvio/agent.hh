@@ -2,16 +2,156 @@
 #define LIBVIO_AGENT_HH
 
 #include <optional>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <functional>
 #include <libvio/width.hh>
+#include <vector>
 
 namespace libvio {
 
+/**
+ * @brief A range of device memory a CPU can access directly like RAM
+ *
+ * Made from a `host_bank_t` of a device by `io_agent::host_ranges()`.
+ */
+struct host_range_t {
+    uint64_t addr_begin; ///< Starting address in bus address space
+    uint64_t addr_end;   ///< Address past the end of the range
+    uint8_t *host_ptr;   ///< Host memory at `addr_begin`
+    uint64_t *dirty_map = nullptr; ///< Bitmap of written blocks, may be nullptr
+    unsigned dirty_shift = 0; ///< Log2 of the block size tracked by each bit
+
+    /**
+    * @brief Check whether an access falls entirely in the range
+    * @param addr Address of the access
+    * @param len Length of the access in bytes
+    * @return true if the access is in the range
+    */
+    bool contains(uint64_t addr, uint64_t len) const {
+        return addr >= addr_begin && addr < addr_end &&
+               len <= addr_end - addr;
+    }
+
+    /**
+    * @brief Load a little-endian value from the range
+    * @param addr Address of the access, must be in the range
+    * @param width Width of the access
+    * @return uint64_t The zero extended value
+    */
+    uint64_t load(uint64_t addr, width_t width) const {
+        const uint8_t *ptr = host_ptr + (addr - addr_begin);
+        uint64_t value = 0;
+        if constexpr (std::endian::native == std::endian::little) {
+            std::memcpy(&value, ptr, static_cast<size_t>(width));
+        } else {
+            for (size_t i = 0; i < static_cast<size_t>(width); ++i) {
+                value |= uint64_t(ptr[i]) << (i * 8);
+            }
+        }
+        return value;
+    }
+
+    /**
+    * @brief Store a little-endian value to the range, marking it dirty
+    * @param addr Address of the access, must be in the range
+    * @param width Width of the access
+    * @param value The value, truncated to `width`
+    */
+    void store(uint64_t addr, width_t width, uint64_t value) {
+        uint8_t *ptr = host_ptr + (addr - addr_begin);
+        if constexpr (std::endian::native == std::endian::little) {
+            std::memcpy(ptr, &value, static_cast<size_t>(width));
+        } else {
+            for (size_t i = 0; i < static_cast<size_t>(width); ++i) {
+                ptr[i] = value >> (i * 8);
+            }
+        }
+        mark_dirty(addr, static_cast<uint64_t>(width));
+    }
+
+    /**
+    * @brief Mark the blocks touched by a write in the dirty bitmap
+    * @param addr Address of the write, must be in the range
+    * @param len Length of the write in bytes
+    */
+    void mark_dirty(uint64_t addr, uint64_t len) {
+        if (dirty_map == nullptr || len == 0) {
+            return;
+        }
+        uint64_t first = (addr - addr_begin) >> dirty_shift;
+        uint64_t last = (addr - addr_begin + len - 1) >> dirty_shift;
+        for (uint64_t block = first; block <= last; ++block) {
+            dirty_map[block / 64] |= uint64_t(1) << (block % 64);
+        }
+    }
+};
+
 /**
  * @brief Provides am MMIO interface for simulated processors.
  */
 class io_agent{
     public:
+        /**
+        * @brief Called with the new levels when the interrupt lines seen by
+        * this agent change
+        *
+        * Bit `i` of the argument is the level of interrupt line `i`. The
+        * handler is called on the simulation thread right after a request,
+        * so the CPU sees interrupts at the same point of its request stream
+        * regardless of the host timing.
+        */
+        std::function<void(uint64_t)> irq_handler;
+
+        /**
+        * @brief Called to write the memory of the CPU behind this agent by
+        * DMA
+        *
+        * The arguments are the address, the data and its length. The handler
+        * returns whether the whole range is written. The handler is called on
+        * the simulation thread right before a request, at the same point of
+        * the request stream for every agent of a dispatcher. It should write
+        * through `libcpu::memory_view::write_burst()`, so that the write is
+        * journaled like a store of the CPU.
+        */
+        std::function<bool(uint64_t, const uint8_t *, size_t)>
+            dma_write_handler;
+
+        /**
+        * @brief Called to read the memory of the CPU behind this agent by DMA
+        *
+        * The arguments are the address, the destination buffer and its
+        * length. The handler returns whether the whole range is read. Only
+        * the leading agent of a dispatcher is asked.
+        */
+        std::function<bool(uint64_t, uint8_t *, size_t)> dma_read_handler;
+
+        /**
+        * @brief Let pending interrupt line changes reach this agent without
+        * an MMIO access
+        *
+        * A CPU waiting for interrupts without accessing MMIO must call this
+        * periodically, e.g. `libcpu::riscv_cpu_system` calls it every
+        * `irq_poll_interval` instructions. Agents in a differential test must
+        * call it at the same points.
+        */
+        virtual void poll_irq(void) {}
+
+        /**
+        * @brief Get the device memory the CPU may access directly
+        *
+        * Loads and stores of the CPU inside these ranges should use the
+        * ranges instead of `read()` and `write()`, like RAM. The ranges are
+        * private to this agent, so each CPU of a differential test stores to
+        * its own copy of the device memory. Agents that must see every access,
+        * e.g. to record it, return no ranges, which is the default.
+        *
+        * @return The ranges, valid during the lifetime of the agent
+        */
+        virtual std::vector<host_range_t> host_ranges(void) { return {}; }
+
         /**
         * @brief Perform a read operation on the bus
         * @param addr Target address in bus address space
@@ -28,6 +168,51 @@ class io_agent{
         * @return `true` if write succeeded, `false` otherwise
         */
         virtual bool write(uint64_t addr, width_t width, uint64_t data) = 0;
+
+        /**
+        * @brief Read a contiguous span from the bus in one transaction
+        *
+        * The default implementation issues a byte read for each byte in the
+        * span. Agents that can log the whole span as one request should
+        * override it.
+        *
+        * @param addr Starting address in bus address space
+        * @param data Destination buffer of at least `len` bytes, e.g. guest
+        * RAM obtained from `libcpu::memory_view::host_addr(addr, len)`
+        * @param len Number of bytes to transfer
+        * @return `true` if the whole span is read, `false` otherwise
+        */
+        virtual bool read_burst(uint64_t addr, uint8_t *data, size_t len) {
+            for (size_t i = 0; i < len; ++i) {
+                auto byte = read(addr + i, width_t::byte);
+                if (!byte.has_value()) {
+                    return false;
+                }
+                data[i] = byte.value();
+            }
+            return true;
+        }
+
+        /**
+        * @brief Write a contiguous span to the bus in one transaction
+        *
+        * The default implementation issues a byte write for each byte in the
+        * span. Agents that can log the whole span as one request should
+        * override it.
+        *
+        * @param addr Starting address in bus address space
+        * @param data Source buffer of at least `len` bytes
+        * @param len Number of bytes to transfer
+        * @return `true` if the whole span is written, `false` otherwise
+        */
+        virtual bool write_burst(uint64_t addr, const uint8_t *data, size_t len) {
+            for (size_t i = 0; i < len; ++i) {
+                if (!write(addr + i, width_t::byte, data[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
 };
 
 }
@@ -0,0 +1,111 @@
+/**
+ * @file async_backend.hh
+ * @brief Base class of backends executing requests on a worker thread
+ */
+#ifndef LIBVIO_ASYNC_BACKEND_HH
+#define LIBVIO_ASYNC_BACKEND_HH
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <libvio/backend.hh>
+#include <libvio/spsc_queue.hh>
+#include <thread>
+
+namespace libvio {
+
+/**
+ * @brief Base class of backends executing slow operations on a worker thread
+ *
+ * Subclasses call `submit()` from `put()` or `request()` to queue an operation
+ * instead of doing it on the simulation thread. The operation runs in
+ * `execute()` on a worker thread. Its completion is handed back to
+ * `complete()` on the simulation thread, when the dispatcher collects
+ * completions at the next request boundary. There, the subclass typically
+ * sets a status bit, so the frontend can report it or raise an interrupt via
+ * `io_frontend::irq_level()`.
+ *
+ * Because completions are only applied at request boundaries of the leading
+ * agent, and interrupt line changes and DMA writes through `io_backend::dma`
+ * are replayed at the same boundaries for the other agents, all CPUs in a
+ * differential test observe a completion at the same point.
+ *
+ * Synchronous backends do not need to change in any way.
+ *
+ * @note Subclasses must call `stop()` in their destructor, so that the worker
+ * does not call `execute()` on a destroyed object.
+ */
+class async_backend : public io_backend {
+public:
+  /**
+   * @struct job_t
+   * @brief An operation submitted to the worker
+   */
+  struct job_t {
+    uint64_t req;    ///< Request identifier
+    uint64_t data;   ///< Data of the request
+    uint64_t result; ///< Result returned by `execute()`
+  };
+
+  ~async_backend();
+
+  /**
+   * @brief Pass finished operations to `complete()`
+   */
+  void collect(void) override;
+
+protected:
+  /**
+   * @brief Queue an operation for the worker thread
+   *
+   * The worker is started on the first submission. If too many operations
+   * are in flight, this waits for some of them and collects them.
+   *
+   * @param req Request identifier
+   * @param data Data of the request
+   */
+  void submit(uint64_t req, uint64_t data);
+
+  /**
+   * @brief Get the number of operations submitted but not completed yet
+   * @return size_t Number of operations in flight
+   */
+  size_t in_flight(void) const;
+
+  /**
+   * @brief Wait for the operations in flight to finish and stop the worker
+   */
+  void stop(void);
+
+  /**
+   * @brief Execute an operation, called on the worker thread
+   * @param req Request identifier
+   * @param data Data of the request
+   * @return uint64_t Result of the operation
+   */
+  virtual uint64_t execute(uint64_t req, uint64_t data) = 0;
+
+  /**
+   * @brief Apply a finished operation, called on the simulation thread
+   * @param job The operation with its result
+   */
+  virtual void complete(const job_t &job) = 0;
+
+private:
+  static constexpr size_t queue_size = 256;
+  spsc_queue<job_t, queue_size> jobs;        ///< Operations to execute
+  spsc_queue<job_t, queue_size> completions; ///< Operations executed
+  std::atomic<bool> stopping = false; ///< Whether the worker should exit
+  size_t submitted = 0;               ///< Operations submitted
+  size_t completed = 0;               ///< Operations completed
+  std::thread worker;                 ///< The worker thread
+
+  /**
+   * @brief Main loop of the worker thread
+   */
+  void worker_loop(void);
+};
+
+} // namespace libvio
+
+#endif
@@ -1,10 +1,44 @@
 #ifndef LIBVIO_BACKEND_HH
 #define LIBVIO_BACKEND_HH
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 
 namespace libvio {
 
+/**
+ * @brief Access to the simulated memory for devices doing DMA
+ *
+ * Implemented by `io_dispatcher`, which passes the accesses to the memory of
+ * the CPUs through `io_agent::dma_read_handler` and
+ * `io_agent::dma_write_handler`. It must only be used on the simulation
+ * thread while serving a request, e.g. from `io_backend::put()` or
+ * `io_backend::collect()`.
+ */
+class dma_port {
+public:
+  /**
+   * @brief Read a range of the simulated memory
+   * @param addr Starting address of the range
+   * @param data Destination buffer of at least `len` bytes
+   * @param len Number of bytes to read
+   * @return `true` if the whole range is read, `false` otherwise
+   */
+  virtual bool dma_read(uint64_t addr, uint8_t *data, size_t len) = 0;
+
+  /**
+   * @brief Write a range of the simulated memory
+   * @param addr Starting address of the range
+   * @param data Source buffer of at least `len` bytes
+   * @param len Number of bytes to write
+   * @return `true` if the whole range is written, `false` otherwise
+   */
+  virtual bool dma_write(uint64_t addr, const uint8_t *data, size_t len) = 0;
+
+  virtual ~dma_port() = default;
+};
+
 /**
  * @brief Abstract base class for I/O backends
  *
@@ -65,6 +99,30 @@ public:
    */
   virtual void put(uint64_t req, uint64_t data) = 0;
 
+  /**
+   * @brief Apply the results of finished asynchronous work
+   *
+   * Called by the dispatcher on the simulation thread at a request boundary,
+   * after `completion_signal` has changed. Synchronous backends have nothing
+   * to collect.
+   * @see libvio::async_backend
+   */
+  virtual void collect(void) {}
+
+  /**
+   * @brief Counter incremented by the backend when there is work to collect
+   *
+   * Set by the dispatcher when the device is attached, nullptr otherwise.
+   */
+  std::atomic<uint32_t> *completion_signal = nullptr;
+
+  /**
+   * @brief Memory access for DMA
+   *
+   * Set by the dispatcher when the device is attached, nullptr otherwise.
+   */
+  dma_port *dma = nullptr;
+
   virtual ~io_backend() = default;
 };
 
@@ -0,0 +1,171 @@
+/**
+ * @file block.hh
+ * @brief Block device frontend and disk image backend
+ */
+#ifndef LIBVIO_BLOCK_HH
+#define LIBVIO_BLOCK_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <libvio/async_backend.hh>
+#include <libvio/frontend.hh>
+#include <memory>
+#include <vector>
+
+namespace libvio {
+
+namespace reqval {
+inline static constexpr uint64_t block_sector_l =
+    1 << 0; ///< Reading/writing lower part of the sector number
+inline static constexpr uint64_t block_sector_h =
+    1 << 1; ///< Reading/writing higher part of the sector number
+inline static constexpr uint64_t block_dma_l =
+    1 << 2; ///< Reading/writing lower part of the DMA address
+inline static constexpr uint64_t block_dma_h =
+    1 << 3; ///< Reading/writing higher part of the DMA address
+inline static constexpr uint64_t block_count =
+    1 << 4; ///< Reading/writing number of sectors to transfer
+inline static constexpr uint64_t block_command = 1 << 5; ///< Issuing a command
+inline static constexpr uint64_t block_status = 1 << 6; ///< Reading status
+inline static constexpr uint64_t block_irq_ack =
+    1 << 7; ///< Acknowledging the completion interrupt
+inline static constexpr uint64_t block_capacity_l =
+    1 << 8; ///< Reading lower part of the capacity in sectors
+inline static constexpr uint64_t block_capacity_h =
+    1 << 9; ///< Reading higher part of the capacity in sectors
+} // namespace reqval
+
+inline static constexpr uint64_t block_sector_size = 512; ///< Bytes per sector
+
+inline static constexpr uint64_t block_cmd_read =
+    1; ///< Copy sectors from the disk to memory
+inline static constexpr uint64_t block_cmd_write =
+    2; ///< Copy sectors from memory to the disk
+inline static constexpr uint64_t block_cmd_flush =
+    3; ///< Flush written sectors to the disk image
+
+inline static constexpr uint64_t block_status_done =
+    1 << 0; ///< Every command issued has completed
+inline static constexpr uint64_t block_status_error =
+    1 << 1; ///< A command has failed since the last command was issued
+inline static constexpr uint64_t block_status_irq =
+    1 << 2; ///< A completion interrupt is pending
+
+/**
+ * @brief `io_frontend` implementation for a simple DMA block device
+ *
+ * Register layout, 64-bit registers can also be accessed as 32-bit halves:
+ *
+ * | Offset | Width | Access | Register                                  |
+ * | ------ | ----- | ------ | ----------------------------------------- |
+ * | 0x00   | 64    | RW     | First sector of the transfer              |
+ * | 0x08   | 64    | RW     | Memory address of the transfer            |
+ * | 0x10   | 32    | RW     | Number of sectors to transfer             |
+ * | 0x14   | 32    | WO     | Command, see `block_cmd_*`                |
+ * | 0x18   | 32    | RO     | Status, see `block_status_*`              |
+ * | 0x1c   | 32    | WO     | Write anything to acknowledge interrupt   |
+ * | 0x20   | 64    | RO     | Capacity in sectors                       |
+ *
+ * Writing the command register starts a transfer of multiple sectors between
+ * the disk and the memory by DMA. The transfer completes asynchronously. The
+ * status register reports completion once every command issued has
+ * completed, and an interrupt stays pending until it is acknowledged. A
+ * pending interrupt drives the interrupt line of the device.
+ */
+class block_frontend : public io_frontend {
+public:
+  ioreq_t resolve_read(uint64_t offset, width_t width) const override;
+  ioreq_t resolve_write(uint64_t offset, width_t width,
+                        uint64_t data) const override;
+  bool irq_level(void) const override;
+  uint64_t ioctl_get(uint64_t req) override;
+  void ioctl_set(uint64_t req, uint64_t value) override;
+};
+
+/**
+ * @brief Block device backend using a memory-mapped disk image
+ *
+ * Transfers run on the worker thread of `async_backend`, so a slow disk image
+ * does not stall the simulation. Sectors written to the disk are read from
+ * the memory when the command is issued. Sectors read from the disk are
+ * written to the memory when the transfer is collected, through the
+ * `dma_port` of the dispatcher, so every CPU in a differential test sees the
+ * data at the same point of its request stream. The completion interrupt is
+ * raised at the same point.
+ *
+ * In copy-on-write mode the image is mapped privately. Written sectors only
+ * live in the memory of this process, so any number of simulations can share
+ * one read-only base image. Otherwise writes go back to the image file.
+ */
+class block_backend_mmap : public async_backend {
+public:
+  /**
+   * @brief Map a disk image
+   * @param filename Path to the disk image
+   * @param copy_on_write Whether to keep written sectors private to this
+   * process instead of writing them back to the image
+   */
+  block_backend_mmap(const char *filename, bool copy_on_write = true);
+  ~block_backend_mmap();
+  block_backend_mmap(const block_backend_mmap &) = delete;
+  block_backend_mmap &operator=(const block_backend_mmap &) = delete;
+
+  /**
+   * @brief Check whether a completion interrupt is pending
+   * @return bool True if an interrupt is pending
+   */
+  bool irq_pending(void) const;
+
+  uint64_t request(uint64_t req) override;
+  bool poll(uint64_t req) override;
+
+  /**
+   * @brief Check whether a completion interrupt is pending
+   * @param req `reqval::block_status`, other requests always return true
+   */
+  bool check(uint64_t req) override;
+  void put(uint64_t req, uint64_t data) override;
+
+protected:
+  /**
+   * @struct transfer_t
+   * @brief A command passed to the worker thread
+   */
+  struct transfer_t {
+    uint64_t sector;             ///< First sector of the transfer
+    uint64_t dma_addr;           ///< Memory address of the transfer
+    std::vector<uint8_t> buffer; ///< Sectors between the disk and the memory
+    bool ok;                     ///< Whether the command has not failed yet
+  };
+
+  uint8_t *image = nullptr; ///< Mapped disk image
+  size_t image_size = 0;    ///< Size of the mapped image in bytes
+  bool copy_on_write;       ///< Whether the image is mapped privately
+
+  uint64_t sector = 0;   ///< First sector of the transfer
+  uint64_t dma_addr = 0; ///< Memory address of the transfer
+  uint64_t count = 0;    ///< Number of sectors to transfer
+  uint64_t status = 0;   ///< Status register
+  /// Commands in flight, in the order they complete
+  std::deque<std::unique_ptr<transfer_t>> transfers;
+
+  /**
+   * @brief Copy sectors between the disk and a transfer buffer, or flush the
+   * disk, called on the worker thread
+   * @param req Command issued, see `block_cmd_*`
+   * @param data Address of the `transfer_t`
+   * @return uint64_t 1 if the command succeeded, 0 otherwise
+   */
+  uint64_t execute(uint64_t req, uint64_t data) override;
+
+  /**
+   * @brief Write the sectors read to the memory and report the completion
+   * @param job The finished command
+   */
+  void complete(const job_t &job) override;
+};
+
+} // namespace libvio
+
+#endif
@@ -6,17 +6,20 @@
 #ifndef LIBVIO_BUS_HH
 #define LIBVIO_BUS_HH
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <initializer_list>
 #include <libvio/agent.hh>
 #include <libvio/backend.hh>
 #include <libvio/frontend.hh>
+#include <libvio/irq_controller.hh>
 #include <libvio/ringbuffer.hh>
 #include <libvio/width.hh>
 #include <memory>
 #include <optional>
 #include <tuple>
+#include <unordered_map>
 #include <vector>
 
 namespace libvio {
@@ -27,12 +30,51 @@ class mmio_agent : public io_agent {
 public:
   std::optional<uint64_t> read(uint64_t addr, width_t width) override;
   bool write(uint64_t addr, width_t width, uint64_t data) override;
+  bool read_burst(uint64_t addr, uint8_t *data, size_t len) override;
+  bool write_burst(uint64_t addr, const uint8_t *data, size_t len) override;
+  void poll_irq(void) override;
+
+  /**
+   * @brief Map the host banks of the devices for direct access
+   *
+   * The first agent mapping a bank gets the bank itself, so the device sees
+   * the stores of its CPU and the dirty bitmap of the bank is kept. Agents
+   * mapping it later get private copies, initialized with the content of the
+   * bank. Requests of agents not mapping it are served from another copy.
+   * Each CPU of a differential test therefore has its own bank, and as the
+   * banks have no side effects, they hold the same values when the CPUs
+   * execute the same stores. The banks are mapped on the first call, devices
+   * attached later are not mapped.
+   *
+   * Requests of this agent to the mapped banks, e.g. through a
+   * `replay_agent`, are served from the mapped banks too.
+   *
+   * @return The mapped banks
+   */
+  std::vector<host_range_t> host_ranges(void) override;
   friend class io_dispatcher;
 
 private:
   io_dispatcher *dispatcher = nullptr; ///< Associated dispatcher instance
   size_t read_count = 0;               ///< Count of total read requests
   size_t write_count = 0;              ///< Count of total write requests
+  size_t read_burst_count = 0;  ///< Count of total burst read requests
+  size_t write_burst_count = 0; ///< Count of total burst write requests
+  size_t sequence = 0;  ///< Count of total requests and interrupt polls
+  size_t irq_index = 0; ///< Next interrupt history entry to deliver
+  size_t dma_index = 0; ///< Next DMA history entry to deliver
+  bool mapped = false;  ///< Whether `host_ranges()` has mapped the banks
+  std::vector<host_range_t> views; ///< Host banks mapped for direct access
+  /// Private copies of the banks mapped by another agent first
+  std::vector<std::unique_ptr<uint8_t[]>> copies;
+
+  /**
+   * @brief Find the mapped bank containing an access
+   * @param addr Address of the access
+   * @param len Length of the access in bytes
+   * @return host_range_t* The bank, nullptr if the access is not in one
+   */
+  host_range_t *find_view(uint64_t addr, uint64_t len);
 };
 
 /**
@@ -47,6 +89,8 @@ protected:
   std::unique_ptr<io_backend> backend;   ///< IO backend
   uint64_t addr_begin; ///< Starting address in bus address space
   uint64_t byte_span;  ///< Address range size in bytes
+  int irq_line = -1;   ///< Interrupt line driven by the device, -1 if none
+  bool irq_asserted = false; ///< Last sampled interrupt level
 
 public:
   /**
@@ -72,8 +116,13 @@ public:
  * the cached data is returned, and the attached frontends are not invoked.
  * This is useful when more than one device under a differential test share the
  * same virtual devices.
+ *
+ * The dispatcher is also the `dma_port` of the backends. DMA writes reach the
+ * memory of the leading agent at once and are recorded, the other agents get
+ * them right before the request with the same sequence number, as they do
+ * with interrupt line changes.
  */
-class io_dispatcher {
+class io_dispatcher : public dma_port {
 
 public:
   /**
@@ -84,15 +133,48 @@ public:
    */
   io_dispatcher(std::initializer_list<
                     std::tuple<io_frontend *, io_backend *, uint64_t, uint64_t>>
-                    device_list,
+                    device_list = {},
                 size_t buffer_size = 32);
 
+  /**
+   * @brief Attach a new device to the bus
+   *
+   * The address decoding table is rebuilt after the device is added. Devices
+   * must be attached with this function rather than by modifying `devices`
+   * directly, otherwise they will not be visible to address decoding.
+   *
+   * @param frontend Frontend interface instance (ownership transferred)
+   * @param backend Backend interface instance (ownership transferred), may be
+   * nullptr if the frontend resolves all requests to `ioctl_get`/`ioctl_set`
+   * @param addr_begin Starting address of device's memory map
+   * @param byte_span Size of address range occupied by device
+   * @param irq_line Interrupt line driven by `io_frontend::irq_level()` of
+   * the device, -1 if the device does not raise interrupts
+   */
+  void add_device(io_frontend *frontend, io_backend *backend,
+                  uint64_t addr_begin, uint64_t byte_span, int irq_line = -1);
+
+  /**
+   * @brief Find the device owning an address
+   *
+   * The lookup goes through a page-granular table covering the address
+   * window of all devices, so it takes constant time regardless of the number
+   * of devices. If the devices are spread too sparsely for such a table, it
+   * falls back to a binary search over the sorted address ranges.
+   *
+   * @param addr Address in bus address space
+   * @return mmio_device_def* The device owning `addr`, nullptr if unmapped
+   */
+  mmio_device_def *find_device(uint64_t addr);
+
   /**
    * @brief Issue a read request to the I/O bus
    *
    * The request will be routed to the device owning the specified address
    * range. If a request with the same or smaller `req_no` has been made before,
-   * data cached from the ring-buffer will be returned.
+   * data cached from the ring-buffer will be returned. A new read inside a
+   * host bank is loaded from host memory instead of the frontend, for the
+   * agents not mapping the banks directly.
    *
    * @param addr Memory address to read from
    * @param width Width of the read operation
@@ -109,7 +191,8 @@ public:
    *
    * The request will be routed to the device owning the specified address
    * range. If a request with the same or smaller `req_no` has been made before,
-   * it will not be passed to the frontend again.
+   * it will not be passed to the frontend again. A new write inside a host
+   * bank is stored to host memory instead of the frontend.
    *
    * @param addr Memory address to write to
    * @param width Width of the write operation
@@ -120,6 +203,88 @@ public:
   bool request_write(uint64_t addr, width_t width, size_t req_no,
                      uint64_t data);
 
+  /**
+   * @brief Issue a burst read request to the I/O bus
+   *
+   * The whole span is transferred and recorded as a single request. The span
+   * must lie within one device. Spans inside a host bank are copied directly,
+   * others are passed to `io_frontend::read_burst()`. Burst requests are
+   * numbered separately from single reads.
+   *
+   * @param addr Starting address of the span
+   * @param data Destination buffer of at least `len` bytes
+   * @param len Number of bytes to read
+   * @param req_no Burst read request number
+   * @return bool True if the whole span is read, false otherwise
+   */
+  bool request_read_burst(uint64_t addr, uint8_t *data, size_t len,
+                          size_t req_no);
+
+  /**
+   * @brief Issue a burst write request to the I/O bus
+   * @param addr Starting address of the span
+   * @param data Source buffer of at least `len` bytes
+   * @param len Number of bytes to write
+   * @param req_no Burst write request number
+   * @return bool True if the whole span is written, false otherwise
+   * @see request_read_burst()
+   */
+  bool request_write_burst(uint64_t addr, const uint8_t *data, size_t len,
+                           size_t req_no);
+
+  /**
+   * @brief Get the current levels of the interrupt lines
+   *
+   * A line is high if any device driving it requests an interrupt, or, with
+   * an interrupt controller, if the controller output is high. The levels are
+   * what the leading agent sees, lagging agents get the same changes through
+   * `io_agent::irq_handler` when they catch up.
+   *
+   * @return uint64_t Bit `i` is the level of line `i`
+   */
+  uint64_t get_irq_lines(void) const;
+
+  /**
+   * @brief Read the memory of the leading agent by DMA
+   *
+   * Other agents are not asked, their memory holds the same data once they
+   * have caught up.
+   *
+   * @param addr Starting address of the range
+   * @param data Destination buffer of at least `len` bytes
+   * @param len Number of bytes to read
+   * @return `true` if the whole range is read, `false` otherwise
+   */
+  bool dma_read(uint64_t addr, uint8_t *data, size_t len) override;
+
+  /**
+   * @brief Write the memory of every agent by DMA
+   *
+   * The memory of the leading agent is written at once. The write is
+   * recorded, and each other agent gets it through
+   * `io_agent::dma_write_handler` right before its request with the same
+   * sequence number, so a lagging CPU does not see the data early.
+   *
+   * @param addr Starting address of the range
+   * @param data Source buffer of at least `len` bytes
+   * @param len Number of bytes to write
+   * @return `true` if the whole range is written to the memory of the leading
+   * agent, `false` otherwise
+   */
+  bool dma_write(uint64_t addr, const uint8_t *data, size_t len) override;
+
+  /**
+   * @brief Route the device interrupt lines through an interrupt controller
+   *
+   * The lines driven by devices become the sources of the controller, and the
+   * outputs of the controller become the lines seen by the agents. The
+   * controller is usually also a device on this bus, e.g. a `plic_frontend`,
+   * and is not owned by the dispatcher.
+   *
+   * @param controller The controller, nullptr to connect the lines directly
+   */
+  void set_irq_controller(irq_controller *controller);
+
   /**
    * @brief Create a new agent attached to this dispatcher
    * @return mmio_agent* Pointer to the new agent instance
@@ -141,6 +306,104 @@ protected:
       read_request_buffer; ///< Read request history buffer
   ringbuffer<std::tuple<uint64_t, width_t, uint64_t, bool>>
       write_request_buffer; ///< Write request history buffer
+  ringbuffer<std::tuple<uint64_t, std::vector<uint8_t>, bool>>
+      read_burst_buffer; ///< Burst read request history buffer
+  ringbuffer<std::tuple<uint64_t, std::vector<uint8_t>, bool>>
+      write_burst_buffer; ///< Burst write request history buffer
+
+  /**
+   * @brief An entry of the address decoding table
+   */
+  struct decode_entry_t {
+    uint64_t addr_begin;     ///< Starting address of the range
+    uint64_t addr_end;       ///< Address past the end of the range
+    mmio_device_def *device; ///< The device owning this range
+    uint8_t *host_ptr; ///< Host memory of a host bank, nullptr if not a bank
+    uint8_t *bank_ptr; ///< The bank itself, `host_ptr` may be a copy of it
+    uint64_t *dirty_map;  ///< Dirty bitmap of a host bank, may be nullptr
+    unsigned dirty_shift; ///< Block size of the dirty bitmap
+  };
+
+  static constexpr unsigned decode_page_shift = 12; ///< 4 KiB decode pages
+  static constexpr size_t decode_max_pages = 1 << 16; ///< Page table limit
+  static constexpr uint32_t decode_no_entry = UINT32_MAX;
+
+  std::vector<decode_entry_t>
+      decode_table; ///< Device ranges sorted by starting address
+  std::vector<uint32_t>
+      decode_pages;          ///< Index of the first entry touching each page
+  uint64_t decode_page_base; ///< Page number of `decode_pages[0]`
+
+  /**
+   * @brief Rebuild `decode_table` from `devices`
+   *
+   * Host banks of a device get their own entries, splitting the range of the
+   * device around them.
+   */
+  void build_decode_table(void);
+
+  /**
+   * @brief Find the decoding table entry owning an address
+   * @param addr Address in bus address space
+   * @return const decode_entry_t* The entry owning `addr`, nullptr if unmapped
+   */
+  const decode_entry_t *find_entry(uint64_t addr);
+  /**
+   * @brief Start a request or an interrupt poll of an agent
+   *
+   * If the agent is the leading one, finished asynchronous work is collected
+   * before the request. Otherwise, DMA writes up to the request are delivered.
+   *
+   * @param agent The agent issuing the request
+   */
+  void begin_request(mmio_agent *agent);
+
+  /**
+   * @brief Finish a request, delivering interrupt line changes up to it
+   * @param agent The agent issuing the request
+   */
+  void end_request(mmio_agent *agent);
+
+  /**
+   * @brief Sample the interrupt level of a device and update its line
+   *
+   * If the device is the interrupt controller, its outputs are sampled too.
+   *
+   * @param dev The device to sample
+   */
+  void update_irq(mmio_device_def &dev);
+
+  /**
+   * @brief Change the lines seen by the agents, recording the change
+   * @param lines New levels of the lines
+   */
+  void set_irq_lines(uint64_t lines);
+
+  /**
+   * @brief Map the host banks for an agent
+   * @param agent The agent
+   * @return The mapped banks
+   * @see mmio_agent::host_ranges()
+   */
+  std::vector<host_range_t> map_host_banks(mmio_agent *agent);
+
+  std::atomic<uint32_t> completion_signal =
+      0;                       ///< Incremented by backends with work to collect
+  uint32_t collected_signal = 0; ///< `completion_signal` last collected
+  size_t sequence = 0;           ///< Sequence number of the leading agent
+  mmio_agent *leader = nullptr;  ///< Agent of the latest leading request
+  uint64_t irq_lines = 0;        ///< Current levels of the interrupt lines
+  uint64_t irq_sources = 0;      ///< Current levels of the device lines
+  irq_controller *controller = nullptr;     ///< Interrupt controller, if any
+  io_frontend *controller_frontend = nullptr; ///< The controller as a device
+  std::vector<uint32_t> irq_counts; ///< Devices asserting each line
+  ringbuffer<std::tuple<size_t, uint64_t>>
+      irq_history; ///< Line levels by the sequence number they changed at
+  ringbuffer<std::tuple<size_t, uint64_t, std::vector<uint8_t>>>
+      dma_history; ///< DMA writes by the sequence number they happened at
+  /// Copies of the banks mapped by an agent, serving the requests to them
+  std::unordered_map<const uint8_t *, std::unique_ptr<uint8_t[]>> shadows;
+
   std::vector<std::unique_ptr<mmio_agent>>
       agents; ///< Active agents attached to this dispatcher
 };
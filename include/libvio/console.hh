@@ -1,14 +1,18 @@
 #ifndef LIBVIO_CONSOLE_HH
 #define LIBVIO_CONSOLE_HH
 
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
 #include <istream>
 #include <libvio/backend.hh>
 #include <libvio/frontend.hh>
 #include <libvio/ringbuffer.hh>
+#include <libvio/spsc_queue.hh>
 #include <optional>
 #include <ostream>
+#include <string>
+#include <thread>
 
 namespace libvio {
 
@@ -46,12 +50,140 @@ public:
   bool check(uint64_t req) override;
   void put(uint64_t req, uint64_t data) override;
 
-private:
+protected:
   std::istream &istream;
   std::ostream &ostream;
   std::optional<uint64_t> input_data = {};
 };
 
+/**
+ * @brief Console I/O backend with buffered output
+ *
+ * Output is collected in a user-space buffer and written to the stream when a
+ * newline is written, the buffer reaches a threshold, input is requested, the
+ * backend is destroyed or `sync()` is called. This turns one stream operation
+ * per character into one per line.
+ */
+class console_backend_buffered : public console_backend_iostream {
+public:
+  /**
+   * @brief Construct a buffered console backend
+   * @param is Input stream
+   * @param os Output stream
+   * @param threshold Buffered bytes that trigger a flush
+   */
+  console_backend_buffered(std::istream &is, std::ostream &os,
+                           size_t threshold = 4096);
+  ~console_backend_buffered();
+  uint64_t request(uint64_t req) override;
+  bool poll(uint64_t req) override;
+  void put(uint64_t req, uint64_t data) override;
+
+  /**
+   * @brief Write all buffered output to the stream and flush it
+   */
+  void sync(void);
+
+protected:
+  std::string buffer; ///< Output not written yet
+  size_t threshold;   ///< Buffered bytes that trigger a flush
+};
+
+/**
+ * @brief Console I/O backend with output written by a separate thread
+ *
+ * `put()` only appends the character to a lock-free queue, a writer thread
+ * drains the queue into a buffer and writes it to the stream on newline,
+ * threshold, `sync()` or destruction. The simulation never waits for the
+ * output stream, unless the queue is full.
+ */
+class console_backend_async : public console_backend_iostream {
+public:
+  /**
+   * @brief Construct a console backend and start its writer thread
+   * @param is Input stream
+   * @param os Output stream, only accessed by the writer thread afterwards
+   * @param threshold Buffered bytes that trigger a write
+   */
+  console_backend_async(std::istream &is, std::ostream &os,
+                        size_t threshold = 4096);
+  ~console_backend_async();
+  uint64_t request(uint64_t req) override;
+  bool poll(uint64_t req) override;
+  void put(uint64_t req, uint64_t data) override;
+
+  /**
+   * @brief Wait until all output put so far is written and flushed
+   */
+  void sync(void);
+
+protected:
+  spsc_queue<char, 1 << 16> queue; ///< Output waiting for the writer
+  std::atomic<uint32_t> sync_requested = 0; ///< Number of `sync()` calls
+  std::atomic<uint32_t> sync_done = 0; ///< Number of syncs completed
+  std::atomic<bool> stopping = false;  ///< Whether the writer should exit
+  size_t threshold;                    ///< Buffered bytes that trigger a write
+  size_t unnotified = 0; ///< Characters put since the writer was notified
+  bool unsynced = false; ///< Whether anything is put since the last sync
+  std::thread writer;    ///< The writer thread
+
+  /**
+   * @brief Main loop of the writer thread
+   */
+  void writer_loop(void);
+};
+
+/**
+ * @brief Console I/O backend with input read by a background thread
+ *
+ * A reader thread reads the input into a lock-free queue, so `poll()` and
+ * `check()` are queue checks that never block the simulation. Only an
+ * explicit read of an empty receive register waits for input.
+ *
+ * Input can either come from a file descriptor, e.g. the standard input, or
+ * from a script file fed at a fixed rate for automated runs. The reader
+ * thread owns the file descriptor, so the standard input must not be read by
+ * others, e.g. an `sdb` prompt, while this backend is alive.
+ */
+class console_backend_nonblocking : public io_backend {
+public:
+  /**
+   * @brief Read input from a file descriptor
+   * @param os Output stream
+   * @param fd File descriptor of the input, not closed by the backend
+   */
+  console_backend_nonblocking(std::ostream &os, int fd = 0);
+
+  /**
+   * @brief Read input from a script file
+   * @param os Output stream
+   * @param script Path to the input script
+   * @param rate Characters fed per second, 0 to feed as fast as consumed
+   */
+  console_backend_nonblocking(std::ostream &os, const char *script,
+                              uint64_t rate = 0);
+  ~console_backend_nonblocking();
+  uint64_t request(uint64_t req) override;
+  bool poll(uint64_t req) override;
+  bool check(uint64_t req) override;
+  void put(uint64_t req, uint64_t data) override;
+
+protected:
+  std::ostream &ostream;
+  int fd;             ///< File descriptor of the input
+  bool own_fd;        ///< Whether `fd` is closed on destruction
+  uint64_t rate;      ///< Characters fed per second, 0 for unlimited
+  spsc_queue<char, 1 << 12> queue;  ///< Input read but not consumed yet
+  std::atomic<bool> eof = false;      ///< Whether the input has ended
+  std::atomic<bool> stopping = false; ///< Whether the reader should exit
+  std::thread reader;                 ///< The reader thread
+
+  /**
+   * @brief Main loop of the reader thread
+   */
+  void reader_loop(void);
+};
+
 } // namespace libvio
 
 #endif
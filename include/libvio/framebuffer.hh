@@ -0,0 +1,203 @@
+/**
+ * @file framebuffer.hh
+ * @brief Framebuffer frontend and headless backends
+ */
+#ifndef LIBVIO_FRAMEBUFFER_HH
+#define LIBVIO_FRAMEBUFFER_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <libvio/backend.hh>
+#include <libvio/frontend.hh>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace libvio {
+
+namespace reqval {
+inline static constexpr uint64_t fb_width = 1 << 0;  ///< Reading screen width
+inline static constexpr uint64_t fb_height = 1 << 1; ///< Reading screen height
+inline static constexpr uint64_t fb_sync =
+    1 << 2; ///< Presenting the pixels written since the last sync
+} // namespace reqval
+
+/**
+ * @brief `io_frontend` implementation for a framebuffer
+ *
+ * Register layout:
+ *
+ * | Offset | Width | Access | Register                                     |
+ * | ------ | ----- | ------ | -------------------------------------------- |
+ * | 0x0    | 32    | RO     | `(width << 16) \| height`                    |
+ * | 0x0    | 16    | RO     | Height in pixels                             |
+ * | 0x2    | 16    | RO     | Width in pixels                              |
+ * | 0x4    | 32    | WO     | Write anything to present the frame          |
+ * | 0x1000 |       | RW     | Pixels, `0x00RRGGBB` each, row by row        |
+ *
+ * The pixels are a host bank provided by the backend, so a CPU mapping the
+ * banks of its agent stores to them directly like RAM, and the store marks
+ * the pixels dirty. Only dirty rectangles are passed to the backend on a
+ * sync. Stores of other CPUs, e.g. the REF of a differential test, go to
+ * copies of the pixels and are not presented.
+ *
+ * The backend must be a `framebuffer_backend`, and the device must span
+ * `framebuffer_backend::byte_span()` bytes.
+ */
+class framebuffer_frontend : public io_frontend {
+public:
+  static constexpr uint64_t pixel_offset = 0x1000; ///< Offset of the pixels
+
+  ioreq_t resolve_read(uint64_t offset, width_t width) const override;
+  ioreq_t resolve_write(uint64_t offset, width_t width,
+                        uint64_t data) const override;
+  std::vector<host_bank_t> host_banks(void) const override;
+  uint64_t ioctl_get(uint64_t req) override;
+  void ioctl_set(uint64_t req, uint64_t value) override;
+};
+
+/**
+ * @struct fb_rect_t
+ * @brief A rectangle on the screen
+ */
+struct fb_rect_t {
+  uint32_t x;      ///< Left edge in pixels
+  uint32_t y;      ///< Top edge in pixels
+  uint32_t width;  ///< Width in pixels
+  uint32_t height; ///< Height in pixels
+};
+
+/**
+ * @brief Base class of framebuffer backends
+ *
+ * A framebuffer backend owns the pixel memory and a dirty bitmap with one bit
+ * per 64 bytes of pixels. On a sync, the bitmap is turned into dirty
+ * rectangles, cleared and passed to `present()`.
+ */
+class framebuffer_backend : public io_backend {
+public:
+  static constexpr unsigned dirty_shift = 6; ///< 64-byte dirty blocks
+
+  /**
+   * @brief Get the host bank holding the pixels
+   * @return host_bank_t The pixels with dirty tracking, at offset 0
+   */
+  host_bank_t pixel_bank(void);
+
+  /**
+   * @brief Get the address range size of the device
+   * @return uint64_t Size in bytes including registers and pixels
+   */
+  uint64_t byte_span(void) const;
+
+  /**
+   * @brief Collect the rectangles written since the last call
+   *
+   * Consecutive rows with dirty pixels are merged into one rectangle covering
+   * the union of their dirty columns. The dirty bitmap is cleared.
+   *
+   * @return std::vector<fb_rect_t> Dirty rectangles from top to bottom
+   */
+  std::vector<fb_rect_t> take_dirty_rects(void);
+
+  uint64_t request(uint64_t req) override;
+  bool poll(uint64_t req) override;
+  bool check(uint64_t req) override;
+  void put(uint64_t req, uint64_t data) override;
+
+protected:
+  uint32_t width;                  ///< Screen width in pixels
+  uint32_t height;                 ///< Screen height in pixels
+  uint32_t *pixels = nullptr;      ///< Pixel memory, set by subclasses
+  std::vector<uint64_t> dirty_map; ///< One bit per 64-byte block of pixels
+
+  /**
+   * @brief Initialize the screen size, subclasses must set up `pixels`
+   * @param width Screen width in pixels
+   * @param height Screen height in pixels
+   */
+  framebuffer_backend(uint32_t width, uint32_t height);
+
+  /**
+   * @brief Present a frame
+   * @param dirty Rectangles changed since the last frame, may be empty
+   */
+  virtual void present(const std::vector<fb_rect_t> &dirty) = 0;
+};
+
+/**
+ * @brief Headless framebuffer backend dumping frames to PPM files
+ *
+ * A binary PPM file is written on each sync with dirty pixels. The file name
+ * is made by `printf`-style formatting the frame number into a pattern, e.g.
+ * `"frame%05u.ppm"`.
+ */
+class framebuffer_backend_ppm : public framebuffer_backend {
+public:
+  /**
+   * @brief Construct a PPM dumping backend
+   * @param width Screen width in pixels
+   * @param height Screen height in pixels
+   * @param pattern File name pattern with a `%u` for the frame number
+   */
+  framebuffer_backend_ppm(uint32_t width, uint32_t height,
+                          const char *pattern);
+
+protected:
+  std::unique_ptr<uint32_t[]> storage; ///< Pixel memory
+  std::string pattern;                 ///< File name pattern
+  unsigned frame = 0;                  ///< Number of frames dumped
+
+  void present(const std::vector<fb_rect_t> &dirty) override;
+};
+
+/**
+ * @struct fb_shm_header_t
+ * @brief Header of a shared memory surface, followed by the pixels
+ *
+ * A viewer maps the shared memory object, waits for `frame` to change and then
+ * redraws the bounding box of the dirty rectangles of that frame.
+ */
+struct fb_shm_header_t {
+  uint32_t magic;  ///< `fb_shm_magic`
+  uint32_t width;  ///< Screen width in pixels
+  uint32_t height; ///< Screen height in pixels
+  uint32_t offset; ///< Offset of the pixels from the header in bytes
+  uint64_t frame;  ///< Number of frames presented, updated last
+  fb_rect_t dirty; ///< Bounding box of the dirty area of the last frame
+};
+
+inline static constexpr uint32_t fb_shm_magic = 0x6f697666; ///< "fvio"
+
+/**
+ * @brief Headless framebuffer backend presenting to a shared memory surface
+ *
+ * The pixel memory lives in a POSIX shared memory object, so guest stores are
+ * visible to other processes without copying. The object is removed on
+ * destruction.
+ */
+class framebuffer_backend_shm : public framebuffer_backend {
+public:
+  /**
+   * @brief Create a shared memory surface
+   * @param width Screen width in pixels
+   * @param height Screen height in pixels
+   * @param name Name of the shared memory object, e.g. `"/libvio-fb"`
+   */
+  framebuffer_backend_shm(uint32_t width, uint32_t height, const char *name);
+  ~framebuffer_backend_shm();
+  framebuffer_backend_shm(const framebuffer_backend_shm &) = delete;
+  framebuffer_backend_shm &operator=(const framebuffer_backend_shm &) = delete;
+
+protected:
+  std::string name;                  ///< Name of the shared memory object
+  fb_shm_header_t *header = nullptr; ///< Mapped shared memory
+  size_t map_size = 0;               ///< Size of the mapping in bytes
+  std::unique_ptr<uint32_t[]> fallback; ///< Pixel memory if mapping fails
+
+  void present(const std::vector<fb_rect_t> &dirty) override;
+};
+
+} // namespace libvio
+
+#endif
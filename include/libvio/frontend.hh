@@ -5,10 +5,12 @@
 #ifndef LIBVIO_FRONTEND_HH
 #define LIBVIO_FRONTEND_HH
 
+#include <cstddef>
 #include <cstdint>
 #include <libvio/backend.hh>
 #include <libvio/width.hh>
 #include <optional>
+#include <vector>
 
 namespace libvio {
 
@@ -36,6 +38,29 @@ struct ioreq_t {
   uint64_t req;      ///< Frontend-specific request identifier/parameter
 };
 
+/**
+ * @struct host_bank_t
+ * @brief A range of device registers backed directly by host memory
+ *
+ * Registers in a host bank are plain storage without side effects, so a CPU
+ * may access them directly like RAM, through the ranges returned by
+ * `io_agent::host_ranges()`. Each agent maps its own copy of the bank, and
+ * only the first one maps the bank itself. Agents not mapping the banks, e.g.
+ * the ones recording accesses, have them served from host memory by the
+ * dispatcher, without resolving requests or invoking the backend.
+ *
+ * If `dirty_map` is set, bit `i` of the bitmap is set on each write to the
+ * bank itself touching bytes `[i << dirty_shift, (i + 1) << dirty_shift)`.
+ * The owner of the bank is responsible for clearing it.
+ */
+struct host_bank_t {
+  uint64_t offset;   ///< Offset of the bank in the device
+  uint64_t size;     ///< Size of the bank in bytes
+  uint8_t *host_ptr; ///< Host memory holding the content of the bank
+  uint64_t *dirty_map = nullptr; ///< Bitmap of written blocks, may be nullptr
+  unsigned dirty_shift = 0; ///< Log2 of the block size tracked by each bit
+};
+
 /**
  * @class io_frontend
  * @brief Abstract base class for I/O frontend implementations
@@ -48,6 +73,8 @@ struct ioreq_t {
  * the same device in a cycle. There will be an error if there are different
  * read / write requests in the same cycle. Derived classes must implement
  * request resolution logic.
+ * @see `libvio::register_map` for resolving requests with a declarative
+ * register map
  */
 class io_frontend {
 public:
@@ -88,6 +115,51 @@ public:
    */
   virtual bool write(uint64_t offset, width_t width, uint64_t data);
 
+  /**
+   * @brief Execute a burst read of a contiguous span
+   *
+   * The default implementation performs a byte read for each byte in the
+   * span. Devices moving blocks of data, e.g. DMA engines, should override it.
+   *
+   * @param offset Memory address offset of the first byte
+   * @param data Destination buffer of at least `len` bytes
+   * @param len Number of bytes to read
+   * @return true if the whole span is read, false otherwise
+   */
+  virtual bool read_burst(uint64_t offset, uint8_t *data, size_t len);
+
+  /**
+   * @brief Execute a burst write of a contiguous span
+   * @param offset Memory address offset of the first byte
+   * @param data Source buffer of at least `len` bytes
+   * @param len Number of bytes to write
+   * @return true if the whole span is written, false otherwise
+   * @see read_burst()
+   */
+  virtual bool write_burst(uint64_t offset, const uint8_t *data, size_t len);
+
+  /**
+   * @brief Get the host memory backed ranges of this device
+   *
+   * The dispatcher queries the banks when the device is attached, so the
+   * banks must be set up on construction and stay valid during the lifetime
+   * of the frontend. Banks must not overlap with each other.
+   *
+   * @return Host memory banks of this device, empty by default
+   */
+  virtual std::vector<host_bank_t> host_banks(void) const { return {}; }
+
+  /**
+   * @brief Get the level of the interrupt output of this device
+   *
+   * The dispatcher samples the level after each request handled by this
+   * frontend and after collecting asynchronous completions, so the level must
+   * only change in these places.
+   *
+   * @return true if the device requests an interrupt, false by default
+   */
+  virtual bool irq_level(void) const { return false; }
+
   virtual ~io_frontend() = default;
 
 protected:
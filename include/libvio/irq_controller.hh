@@ -0,0 +1,40 @@
+/**
+ * @file irq_controller.hh
+ * @brief Interface of interrupt controllers attached to an `io_dispatcher`
+ */
+#ifndef LIBVIO_IRQ_CONTROLLER_HH
+#define LIBVIO_IRQ_CONTROLLER_HH
+
+#include <cstdint>
+
+namespace libvio {
+
+/**
+ * @brief Abstract base class of interrupt controllers
+ *
+ * An interrupt controller sits between the interrupt lines driven by devices
+ * (its sources) and the interrupt lines seen by the agents (its outputs).
+ * The dispatcher passes the source levels when they change and reads the
+ * outputs afterwards, and also after each access to the controller itself if
+ * it is a device on the bus.
+ */
+class irq_controller {
+public:
+  /**
+   * @brief Update the levels of the source lines
+   * @param levels Bit `i` is the level of source line `i`
+   */
+  virtual void set_sources(uint64_t levels) = 0;
+
+  /**
+   * @brief Get the levels of the output lines
+   * @return uint64_t Bit `i` is the level of output line `i`
+   */
+  virtual uint64_t outputs(void) const = 0;
+
+  virtual ~irq_controller() = default;
+};
+
+} // namespace libvio
+
+#endif
@@ -0,0 +1,151 @@
+#ifndef LIBVIO_PHASE_HH
+#define LIBVIO_PHASE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+/**
+ * @file phase.hh
+ * @brief Host time spent in each phase of the simulation.
+ *
+ * Phases are marked with `LIBVIO_PHASE(name)`, which times the rest of the
+ * enclosing scope. A phase entered inside another one pauses the outer
+ * phase, so each tick is counted in exactly one phase. Each switch reads the
+ * time stamp counter once.
+ *
+ * Phase profiling is compiled in only if `LIBVIO_PHASE_PROFILE` is defined,
+ * e.g. with the meson option `-Dphase_profile=true`, otherwise the macro
+ * expands to nothing. All code using the headers must agree on it.
+ */
+
+namespace libvio {
+
+/**
+ * @enum phase_t
+ * @brief Phases of the simulation
+ */
+enum class phase_t : uint8_t {
+  none,     ///< Outside the simulation, not reported
+  cpu,      ///< CPU loop, outside the other phases
+  fetch,    ///< Instruction fetch
+  decode,   ///< Instruction decode
+  execute,  ///< Instruction execution
+  memory,   ///< Loads and stores, including address translation
+  mmio,     ///< MMIO requests on the I/O bus
+  trace,    ///< Event tracing
+  difftest, ///< Comparison of differential testing
+};
+
+/// Number of phases, including `phase_t::none`
+constexpr size_t n_phases = static_cast<size_t>(phase_t::difftest) + 1;
+
+#ifdef LIBVIO_PHASE_PROFILE
+/// Whether phase profiling is compiled in
+constexpr bool phase_profile_enabled = true;
+#else
+constexpr bool phase_profile_enabled = false;
+#endif
+
+/**
+ * @struct phase_profile_t
+ * @brief Ticks per phase of a thread
+ */
+struct phase_profile_t {
+  phase_t current = phase_t::none;  ///< The phase being timed
+  uint64_t last = 0;                ///< Tick of the last switch
+  uint64_t ticks[n_phases] = {};    ///< Ticks spent in each phase
+  uint64_t switches[n_phases] = {}; ///< Intervals charged to each phase
+};
+
+/// Profile of the current thread
+inline thread_local phase_profile_t phase_profile;
+
+/**
+ * @brief Read the host cycle counter
+ *
+ * This is the time stamp counter on x86, and a steady clock in nanoseconds
+ * elsewhere.
+ *
+ * @return uint64_t The tick count
+ */
+inline uint64_t phase_clock(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * @brief Charge the ticks since the last switch and enter a phase
+ * @param phase The phase entered
+ * @return phase_t The phase left
+ */
+inline phase_t switch_phase(phase_t phase) {
+  uint64_t now = phase_clock();
+  phase_profile_t &profile = phase_profile;
+  profile.ticks[static_cast<size_t>(profile.current)] += now - profile.last;
+  ++profile.switches[static_cast<size_t>(profile.current)];
+  profile.last = now;
+  phase_t outer = profile.current;
+  profile.current = phase;
+  return outer;
+}
+
+/**
+ * @brief Time a phase until the end of the scope
+ */
+class phase_scope {
+public:
+  explicit phase_scope(phase_t phase) : outer(switch_phase(phase)) {}
+  ~phase_scope() { switch_phase(outer); }
+  phase_scope(const phase_scope &) = delete;
+  phase_scope &operator=(const phase_scope &) = delete;
+
+private:
+  phase_t outer; ///< The phase to resume at the end of the scope
+};
+
+/**
+ * @brief Get the name of a phase
+ * @param phase The phase
+ * @return const char* The name
+ */
+const char *phase_name(phase_t phase);
+
+/**
+ * @brief Clear the profile of the current thread
+ */
+void reset_phase_profile(void);
+
+/**
+ * @brief Write the ticks per phase of the current thread
+ *
+ * Each phase is reported with its share of the ticks and its ticks per
+ * guest instruction. The cost of reading the clock, measured once, is
+ * subtracted from each interval charged to a phase.
+ *
+ * @param os Output stream
+ * @param instructions Guest instructions executed since the last reset
+ */
+void write_phase_profile(std::ostream &os, uint64_t instructions);
+
+} // namespace libvio
+
+#ifdef LIBVIO_PHASE_PROFILE
+#define LIBVIO_PHASE(name)                                                     \
+  ::libvio::phase_scope libvio_phase_scope { ::libvio::phase_t::name }
+#else
+#define LIBVIO_PHASE(name) static_cast<void>(0)
+#endif
+
+#endif
@@ -0,0 +1,88 @@
+/**
+ * @file plic.hh
+ * @brief RISC-V platform-level interrupt controller (PLIC)
+ */
+#ifndef LIBVIO_PLIC_HH
+#define LIBVIO_PLIC_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <libvio/frontend.hh>
+#include <libvio/irq_controller.hh>
+#include <vector>
+
+namespace libvio {
+
+/**
+ * @brief `io_frontend` implementation for a PLIC
+ *
+ * The register layout follows the PLIC of SiFive and QEMU `virt` machines:
+ *
+ * | Offset                      | Register                              |
+ * | --------------------------- | ------------------------------------- |
+ * | `0x000000 + 4 * source`     | Priority of the source                |
+ * | `0x001000 + 4 * word`       | Pending bits, read-only               |
+ * | `0x002000 + 0x80 * context` | Enable bits of the context            |
+ * | `0x200000 + 0x1000 * ctx`   | Priority threshold of the context     |
+ * | `0x200004 + 0x1000 * ctx`   | Claim on read, complete on write      |
+ *
+ * All registers are 32-bit. Source `i` is the interrupt line `i` of the
+ * dispatcher, so devices should use lines from 1, as source 0 means no
+ * interrupt. Up to 63 sources are supported.
+ *
+ * Sources are level-sensitive. A source is pending while its line is high and
+ * it is not claimed. A claimed source becomes pending again after completion
+ * if its line is still high. Output `i` is high if context `i` has an enabled
+ * pending source with a priority above its threshold. With
+ * `libcpu::riscv_cpu_system`, context 0 is the machine external interrupt and
+ * context 1 is the supervisor external interrupt of the hart.
+ *
+ * The PLIC has no backend, attach it with a nullptr backend and register it
+ * with `io_dispatcher::set_irq_controller()`.
+ */
+class plic_frontend : public io_frontend, public irq_controller {
+public:
+  static constexpr uint64_t byte_span = 0x4000000; ///< Address range size
+  static constexpr unsigned max_sources = 64; ///< Including source 0
+
+  /**
+   * @brief Construct a PLIC
+   * @param n_contexts Number of contexts, i.e. output lines
+   */
+  plic_frontend(unsigned n_contexts = 2);
+
+  ioreq_t resolve_read(uint64_t offset, width_t width) const override;
+  ioreq_t resolve_write(uint64_t offset, width_t width,
+                        uint64_t data) const override;
+  uint64_t ioctl_get(uint64_t req) override;
+  void ioctl_set(uint64_t req, uint64_t value) override;
+
+  void set_sources(uint64_t levels) override;
+  uint64_t outputs(void) const override;
+
+protected:
+  unsigned n_contexts;            ///< Number of contexts
+  uint32_t priority[max_sources]; ///< Priority of each source
+  uint64_t levels = 0;            ///< Levels of the source lines
+  uint64_t pending = 0;           ///< Pending bit of each source
+  uint64_t claimed = 0;           ///< Sources claimed but not completed
+  std::vector<uint64_t> enable;   ///< Enabled sources of each context
+  std::vector<uint32_t> threshold; ///< Priority threshold of each context
+
+  /**
+   * @brief Find the source a context would claim
+   * @param context The context claiming
+   * @return unsigned The enabled pending source with the highest priority
+   * above the threshold, the lowest one on ties, 0 if none
+   */
+  unsigned best_source(unsigned context) const;
+
+  /**
+   * @brief Recompute the pending bits from the levels and claimed sources
+   */
+  void update_pending(void);
+};
+
+} // namespace libvio
+
+#endif
@@ -0,0 +1,172 @@
+/**
+ * @file regmap.hh
+ * @brief Compile-time register maps for `io_frontend` implementations
+ */
+#ifndef LIBVIO_REGMAP_HH
+#define LIBVIO_REGMAP_HH
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <libvio/frontend.hh>
+#include <libvio/width.hh>
+#include <stdexcept>
+
+namespace libvio {
+
+/**
+ * @enum reg_access_t
+ * @brief Allowed access types of a device register
+ */
+enum class reg_access_t : uint8_t {
+  read_only = 1,  ///< Only reads are resolved
+  write_only = 2, ///< Only writes are resolved
+  read_write = 3  ///< Both reads and writes are resolved
+};
+
+/**
+ * @struct reg_def_t
+ * @brief Declarative definition of a device register
+ *
+ * A register is identified by its offset and access width. The same offset
+ * can be defined multiple times with different widths, e.g. a 64-bit register
+ * that can also be accessed as two 32-bit halves.
+ */
+struct reg_def_t {
+  uint64_t offset;     ///< Offset of the register in the device
+  width_t width;       ///< Access width of the register
+  reg_access_t access; ///< Allowed access types
+  ioreq_t read;        ///< Request a read is resolved to
+  ioreq_t write;       ///< Request a write is resolved to
+};
+
+/**
+ * @brief A register map resolving MMIO accesses by table lookup
+ *
+ * The map is built from a list of `reg_def_t` at compile time. Each
+ * `(offset, width)` pair has a slot in a flat table, so resolving a request
+ * takes constant time. Accesses not matching any register, including
+ * misaligned accesses and accesses with a wrong width or access type, are
+ * resolved as `ioreq_type_t::invalid`.
+ *
+ * A register may overlap another one only as a narrower view nested inside
+ * it, such as the halves of a 64-bit register. Duplicate definitions,
+ * registers overlapping partially and registers beyond the span are rejected
+ * when the map is constant-evaluated, so declare maps as `constexpr` to have
+ * these mistakes caught by the compiler. Reads and writes are checked
+ * separately, so a read-only and a write-only register may share a slot.
+ *
+ * ```c++
+ * static constexpr register_map<8> registers{{
+ *     {0, width_t::byte, reg_access_t::read_write,
+ *      {ioreq_type_t::read, reqval::console_rx},
+ *      {ioreq_type_t::write, reqval::console_tx}},
+ * }};
+ * ```
+ *
+ * @tparam SPAN Address range size of the device in bytes. The tables take
+ * `SPAN * 4` slots, so this is meant for control registers, not for large
+ * buffers.
+ */
+template <uint64_t SPAN> class register_map {
+public:
+  /**
+   * @brief Build a register map from register definitions
+   * @param defs Array of register definitions
+   */
+  template <size_t N> constexpr register_map(const reg_def_t (&defs)[N]) {
+    read_table.fill({ioreq_type_t::invalid, 0});
+    write_table.fill({ioreq_type_t::invalid, 0});
+    for (const reg_def_t &def : defs) {
+      if (def.offset + static_cast<uint64_t>(def.width) > SPAN) {
+        throw std::out_of_range("libvio: Register beyond device span.");
+      }
+      for (const reg_def_t &other : defs) {
+        if (overlap_partially(def, other)) {
+          throw std::logic_error("libvio: Overlapping register definitions.");
+        }
+      }
+      size_t index = slot(def.offset, def.width);
+      if (static_cast<uint8_t>(def.access) &
+          static_cast<uint8_t>(reg_access_t::read_only)) {
+        if (read_table[index].type != ioreq_type_t::invalid) {
+          throw std::logic_error("libvio: Duplicate register definition.");
+        }
+        read_table[index] = def.read;
+      }
+      if (static_cast<uint8_t>(def.access) &
+          static_cast<uint8_t>(reg_access_t::write_only)) {
+        if (write_table[index].type != ioreq_type_t::invalid) {
+          throw std::logic_error("libvio: Duplicate register definition.");
+        }
+        write_table[index] = def.write;
+      }
+    }
+  }
+
+  /**
+   * @brief Resolve a read request
+   * @param offset Memory address offset
+   * @param width Data access width
+   * @return Resolved I/O request structure
+   */
+  constexpr ioreq_t resolve_read(uint64_t offset, width_t width) const {
+    if (offset >= SPAN) {
+      return {ioreq_type_t::invalid, 0};
+    }
+    return read_table[slot(offset, width)];
+  }
+
+  /**
+   * @brief Resolve a write request
+   * @param offset Memory address offset
+   * @param width Data access width
+   * @return Resolved I/O request structure
+   */
+  constexpr ioreq_t resolve_write(uint64_t offset, width_t width) const {
+    if (offset >= SPAN) {
+      return {ioreq_type_t::invalid, 0};
+    }
+    return write_table[slot(offset, width)];
+  }
+
+private:
+  std::array<ioreq_t, SPAN * 4> read_table{};  ///< Read requests by slot
+  std::array<ioreq_t, SPAN * 4> write_table{}; ///< Write requests by slot
+
+  /**
+   * @brief Check if two registers overlap without one nesting in the other
+   * @param a A register
+   * @param b Another register
+   * @return true if both are accessed in a common direction and their byte
+   * ranges intersect, but neither range contains the other
+   */
+  static constexpr bool overlap_partially(const reg_def_t &a,
+                                          const reg_def_t &b) {
+    if ((static_cast<uint8_t>(a.access) & static_cast<uint8_t>(b.access)) ==
+        0) {
+      return false;
+    }
+    uint64_t a_end = a.offset + static_cast<uint64_t>(a.width);
+    uint64_t b_end = b.offset + static_cast<uint64_t>(b.width);
+    bool intersect = a.offset < b_end && b.offset < a_end;
+    bool a_in_b = b.offset <= a.offset && a_end <= b_end;
+    bool b_in_a = a.offset <= b.offset && b_end <= a_end;
+    return intersect && !a_in_b && !b_in_a;
+  }
+
+  /**
+   * @brief Get the table slot of an access
+   * @param offset Memory address offset, must be less than `SPAN`
+   * @param width Data access width
+   * @return Index into the tables
+   */
+  static constexpr size_t slot(uint64_t offset, width_t width) {
+    return offset * 4 + std::countr_zero(static_cast<unsigned>(width));
+  }
+};
+
+} // namespace libvio
+
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file replay.hh
+ * @brief MMIO agent recording and replaying the results of requests
+ */
+#ifndef LIBVIO_REPLAY_HH
+#define LIBVIO_REPLAY_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <libvio/agent.hh>
+#include <libvio/width.hh>
+#include <optional>
+#include <vector>
+
+namespace libvio {
+
+/**
+ * @brief An `io_agent` recording the results of the requests passed to another
+ * agent, so they can be replayed after rewinding the CPU
+ *
+ * Every request and interrupt poll gets an entry in a log. Interrupt line
+ * changes and DMA writes delivered to the target agent during a request are
+ * logged right before the entry of the request. While the position is at the
+ * end of the log, requests are passed to the target agent and logged. After
+ * `seek()` to an earlier position, requests are served from the log without
+ * reaching the devices, and interrupt line changes and DMA writes are
+ * delivered at the same points as when they were recorded. Execution is
+ * therefore deterministic as long as the CPU issues the same requests again,
+ * which it does when it is rewound to a saved state together with its memory.
+ *
+ * The agent takes over `io_agent::irq_handler`,
+ * `io_agent::dma_write_handler` and `io_agent::dma_read_handler` of the
+ * target on construction and gives them back on destruction.
+ */
+class replay_agent : public io_agent {
+public:
+  /**
+   * @brief Start recording the requests passed to an agent
+   * @param target The agent passing requests to the devices, must outlive
+   * the replay agent
+   */
+  explicit replay_agent(io_agent *target);
+  ~replay_agent();
+  replay_agent(const replay_agent &) = delete;
+  replay_agent &operator=(const replay_agent &) = delete;
+
+  std::optional<uint64_t> read(uint64_t addr, width_t width) override;
+  bool write(uint64_t addr, width_t width, uint64_t data) override;
+  bool read_burst(uint64_t addr, uint8_t *data, size_t len) override;
+  bool write_burst(uint64_t addr, const uint8_t *data, size_t len) override;
+  void poll_irq(void) override;
+
+  /**
+   * @brief Get the position of the next request in the log
+   * @return size_t Number of entries logged before the next request
+   */
+  size_t position(void) const { return pos; }
+
+  /**
+   * @brief Move to a position in the log
+   * @param position A value of `position()` not before `first()`
+   */
+  void seek(size_t position) { pos = position; }
+
+  /**
+   * @brief Get the earliest position still in the log
+   * @return size_t The earliest position
+   */
+  size_t first(void) const { return base; }
+
+  /**
+   * @brief Drop the entries before a position from the log
+   * @param position The new earliest position, not after `position()`
+   */
+  void discard(size_t position);
+
+  /**
+   * @brief Check whether requests are served from the log
+   * @return true if the position is before the end of the log
+   */
+  bool replaying(void) const { return pos < base + log.size(); }
+
+  /**
+   * @brief Get the memory held by the log
+   * @return size_t Approximate size of the log in bytes
+   */
+  size_t memory_usage(void) const { return log_bytes; }
+
+private:
+  /**
+   * @enum kind_t
+   * @brief Types of logged events
+   */
+  enum class kind_t : uint8_t {
+    read,        ///< Single read
+    write,       ///< Single write
+    read_burst,  ///< Burst read
+    write_burst, ///< Burst write
+    poll,        ///< Interrupt poll
+    irq,         ///< Interrupt line change
+    dma          ///< DMA write
+  };
+
+  /**
+   * @struct entry_t
+   * @brief A logged event
+   */
+  struct entry_t {
+    kind_t kind;    ///< Type of the event
+    bool ok;        ///< Whether the request succeeded
+    uint64_t addr;  ///< Address of the request
+    uint64_t value; ///< Data read, interrupt line levels, or burst number
+  };
+
+  io_agent *target;        ///< The agent reaching the devices
+  std::deque<entry_t> log; ///< Logged events from position `base`
+  size_t base = 0;         ///< Position of the first entry in `log`
+  size_t pos = 0;          ///< Position of the next event
+  /// Data of the logged burst reads and DMA writes, kept apart to keep entries
+  /// small
+  std::deque<std::vector<uint8_t>> bursts;
+  size_t burst_base = 0; ///< Burst number of the first entry in `bursts`
+  size_t log_bytes = 0;  ///< Approximate size of the log in bytes
+  bool warned = false;   ///< Whether a divergence has been reported
+
+  /**
+   * @brief Append an entry at the end of the log
+   * @param entry The entry
+   */
+  void append(const entry_t &entry);
+
+  /**
+   * @brief Deliver logged interrupt line changes and DMA writes and take the
+   * next entry
+   * @param kind Expected type of the entry
+   * @param addr Expected address of the request
+   * @return The next entry, nullptr if it does not match the request
+   */
+  const entry_t *replay(kind_t kind, uint64_t addr);
+};
+
+} // namespace libvio
+
+#endif
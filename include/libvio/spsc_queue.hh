@@ -0,0 +1,121 @@
+/**
+ * @file spsc_queue.hh
+ * @brief Lock-free single-producer single-consumer queue
+ */
+#ifndef LIBVIO_SPSC_QUEUE_HH
+#define LIBVIO_SPSC_QUEUE_HH
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace libvio {
+
+/**
+ * @brief A bounded lock-free queue for one producer thread and one consumer
+ * thread
+ *
+ * Pushing and popping never block or take locks. The head and tail indices
+ * live on separate cache lines, so the two threads only share a cache line
+ * when the queue is nearly empty or full.
+ *
+ * A consumer that runs out of work can sleep with an event count:
+ *
+ * ```c++
+ * uint32_t epoch = queue.epoch();
+ * // check other wake-up conditions here
+ * queue.wait(epoch); // returns once data arrives or notify() is called
+ * ```
+ *
+ * The producer calls `notify()` after pushing. Taking the epoch before
+ * checking the other conditions makes sure no notification is lost.
+ *
+ * @tparam T Type of elements, should be trivially copyable
+ * @tparam N Capacity of the queue, must be a power of 2
+ */
+template <typename T, size_t N> class spsc_queue {
+  static_assert(N != 0 && (N & (N - 1)) == 0, "N must be a power of 2");
+
+public:
+  /**
+   * @brief Append an element, called by the producer only
+   * @param value Element to append
+   * @return bool False if the queue is full
+   */
+  bool try_push(const T &value) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head_cache == N) {
+      head_cache = head.load(std::memory_order_acquire);
+      if (t - head_cache == N) {
+        return false;
+      }
+    }
+    buffer[t % N] = value;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove the first element, called by the consumer only
+   * @param value Receives the element removed
+   * @return bool False if the queue is empty
+   */
+  bool try_pop(T &value) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail_cache) {
+      tail_cache = tail.load(std::memory_order_acquire);
+      if (h == tail_cache) {
+        return false;
+      }
+    }
+    value = buffer[h % N];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Check whether the queue is empty
+   * @return bool True if there is nothing to pop
+   */
+  bool empty(void) const {
+    return head.load(std::memory_order_acquire) ==
+           tail.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Get the current event count
+   * @return uint32_t Value to be passed to `wait()`
+   */
+  uint32_t epoch(void) const { return events.load(std::memory_order_seq_cst); }
+
+  /**
+   * @brief Block until the queue is not empty or the event count has changed
+   * @param epoch Event count obtained by `epoch()` before checking for work
+   */
+  void wait(uint32_t epoch) const {
+    if (empty()) {
+      events.wait(epoch, std::memory_order_seq_cst);
+    }
+  }
+
+  /**
+   * @brief Wake up a consumer blocked in `wait()`
+   */
+  void notify(void) {
+    events.fetch_add(1, std::memory_order_seq_cst);
+    events.notify_all();
+  }
+
+private:
+  alignas(64) std::atomic<size_t> head{0}; ///< Index of the next pop
+  size_t tail_cache = 0; ///< Tail seen by the consumer last time
+  alignas(64) std::atomic<size_t> tail{0}; ///< Index of the next push
+  size_t head_cache = 0; ///< Head seen by the producer last time
+  alignas(64) std::atomic<uint32_t> events{0}; ///< Event count for waiting
+  alignas(64) std::array<T, N> buffer;         ///< Storage of elements
+};
+
+} // namespace libvio
+
+#endif
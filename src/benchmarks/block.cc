@@ -0,0 +1,189 @@
+/**
+ * @file A benchmark of block transfers completed by interrupts.
+ *
+ * `kernel_block` reads sectors from a `block_backend_mmap` disk image and
+ * waits for each transfer by spinning in RAM until the completion interrupt.
+ * The transfers run on the worker thread of the backend, and the completions
+ * reach the CPU when it polls the interrupts every
+ * `riscv_cpu_system::irq_poll_interval` instructions. The kernel runs alone
+ * and under `simple_difftest`, where the REF must see the sectors and the
+ * interrupt at the same instruction as the DUT. Reported are the transfers
+ * per second and the instructions spent per transfer. The benchmark fails on
+ * a wrong checksum or a difftest error.
+ *
+ * Usage: bench_block [transfers=2000]
+ */
+#include "riscv_kernels.hh"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <libcpu/difftest.hh>
+#include <libcpu/event.hh>
+#include <libcpu/memory.hh>
+#include <libcpu/riscv_cpu_system.hh>
+#include <libvio/block.hh>
+#include <libvio/bus.hh>
+#include <libvio/ringbuffer.hh>
+#include <libvio/width.hh>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+using cpu_t = libcpu::riscv_cpu_system<uint32_t>;
+using event_buffer_t = libvio::ringbuffer<libcpu::event_t<uint32_t>>;
+
+constexpr size_t max_instructions = 1ul << 32; ///< Limit of a runaway kernel
+constexpr size_t disk_words = bench::block_slots * bench::block_sectors *
+                              libvio::block_sector_size / 4;
+
+// Result of a run of the kernel.
+struct result_t {
+  uint32_t checksum;
+  size_t instructions;
+  double seconds;
+};
+
+// A CPU with its own memory and event buffer, loaded with a kernel.
+struct machine_t {
+  libcpu::memory mem{bench::code_base, bench::ram_size};
+  event_buffer_t events{1024};
+  cpu_t cpu;
+
+  machine_t(const bench::kernel_t &kernel, libvio::io_dispatcher &bus) {
+    for (size_t i = 0; i < kernel.code.size(); ++i) {
+      mem.write(bench::code_base + i * 4, libvio::width_t::word,
+                kernel.code[i]);
+    }
+    cpu.mem_bus = &mem;
+    cpu.mmio_bus = bus.new_agent();
+    cpu.event_buffer = &events;
+    cpu.reset(bench::code_base);
+  }
+};
+
+// Write a disk image of pseudo-random words, returning the words.
+std::vector<uint32_t> make_disk(const std::string &path) {
+  std::vector<uint32_t> words(disk_words);
+  uint32_t x = 0x2545f491;
+  for (uint32_t &word : words) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    word = x;
+  }
+  std::ofstream out{path, std::ios::binary};
+  out.write(reinterpret_cast<const char *>(words.data()), words.size() * 4);
+  return words;
+}
+
+// The checksum `kernel_block` computes, the disk is little-endian as the host.
+uint32_t expected_checksum(const std::vector<uint32_t> &disk,
+                           uint32_t transfers) {
+  constexpr size_t slot_words = disk_words / bench::block_slots;
+  uint32_t sum = 0;
+  for (uint32_t i = transfers; i > 0; --i) {
+    size_t first = (i % bench::block_slots) * slot_words;
+    for (size_t j = 0; j < slot_words; ++j) {
+      sum += disk[first + j];
+    }
+  }
+  return sum;
+}
+
+libvio::io_dispatcher *new_bus(const std::string &disk) {
+  auto bus = new libvio::io_dispatcher{};
+  bus->add_device(new libvio::block_frontend{},
+                  new libvio::block_backend_mmap{disk.c_str()},
+                  bench::block_base, 0x28, cpu_t::irq_line_m_external);
+  return bus;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point begin) {
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+result_t run_alone(const bench::kernel_t &kernel, const std::string &disk) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus(disk)};
+  machine_t machine{kernel, *bus};
+  auto begin = std::chrono::steady_clock::now();
+  size_t n = machine.cpu.run(max_instructions, nullptr);
+  return {machine.cpu.get_gpr(10), n, seconds_since(begin)};
+}
+
+// nullopt on a difftest error.
+std::optional<result_t> run_difftest(const bench::kernel_t &kernel,
+                                     const std::string &disk) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus(disk)};
+  machine_t dut{kernel, *bus};
+  machine_t ref{kernel, *bus};
+  libcpu::simple_difftest<uint32_t> difftest;
+  difftest.dut = &dut.cpu;
+  difftest.ref = &ref.cpu;
+  difftest.reset(bench::code_base);
+  auto begin = std::chrono::steady_clock::now();
+  // stepped by hand, as the REF only follows the DUT up to its last register
+  // write, so it stops after the DUT, which `run()` would report
+  size_t n = 0;
+  while (!dut.cpu.stopped() && !difftest.get_difftest_error() &&
+         n < max_instructions) {
+    difftest.next_cycle();
+    ++n;
+  }
+  ref.cpu.run(max_instructions, nullptr);
+  double seconds = seconds_since(begin);
+  if (difftest.get_difftest_error() || !ref.cpu.stopped()) {
+    return {};
+  }
+  return result_t{ref.cpu.get_gpr(10), n, seconds};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t transfers = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 2000;
+  if (transfers == 0) {
+    std::cerr << "Usage: " << argv[0] << " [transfers=2000]" << std::endl;
+    return 1;
+  }
+
+  std::string disk = "/tmp/bench_block." + std::to_string(getpid()) + ".img";
+  uint32_t expected = expected_checksum(make_disk(disk), transfers);
+  bench::kernel_t kernel = bench::kernel_block(transfers);
+
+  bool failed = false;
+  std::cout << std::setw(10) << "mode" << std::setw(16) << "transfers/s"
+            << std::setw(18) << "instr/transfer" << std::endl;
+  std::optional<result_t> results[] = {run_alone(kernel, disk),
+                                       run_difftest(kernel, disk)};
+  const char *modes[] = {"alone", "difftest"};
+  for (size_t i = 0; i < 2; ++i) {
+    if (!results[i].has_value()) {
+      std::cerr << "Kernel " << kernel.name << " failed difftest" << std::endl;
+      failed = true;
+      continue;
+    }
+    const result_t &result = results[i].value();
+    if (result.checksum != expected) {
+      std::cerr << "Kernel " << kernel.name << " read wrong data "
+                << modes[i] << std::endl;
+      failed = true;
+      continue;
+    }
+    std::cout << std::setw(10) << modes[i] << std::fixed
+              << std::setprecision(0) << std::setw(16)
+              << transfers / result.seconds << std::setw(18)
+              << double(result.instructions) / transfers << std::defaultfloat
+              << std::endl;
+  }
+  unlink(disk.c_str());
+  return failed ? 1 : 0;
+}
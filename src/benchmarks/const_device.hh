@@ -0,0 +1,63 @@
+/**
+ * @file A trivial MMIO device for the libvio benchmarks.
+ *
+ * Every offset of the device is a read-write register, whose reads return
+ * `const_value` and whose writes are discarded, so the benchmarks time the
+ * bus and not the device.
+ */
+#ifndef BENCHMARKS_CONST_DEVICE_HH
+#define BENCHMARKS_CONST_DEVICE_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <libvio/backend.hh>
+#include <libvio/bus.hh>
+#include <libvio/frontend.hh>
+#include <libvio/width.hh>
+
+namespace bench {
+
+constexpr uint64_t const_value = 0x5a; ///< Value of every read
+
+class const_frontend : public libvio::io_frontend {
+public:
+  libvio::ioreq_t resolve_read(uint64_t offset,
+                               libvio::width_t width) const override {
+    return {libvio::ioreq_type_t::read, 0};
+  }
+  libvio::ioreq_t resolve_write(uint64_t offset, libvio::width_t width,
+                                uint64_t data) const override {
+    return {libvio::ioreq_type_t::write, 0};
+  }
+  uint64_t ioctl_get(uint64_t req) override { return 0; }
+  void ioctl_set(uint64_t req, uint64_t value) override {}
+};
+
+class const_backend : public libvio::io_backend {
+public:
+  uint64_t request(uint64_t req) override { return const_value; }
+  bool poll(uint64_t req) override { return true; }
+  bool check(uint64_t req) override { return true; }
+  void put(uint64_t req, uint64_t data) override {}
+};
+
+/**
+ * @brief Create a dispatcher with constant devices
+ * @param n_devices Number of devices
+ * @param base Address of the first device
+ * @param span Address range of each device, the devices are contiguous
+ * @return The dispatcher, owned by the caller
+ */
+inline libvio::io_dispatcher *new_const_bus(size_t n_devices, uint64_t base,
+                                            uint64_t span) {
+  auto bus = new libvio::io_dispatcher{};
+  for (size_t i = 0; i < n_devices; ++i) {
+    bus->add_device(new const_frontend{}, new const_backend{}, base + i * span,
+                    span);
+  }
+  return bus;
+}
+
+} // namespace bench
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @file A benchmark of `libcpu::simple_difftest` with a multi-issue DUT.
+ *
+ * The DUT is synthetic: it wraps a `riscv_cpu_system` and commits `K`
+ * instructions per `next_cycle()`, as a superscalar core would. The DUT runs
+ * a kernel alone and under `simple_difftest` against a plain
+ * `riscv_cpu_system`, for `K` = 1, 2, 4 and 8, on a kernel without MMIO and
+ * on one polling a timer, whose reads the REF replays from the dispatcher.
+ * Reported are the speed of both runs in MIPS and the cost of difftest per
+ * committed instruction. The benchmark fails on a difftest error.
+ *
+ * Usage: bench_difftest [scale=2], where the scale is the length of the
+ * kernels in units of about a million instructions.
+ */
+#include "riscv_kernels.hh"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <libcpu/abstract_cpu.hh>
+#include <libcpu/difftest.hh>
+#include <libcpu/event.hh>
+#include <libcpu/memory.hh>
+#include <libcpu/riscv_cpu_system.hh>
+#include <libvio/bus.hh>
+#include <libvio/mtime.hh>
+#include <libvio/ringbuffer.hh>
+#include <libvio/width.hh>
+#include <memory>
+#include <optional>
+
+namespace {
+
+using cpu_t = libcpu::riscv_cpu_system<uint32_t>;
+using event_buffer_t = libvio::ringbuffer<libcpu::event_t<uint32_t>>;
+
+constexpr size_t max_instructions = 1ul << 32; ///< Limit of a runaway kernel
+
+// A DUT committing `width` instructions per cycle, by stepping a core that
+// commits one. The buses and the event buffer are passed to the core on reset.
+class batch_cpu : public libcpu::abstract_cpu<uint32_t> {
+public:
+  using libcpu::abstract_cpu<uint32_t>::next_cycle;
+
+  explicit batch_cpu(size_t width) : width(width) {}
+
+  uint8_t n_gpr(void) const override { return core.n_gpr(); }
+  const char *gpr_name(uint8_t addr) const override {
+    return core.gpr_name(addr);
+  }
+  uint8_t gpr_addr(const char *name) const override {
+    return core.gpr_addr(name);
+  }
+  void reset(uint32_t init_pc) override {
+    core.mem_bus = mem_bus;
+    core.mmio_bus = mmio_bus;
+    core.event_buffer = event_buffer;
+    core.reset(init_pc);
+  }
+  uint32_t get_pc(void) const override { return core.get_pc(); }
+  const uint32_t *get_gpr(void) const override { return core.get_gpr(); }
+  uint32_t get_gpr(uint8_t addr) const override { return core.get_gpr(addr); }
+  void next_cycle(void) override {
+    for (size_t i = 0; i < width && !core.stopped(); ++i) {
+      core.next_instruction();
+    }
+  }
+  void next_instruction(void) override { next_cycle(); }
+  bool stopped(void) const override { return core.stopped(); }
+  std::optional<uint32_t> get_trap(void) const override {
+    return core.get_trap();
+  }
+
+private:
+  cpu_t core;
+  size_t width; ///< Instructions committed per cycle
+};
+
+// A CPU with its own memory and event buffer, loaded with a kernel.
+template <typename CPU_T> struct machine_t {
+  libcpu::memory mem{bench::code_base, bench::ram_size};
+  event_buffer_t events{1024};
+  CPU_T cpu;
+
+  template <typename... ARGS_T>
+  machine_t(const bench::kernel_t &kernel, libvio::io_dispatcher &bus,
+            ARGS_T... args)
+      : cpu(args...) {
+    for (size_t i = 0; i < kernel.code.size(); ++i) {
+      mem.write(bench::code_base + i * 4, libvio::width_t::word,
+                kernel.code[i]);
+    }
+    cpu.mem_bus = &mem;
+    cpu.mmio_bus = bus.new_agent();
+    cpu.event_buffer = &events;
+    cpu.reset(bench::code_base);
+  }
+};
+
+libvio::io_dispatcher *new_bus(void) {
+  return new libvio::io_dispatcher{{{new libvio::mtime_frontend{},
+                                     new libvio::mtime_backend_chrono{},
+                                     bench::mtime_base, 16}}};
+}
+
+// Count the instructions of a kernel, including the final `ebreak`.
+size_t count_instructions(const bench::kernel_t &kernel) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus()};
+  machine_t<cpu_t> machine{kernel, *bus};
+  return machine.cpu.run(max_instructions, nullptr);
+}
+
+double seconds_since(std::chrono::steady_clock::time_point begin) {
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+// Host time of `cycles` cycles of a DUT of the given width, alone.
+double run_alone(const bench::kernel_t &kernel, size_t width, size_t cycles) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus()};
+  machine_t<batch_cpu> dut{kernel, *bus, width};
+  auto begin = std::chrono::steady_clock::now();
+  dut.cpu.next_cycle(cycles);
+  return seconds_since(begin);
+}
+
+// Host time of `cycles` cycles of a DUT of the given width under difftest,
+// nullopt on a difftest error.
+std::optional<double> run_difftest(const bench::kernel_t &kernel,
+                                   size_t width, size_t cycles) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus()};
+  machine_t<batch_cpu> dut{kernel, *bus, width};
+  machine_t<cpu_t> ref{kernel, *bus};
+  libcpu::simple_difftest<uint32_t> difftest;
+  difftest.dut = &dut.cpu;
+  difftest.ref = &ref.cpu;
+  difftest.reset(bench::code_base);
+  auto begin = std::chrono::steady_clock::now();
+  size_t done = difftest.run(cycles, nullptr);
+  double seconds = seconds_since(begin);
+  if (done != cycles || difftest.get_difftest_error()) {
+    return {};
+  }
+  return seconds;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t scale = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 2;
+  if (scale == 0) {
+    std::cerr << "Usage: " << argv[0] << " [scale=2]" << std::endl;
+    return 1;
+  }
+
+  bool failed = false;
+  bench::kernel_t kernels[] = {bench::kernel_integer(scale * 25000),
+                               bench::kernel_mmio(scale * 170000)};
+  std::cout << std::setw(10) << "kernel" << std::setw(4) << "K"
+            << std::setw(12) << "DUT MIPS" << std::setw(15) << "difftest MIPS"
+            << std::setw(16) << "ns/instr added" << std::endl;
+  for (const bench::kernel_t &kernel : kernels) {
+    size_t n = count_instructions(kernel);
+    for (size_t width : {1, 2, 4, 8}) {
+      // whole cycles only, stopping before the `ebreak`, so that the DUT
+      // never stops in the middle of a cycle
+      size_t cycles = (n - 1) / width;
+      size_t instructions = cycles * width;
+      double alone = run_alone(kernel, width, cycles);
+      std::optional<double> difftest = run_difftest(kernel, width, cycles);
+      if (!difftest.has_value()) {
+        std::cerr << "Kernel " << kernel.name << " failed difftest with K = "
+                  << width << std::endl;
+        failed = true;
+        continue;
+      }
+      std::cout << std::setw(10) << kernel.name << std::setw(4) << width
+                << std::fixed << std::setprecision(2) << std::setw(12)
+                << instructions / alone / 1e6 << std::setw(15)
+                << instructions / difftest.value() / 1e6 << std::setw(16)
+                << (difftest.value() - alone) / instructions * 1e9
+                << std::defaultfloat << std::endl;
+    }
+  }
+  return failed ? 1 : 0;
+}
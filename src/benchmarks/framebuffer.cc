@@ -0,0 +1,152 @@
+/**
+ * @file A benchmark of guest stores to framebuffer pixels.
+ *
+ * `kernel_pixels` stores every pixel of the screen in each sweep, to RAM and
+ * to the pixels of a framebuffer device, where it presents the frame after
+ * each sweep. The CPU stores to the pixels directly when it maps the host
+ * banks of its agent, or through the dispatcher when its agent does not map
+ * them, as in the requests of a recorded CPU. Reported are the stores per
+ * second and their ratio to the stores to RAM. The benchmark fails on a wrong
+ * checksum, or if a sweep is not presented as the whole screen.
+ *
+ * Usage: bench_framebuffer [sweeps=50]
+ */
+#include "riscv_kernels.hh"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <libcpu/memory.hh>
+#include <libcpu/riscv_cpu_system.hh>
+#include <libvio/agent.hh>
+#include <libvio/bus.hh>
+#include <libvio/framebuffer.hh>
+#include <libvio/width.hh>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace {
+
+using cpu_t = libcpu::riscv_cpu_system<uint32_t>;
+
+constexpr size_t max_instructions = 1ul << 32; ///< Limit of a runaway kernel
+constexpr uint64_t screen_pixels = uint64_t(bench::fb_width) * bench::fb_height;
+
+// Counts the frames presented as the whole screen.
+class counting_backend : public libvio::framebuffer_backend {
+public:
+  size_t full_frames = 0;
+
+  counting_backend()
+      : framebuffer_backend(bench::fb_width, bench::fb_height),
+        storage(screen_pixels) {
+    pixels = storage.data();
+  }
+
+protected:
+  void present(const std::vector<libvio::fb_rect_t> &dirty) override {
+    if (dirty.size() == 1 && dirty[0].x == 0 && dirty[0].y == 0 &&
+        dirty[0].width == width && dirty[0].height == height) {
+      ++full_frames;
+    }
+  }
+
+private:
+  std::vector<uint32_t> storage;
+};
+
+// Passes requests to another agent without mapping its host banks.
+class unmapped_agent : public libvio::io_agent {
+public:
+  explicit unmapped_agent(libvio::io_agent *target) : target(target) {}
+
+  std::optional<uint64_t> read(uint64_t addr, libvio::width_t width) override {
+    return target->read(addr, width);
+  }
+  bool write(uint64_t addr, libvio::width_t width, uint64_t data) override {
+    return target->write(addr, width, data);
+  }
+
+private:
+  libvio::io_agent *target;
+};
+
+enum class target_t { ram, direct, dispatch };
+
+// Result of a run of the kernel.
+struct result_t {
+  uint32_t checksum;
+  size_t full_frames;
+  double seconds;
+};
+
+result_t run(target_t target, uint32_t sweeps) {
+  auto backend = new counting_backend{};
+  libvio::io_dispatcher bus{};
+  bus.add_device(new libvio::framebuffer_frontend{}, backend, bench::fb_base,
+                 backend->byte_span());
+  uint32_t pixels = bench::fb_base + libvio::framebuffer_frontend::pixel_offset;
+  uint32_t present = bench::fb_base + 4;
+  if (target == target_t::ram) {
+    pixels = bench::data_base;
+    present = 0;
+  }
+  bench::kernel_t kernel = bench::kernel_pixels(sweeps, pixels, present);
+
+  libcpu::memory mem{bench::code_base, bench::ram_size};
+  for (size_t i = 0; i < kernel.code.size(); ++i) {
+    mem.write(bench::code_base + i * 4, libvio::width_t::word,
+              kernel.code[i]);
+  }
+  libvio::io_agent *agent = bus.new_agent();
+  unmapped_agent unmapped{agent};
+  cpu_t cpu;
+  cpu.mem_bus = &mem;
+  cpu.mmio_bus = target == target_t::dispatch ? &unmapped : agent;
+  cpu.reset(bench::code_base);
+  auto begin = std::chrono::steady_clock::now();
+  cpu.run(max_instructions, nullptr);
+  auto end = std::chrono::steady_clock::now();
+  return {cpu.get_gpr(10), backend->full_frames,
+          std::chrono::duration<double>(end - begin).count()};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t sweeps = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 50;
+  if (sweeps == 0) {
+    std::cerr << "Usage: " << argv[0] << " [sweeps=50]" << std::endl;
+    return 1;
+  }
+
+  uint32_t expected = uint64_t(sweeps) * (sweeps + 1) / 2;
+  double stores = double(sweeps) * screen_pixels;
+  bool failed = false;
+  std::cout << std::setw(10) << "target" << std::setw(14) << "Mstores/s"
+            << std::setw(10) << "vs RAM" << std::endl;
+  const char *names[] = {"ram", "direct", "dispatch"};
+  target_t targets[] = {target_t::ram, target_t::direct, target_t::dispatch};
+  double ram_seconds = 0;
+  for (size_t i = 0; i < 3; ++i) {
+    result_t result = run(targets[i], sweeps);
+    size_t frames = targets[i] == target_t::ram ? 0 : sweeps;
+    if (result.checksum != expected || result.full_frames != frames) {
+      std::cerr << "Kernel pixels failed on " << names[i] << std::endl;
+      failed = true;
+      continue;
+    }
+    if (targets[i] == target_t::ram) {
+      ram_seconds = result.seconds;
+    }
+    std::cout << std::setw(10) << names[i] << std::fixed
+              << std::setprecision(1) << std::setw(14)
+              << stores / result.seconds / 1e6 << std::setprecision(2)
+              << std::setw(10) << ram_seconds / result.seconds
+              << std::defaultfloat << std::endl;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,240 @@
+/**
+ * @file Microbenchmarks of the hot paths in libvio.
+ *
+ * Covered are the address decoding of `io_dispatcher`, round trips through an
+ * `mmio_agent`, the replay of cached reads to lagging agents, and
+ * `ringbuffer` appends and scans. Each case runs a batch of operations a few
+ * times to warm up, then times a number of repetitions of the batch. The
+ * median, 99th percentile and minimum time per operation over the
+ * repetitions are printed as CSV, or as JSON with `--json`, so the numbers
+ * can be collected over time.
+ *
+ * Usage: bench_libvio [--json] [--reps N]
+ */
+#include "const_device.hh"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <libcpu/event.hh>
+#include <libvio/bus.hh>
+#include <libvio/ringbuffer.hh>
+#include <libvio/width.hh>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr uint64_t base = 0xa0000000;
+constexpr uint64_t span = 0x1000;
+constexpr size_t batch = 4096; ///< Operations per repetition
+constexpr size_t warmup = 5;   ///< Repetitions not timed
+
+// Timing of a case, in nanoseconds per operation.
+struct stats_t {
+  double median;
+  double p99;
+  double min;
+};
+
+struct result_t {
+  std::string name;  ///< What is measured
+  std::string param; ///< Parameter of the case, e.g. the number of devices
+  size_t ops;        ///< Operations per repetition
+  stats_t stats;
+};
+
+// Sum of the results of all operations, so they cannot be optimized out.
+volatile uint64_t sink = 0;
+
+// Whether a read returned an unexpected value.
+bool failed = false;
+
+// Time `reps` runs of `run`, which performs `ops` operations.
+template <typename F> stats_t measure(F &&run, size_t ops, size_t reps) {
+  for (size_t i = 0; i < warmup; ++i) {
+    sink = sink + run();
+  }
+  std::vector<double> ns(reps);
+  for (size_t i = 0; i < reps; ++i) {
+    auto begin = std::chrono::steady_clock::now();
+    sink = sink + run();
+    auto end = std::chrono::steady_clock::now();
+    ns[i] = std::chrono::duration<double, std::nano>(end - begin).count() / ops;
+  }
+  std::sort(ns.begin(), ns.end());
+  size_t p99 = (reps * 99 + 99) / 100 - 1;
+  return {ns[reps / 2], ns[p99], ns[0]};
+}
+
+libvio::io_dispatcher *new_bus(size_t n_devices) {
+  return bench::new_const_bus(n_devices, base, span);
+}
+
+// The time per lookup should stay nearly the same as the number of devices
+// grows.
+void bench_decode(std::vector<result_t> &results, size_t reps) {
+  for (size_t n_devices : {1, 2, 4, 8, 16, 32, 64, 128, 256}) {
+    std::unique_ptr<libvio::io_dispatcher> bus{new_bus(n_devices)};
+    auto run = [&]() {
+      uint64_t sum = 0;
+      for (size_t i = 0; i < batch; ++i) {
+        uint64_t addr = base + (i % n_devices) * span + (i & 0xff);
+        sum += reinterpret_cast<uintptr_t>(bus->find_device(addr));
+      }
+      return sum;
+    };
+    results.push_back({"decode", "devices=" + std::to_string(n_devices), batch,
+                       measure(run, batch, reps)});
+  }
+}
+
+void bench_agent(std::vector<result_t> &results, size_t reps) {
+  std::unique_ptr<libvio::io_dispatcher> bus{new_bus(16)};
+  auto agent = bus->new_agent();
+  auto read = [&]() {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < batch; ++i) {
+      uint64_t addr = base + (i % 16) * span;
+      sum += agent->read(addr, libvio::width_t::word).value_or(0);
+    }
+    failed |= sum != batch * bench::const_value;
+    return sum;
+  };
+  auto write = [&]() {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < batch; ++i) {
+      uint64_t addr = base + (i % 16) * span;
+      sum += agent->write(addr, libvio::width_t::word, i);
+    }
+    return sum;
+  };
+  results.push_back({"agent_read", "devices=16", batch,
+                     measure(read, batch, reps)});
+  results.push_back({"agent_write", "devices=16", batch,
+                     measure(write, batch, reps)});
+}
+
+// The first agent leads by `lag` reads, the others replay them from the
+// request buffer of the dispatcher.
+void bench_replay(std::vector<result_t> &results, size_t reps) {
+  constexpr size_t lag = 16;
+  for (size_t n_agents : {1, 2, 4, 8}) {
+    std::unique_ptr<libvio::io_dispatcher> bus{new_bus(16)};
+    std::vector<libvio::mmio_agent *> agents;
+    for (size_t i = 0; i < n_agents; ++i) {
+      agents.push_back(bus->new_agent());
+    }
+    size_t ops = batch / lag / n_agents * lag * n_agents;
+    auto run = [&]() {
+      uint64_t sum = 0;
+      for (size_t round = 0; round < ops / lag / n_agents; ++round) {
+        for (libvio::mmio_agent *agent : agents) {
+          for (size_t i = 0; i < lag; ++i) {
+            uint64_t addr = base + (i % 16) * span;
+            sum += agent->read(addr, libvio::width_t::word).value_or(0);
+          }
+        }
+      }
+      failed |= sum != ops * bench::const_value;
+      return sum;
+    };
+    results.push_back({"replay", "agents=" + std::to_string(n_agents), ops,
+                       measure(run, ops, reps)});
+  }
+}
+
+void bench_ringbuffer(std::vector<result_t> &results, size_t reps) {
+  using event_t = libcpu::event_t<uint64_t>;
+  libvio::ringbuffer<event_t> buffer{1024};
+  auto push = [&]() {
+    for (size_t i = 0; i < batch; ++i) {
+      buffer.push_back({libcpu::event_type_t::issue, i, i, 0});
+    }
+    return buffer.lastindex();
+  };
+  auto iterate = [&]() {
+    uint64_t sum = 0;
+    for (size_t pass = 0; pass < batch / buffer.capacity(); ++pass) {
+      for (const event_t &event : buffer) {
+        sum += event.val1;
+      }
+    }
+    return sum;
+  };
+  // the way consumers with their own front index read the buffer
+  auto index = [&]() {
+    uint64_t sum = 0;
+    for (size_t pass = 0; pass < batch / buffer.capacity(); ++pass) {
+      for (size_t i = buffer.firstindex(); i < buffer.lastindex(); ++i) {
+        sum += buffer[i].val1;
+      }
+    }
+    return sum;
+  };
+  std::string param = "capacity=" + std::to_string(buffer.capacity());
+  results.push_back({"ringbuffer_push", param, batch,
+                     measure(push, batch, reps)});
+  results.push_back({"ringbuffer_iterate", param, batch,
+                     measure(iterate, batch, reps)});
+  results.push_back({"ringbuffer_index", param, batch,
+                     measure(index, batch, reps)});
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  bool json = false;
+  size_t reps = 101;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--json") == 0) {
+      json = true;
+    } else if (std::strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+      reps = std::strtoul(argv[++i], nullptr, 0);
+    } else {
+      reps = 0;
+    }
+    if (reps == 0) {
+      std::cerr << "Usage: " << argv[0] << " [--json] [--reps N]" << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<result_t> results;
+  bench_decode(results, reps);
+  bench_agent(results, reps);
+  bench_replay(results, reps);
+  bench_ringbuffer(results, reps);
+
+  if (json) {
+    std::cout << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+      const result_t &r = results[i];
+      std::cout << "  {\"name\": \"" << r.name << "\", \"param\": \""
+                << r.param << "\", \"ops\": " << r.ops
+                << ", \"reps\": " << reps
+                << ", \"median_ns\": " << r.stats.median
+                << ", \"p99_ns\": " << r.stats.p99
+                << ", \"min_ns\": " << r.stats.min << "}"
+                << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    std::cout << "]" << std::endl;
+  } else {
+    std::cout << "name,param,ops,reps,median_ns,p99_ns,min_ns" << std::endl;
+    for (const result_t &r : results) {
+      std::cout << r.name << "," << r.param << "," << r.ops << "," << reps
+                << "," << r.stats.median << "," << r.stats.p99 << ","
+                << r.stats.min << std::endl;
+    }
+  }
+
+  if (failed) {
+    std::cerr << "Unexpected read result." << std::endl;
+    return 1;
+  }
+  return 0;
+}
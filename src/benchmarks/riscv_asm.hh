@@ -0,0 +1,211 @@
+/**
+ * @file A tiny RISC-V assembler for the benchmark programs.
+ *
+ * Instructions are emitted by calling the member function of the same name,
+ * with the operands in assembly order. Branches and jumps take labels, which
+ * may be bound before or after their use. Only RV32IM, Zicsr and the
+ * privileged instructions used by the benchmarks are supported.
+ */
+#ifndef BENCHMARKS_RISCV_ASM_HH
+#define BENCHMARKS_RISCV_ASM_HH
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+
+/// Integer registers by their ABI names
+enum reg_t : uint8_t {
+  zero, ra, sp, gp, tp, t0, t1, t2, s0, s1, a0, a1, a2, a3, a4, a5,
+  a6, a7, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, t3, t4, t5, t6,
+};
+
+class riscv_asm {
+public:
+  /// A position in the program, bound by `bind()`
+  using label_t = size_t;
+
+  /**
+   * @brief Start an empty program
+   * @param base Address of the first instruction
+   */
+  explicit riscv_asm(uint32_t base) : base(base) {}
+
+  /**
+   * @brief Create a label
+   * @return label_t The label, not bound yet
+   */
+  label_t label(void) {
+    labels.push_back(unbound);
+    return labels.size() - 1;
+  }
+
+  /**
+   * @brief Bind a label to the next instruction
+   * @param l The label
+   */
+  void bind(label_t l) { labels[l] = code.size(); }
+
+  /**
+   * @brief Get the address of the next instruction
+   * @return uint32_t The address
+   */
+  uint32_t here(void) const { return base + code.size() * 4; }
+
+  /**
+   * @brief Resolve the labels and get the machine code
+   * @return The instruction words, all labels must be bound
+   */
+  std::vector<uint32_t> finish(void) {
+    for (const fixup_t &f : fixups) {
+      assert(labels[f.target] != unbound);
+      int32_t offset = (static_cast<int32_t>(labels[f.target]) -
+                        static_cast<int32_t>(f.pos)) *
+                       4;
+      code[f.pos] |= f.jump ? imm_j(offset) : imm_b(offset);
+    }
+    return code;
+  }
+
+  // RV32I register-register
+  void add(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 0, rd); }
+  void sub(reg_t rd, reg_t rs1, reg_t rs2) { r(0x20, rs2, rs1, 0, rd); }
+  void sll(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 1, rd); }
+  void slt(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 2, rd); }
+  void sltu(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 3, rd); }
+  void xor_(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 4, rd); }
+  void srl(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 5, rd); }
+  void sra(reg_t rd, reg_t rs1, reg_t rs2) { r(0x20, rs2, rs1, 5, rd); }
+  void or_(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 6, rd); }
+  void and_(reg_t rd, reg_t rs1, reg_t rs2) { r(0x00, rs2, rs1, 7, rd); }
+
+  // RV32M
+  void mul(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 0, rd); }
+  void mulh(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 1, rd); }
+  void mulhu(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 3, rd); }
+  void div(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 4, rd); }
+  void divu(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 5, rd); }
+  void rem(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 6, rd); }
+  void remu(reg_t rd, reg_t rs1, reg_t rs2) { r(0x01, rs2, rs1, 7, rd); }
+
+  // RV32I register-immediate
+  void addi(reg_t rd, reg_t rs1, int32_t imm) { i(imm, rs1, 0, rd, op_imm); }
+  void slti(reg_t rd, reg_t rs1, int32_t imm) { i(imm, rs1, 2, rd, op_imm); }
+  void xori(reg_t rd, reg_t rs1, int32_t imm) { i(imm, rs1, 4, rd, op_imm); }
+  void ori(reg_t rd, reg_t rs1, int32_t imm) { i(imm, rs1, 6, rd, op_imm); }
+  void andi(reg_t rd, reg_t rs1, int32_t imm) { i(imm, rs1, 7, rd, op_imm); }
+  void slli(reg_t rd, reg_t rs1, int32_t sh) { i(sh, rs1, 1, rd, op_imm); }
+  void srli(reg_t rd, reg_t rs1, int32_t sh) { i(sh, rs1, 5, rd, op_imm); }
+  void srai(reg_t rd, reg_t rs1, int32_t sh) {
+    i(0x400 | sh, rs1, 5, rd, op_imm);
+  }
+  void lui(reg_t rd, uint32_t imm) { emit((imm << 12) | (rd << 7) | 0x37); }
+
+  // loads and stores, with the offset before the base as in assembly
+  void lb(reg_t rd, int32_t off, reg_t rs1) { i(off, rs1, 0, rd, op_load); }
+  void lw(reg_t rd, int32_t off, reg_t rs1) { i(off, rs1, 2, rd, op_load); }
+  void lbu(reg_t rd, int32_t off, reg_t rs1) { i(off, rs1, 4, rd, op_load); }
+  void sb(reg_t rs2, int32_t off, reg_t rs1) { s(off, rs2, rs1, 0); }
+  void sw(reg_t rs2, int32_t off, reg_t rs1) { s(off, rs2, rs1, 2); }
+
+  // control transfers
+  void beq(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 0, l); }
+  void bne(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 1, l); }
+  void blt(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 4, l); }
+  void bge(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 5, l); }
+  void bltu(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 6, l); }
+  void bgeu(reg_t rs1, reg_t rs2, label_t l) { b(rs1, rs2, 7, l); }
+  void jal(reg_t rd, label_t l) {
+    fixups.push_back({code.size(), l, true});
+    emit((rd << 7) | 0x6f);
+  }
+  void jalr(reg_t rd, reg_t rs1, int32_t off) { i(off, rs1, 0, rd, 0x67); }
+
+  // system
+  void ecall(void) { emit(0x00000073); }
+  void ebreak(void) { emit(0x00100073); }
+  void mret(void) { emit(0x30200073); }
+  void csrrw(reg_t rd, uint16_t csr, reg_t rs1) { i(csr, rs1, 1, rd, 0x73); }
+  void csrrs(reg_t rd, uint16_t csr, reg_t rs1) { i(csr, rs1, 2, rd, 0x73); }
+
+  // pseudo-instructions
+  void li(reg_t rd, uint32_t imm) {
+    // the low part is sign-extended by addi, so the high part is rounded
+    uint32_t hi = (imm + 0x800) >> 12;
+    int32_t lo = static_cast<int32_t>(imm << 20) >> 20;
+    if (hi != 0) {
+      lui(rd, hi & 0xfffff);
+      if (lo != 0) {
+        addi(rd, rd, lo);
+      }
+    } else {
+      addi(rd, zero, lo);
+    }
+  }
+  void mv(reg_t rd, reg_t rs1) { addi(rd, rs1, 0); }
+  void j(label_t l) { jal(zero, l); }
+  void call(label_t l) { jal(ra, l); }
+  void ret(void) { jalr(zero, ra, 0); }
+  void beqz(reg_t rs1, label_t l) { beq(rs1, zero, l); }
+  void bnez(reg_t rs1, label_t l) { bne(rs1, zero, l); }
+  void csrr(reg_t rd, uint16_t csr) { csrrs(rd, csr, zero); }
+  void csrw(uint16_t csr, reg_t rs1) { csrrw(zero, csr, rs1); }
+
+private:
+  static constexpr size_t unbound = SIZE_MAX;
+  static constexpr uint32_t op_imm = 0x13;
+  static constexpr uint32_t op_load = 0x03;
+
+  /// A branch or jump to a label
+  struct fixup_t {
+    size_t pos;     ///< Index of the instruction
+    label_t target; ///< The label jumped to
+    bool jump;      ///< Whether it is a jal, otherwise a branch
+  };
+
+  uint32_t base;                ///< Address of the first instruction
+  std::vector<uint32_t> code;   ///< Instructions emitted
+  std::vector<size_t> labels;   ///< Instruction index of each label
+  std::vector<fixup_t> fixups;  ///< Label references to resolve
+
+  void emit(uint32_t instr) { code.push_back(instr); }
+
+  void r(uint32_t funct7, reg_t rs2, reg_t rs1, uint32_t funct3, reg_t rd) {
+    emit((funct7 << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+         (rd << 7) | 0x33);
+  }
+
+  void i(int32_t imm, reg_t rs1, uint32_t funct3, reg_t rd, uint32_t opcode) {
+    emit((static_cast<uint32_t>(imm) << 20) | (rs1 << 15) | (funct3 << 12) |
+         (rd << 7) | opcode);
+  }
+
+  void s(int32_t imm, reg_t rs2, reg_t rs1, uint32_t funct3) {
+    uint32_t u = static_cast<uint32_t>(imm);
+    emit(((u >> 5) << 25) | (rs2 << 20) | (rs1 << 15) | (funct3 << 12) |
+         ((u & 0x1f) << 7) | 0x23);
+  }
+
+  void b(reg_t rs1, reg_t rs2, uint32_t funct3, label_t l) {
+    fixups.push_back({code.size(), l, false});
+    emit((rs2 << 20) | (rs1 << 15) | (funct3 << 12) | 0x63);
+  }
+
+  static uint32_t imm_b(int32_t offset) {
+    uint32_t u = static_cast<uint32_t>(offset);
+    return (((u >> 12) & 1) << 31) | (((u >> 5) & 0x3f) << 25) |
+           (((u >> 1) & 0xf) << 8) | (((u >> 11) & 1) << 7);
+  }
+
+  static uint32_t imm_j(int32_t offset) {
+    uint32_t u = static_cast<uint32_t>(offset);
+    return (((u >> 20) & 1) << 31) | (((u >> 1) & 0x3ff) << 21) |
+           (((u >> 11) & 1) << 20) | (((u >> 12) & 0xff) << 12);
+  }
+};
+
+} // namespace bench
+
+#endif
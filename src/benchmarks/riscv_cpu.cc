@@ -0,0 +1,149 @@
+/**
+ * @file A benchmark of `libcpu::riscv_cpu_system` on a suite of kernels.
+ *
+ * The kernels are assembled in-tree, see `riscv_kernels.hh`, so no RISC-V
+ * toolchain is needed. Each kernel is run with tracing off, with tracing on
+ * and under `simple_difftest` against a second `riscv_cpu_system`, and the
+ * speed of each run is reported in MIPS. The benchmark fails if a kernel
+ * does not reach its `ebreak`, if the runs disagree on the checksum, or on a
+ * difftest error.
+ *
+ * Usage: bench_riscv_cpu [scale=4], where the scale is the number of
+ * iterations of each kernel in units of about a million instructions.
+ */
+#include "riscv_kernels.hh"
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <libcpu/difftest.hh>
+#include <libcpu/event.hh>
+#include <libcpu/memory.hh>
+#include <libcpu/riscv_cpu_system.hh>
+#include <libvio/bus.hh>
+#include <libvio/mtime.hh>
+#include <libvio/ringbuffer.hh>
+#include <libvio/width.hh>
+#include <memory>
+
+namespace {
+
+using cpu_t = libcpu::riscv_cpu_system<uint32_t>;
+using event_buffer_t = libvio::ringbuffer<libcpu::event_t<uint32_t>>;
+
+constexpr size_t max_instructions = 1ul << 32; ///< Limit of a runaway kernel
+
+enum class run_mode_t { off, trace, difftest };
+
+// A CPU with its own memory, loaded with a kernel.
+struct machine_t {
+  libcpu::memory mem{bench::code_base, bench::ram_size};
+  event_buffer_t events{1024};
+  cpu_t cpu;
+
+  machine_t(const bench::kernel_t &kernel, libvio::io_dispatcher &bus,
+            bool trace) {
+    for (size_t i = 0; i < kernel.code.size(); ++i) {
+      mem.write(bench::code_base + i * 4, libvio::width_t::word,
+                kernel.code[i]);
+    }
+    cpu.mem_bus = &mem;
+    cpu.mmio_bus = bus.new_agent();
+    cpu.event_buffer = trace ? &events : nullptr;
+    cpu.reset(bench::code_base);
+  }
+};
+
+struct result_t {
+  size_t instructions; ///< Instructions executed
+  double seconds;      ///< Host time of the run
+  uint32_t checksum;   ///< Value of `a0` at the end
+  bool ok;             ///< Whether the run ended as expected
+};
+
+// Run a kernel for `n` instructions, or until it stops if `n` is 0.
+result_t run(const bench::kernel_t &kernel, run_mode_t mode, size_t n) {
+  libvio::io_dispatcher bus{{{new libvio::mtime_frontend{},
+                              new libvio::mtime_backend_chrono{},
+                              bench::mtime_base, 16}}};
+  machine_t dut{kernel, bus, mode != run_mode_t::off};
+  libcpu::abstract_cpu<uint32_t> *cpu = &dut.cpu;
+  std::unique_ptr<machine_t> ref;
+  libcpu::simple_difftest<uint32_t> difftest;
+  if (mode == run_mode_t::difftest) {
+    ref = std::make_unique<machine_t>(kernel, bus, true);
+    difftest.dut = &dut.cpu;
+    difftest.ref = &ref->cpu;
+    difftest.reset(bench::code_base);
+    cpu = &difftest;
+  }
+
+  auto begin = std::chrono::steady_clock::now();
+  size_t done = cpu->run(n == 0 ? max_instructions : n, nullptr);
+  auto end = std::chrono::steady_clock::now();
+
+  bool ok = n == 0 ? dut.cpu.stopped() : done == n && !cpu->stopped();
+  if (mode == run_mode_t::difftest) {
+    ok = ok && !difftest.get_difftest_error();
+  }
+  return {done, std::chrono::duration<double>(end - begin).count(),
+          cpu->get_gpr(10), ok};
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t scale = argc > 1 ? std::strtoul(argv[1], nullptr, 0) : 4;
+  if (scale == 0) {
+    std::cerr << "Usage: " << argv[0] << " [scale=4]" << std::endl;
+    return 1;
+  }
+
+  bool failed = false;
+  double log_mips[3] = {0, 0, 0};
+  auto kernels = bench::kernels(scale);
+  std::cout << std::setw(10) << "kernel" << std::setw(14) << "instructions"
+            << std::setw(12) << "off MIPS" << std::setw(12) << "trace MIPS"
+            << std::setw(15) << "difftest MIPS" << std::endl;
+  for (const bench::kernel_t &kernel : kernels) {
+    // the other runs stop right before the `ebreak`, which stops the DUT
+    // without a committed instruction to compare
+    result_t results[3];
+    results[0] = run(kernel, run_mode_t::off, 0);
+    size_t n = results[0].instructions - 1;
+    results[1] = run(kernel, run_mode_t::trace, n);
+    results[2] = run(kernel, run_mode_t::difftest, n);
+
+    std::cout << std::setw(10) << kernel.name << std::setw(14)
+              << results[0].instructions << std::fixed << std::setprecision(2);
+    for (size_t i = 0; i < 3; ++i) {
+      double mips = results[i].instructions / results[i].seconds / 1e6;
+      log_mips[i] += std::log(mips);
+      std::cout << std::setw(i == 2 ? 15 : 12) << mips;
+    }
+    std::cout << std::defaultfloat << std::endl;
+
+    for (size_t i = 0; i < 3; ++i) {
+      if (!results[i].ok || results[i].checksum != results[0].checksum) {
+        const char *modes[] = {"off", "trace", "difftest"};
+        std::cerr << "Kernel " << kernel.name << " failed in the "
+                  << modes[i] << " run, checksum 0x" << std::hex
+                  << results[i].checksum << " instead of 0x"
+                  << results[0].checksum << std::dec << std::endl;
+        failed = true;
+      }
+    }
+  }
+
+  std::cout << std::setw(10) << "geomean" << std::setw(14) << ""
+            << std::fixed << std::setprecision(2);
+  for (size_t i = 0; i < 3; ++i) {
+    std::cout << std::setw(i == 2 ? 15 : 12)
+              << std::exp(log_mips[i] / kernels.size());
+  }
+  std::cout << std::defaultfloat << std::endl;
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file Benchmark kernels for the RISC-V simulators.
+ *
+ * Each kernel is a bare-metal RV32IM program starting at `code_base`, which
+ * leaves a checksum in `a0` and stops with `ebreak`. Kernels initialize all
+ * the memory they read. The checksums do not depend on the host, except for
+ * the values read from MMIO, so runs of the same kernel can be compared with
+ * each other.
+ */
+#ifndef BENCHMARKS_RISCV_KERNELS_HH
+#define BENCHMARKS_RISCV_KERNELS_HH
+
+#include "riscv_asm.hh"
+#include <cstddef>
+#include <cstdint>
+#include <libcpu/riscv/riscv.hh>
+#include <libvio/block.hh>
+#include <vector>
+
+namespace bench {
+
+constexpr uint32_t code_base = 0x80000000; ///< Address of the programs
+constexpr uint32_t data_base = 0x80040000; ///< Data used by the kernels
+constexpr uint32_t ram_size = 0x00100000;  ///< Size of the RAM
+constexpr uint32_t mtime_base = 0xa0000048; ///< Address of the timer
+constexpr uint32_t block_base = 0xa0001000; ///< Address of the block device
+constexpr uint32_t block_slots = 8;   ///< Transfers fitting in the disk
+constexpr uint32_t block_sectors = 8; ///< Sectors of a transfer
+constexpr uint32_t fb_base = 0xa1000000; ///< Address of the framebuffer
+constexpr uint32_t fb_width = 320;       ///< Screen width in pixels
+constexpr uint32_t fb_height = 240;      ///< Screen height in pixels
+
+/**
+ * @struct kernel_t
+ * @brief A benchmark program
+ */
+struct kernel_t {
+  const char *name;           ///< Name in reports
+  std::vector<uint32_t> code; ///< Machine code loaded at `code_base`
+};
+
+/**
+ * @brief Integer loop in the style of Dhrystone: calls, record updates and
+ * a string compare
+ * @param iterations Number of iterations
+ */
+inline kernel_t kernel_integer(uint32_t iterations) {
+  riscv_asm as{code_base};
+  auto clear = as.label(), loop = as.label(), func = as.label();
+  auto cmp = as.label(), differ = as.label();
+  as.li(s0, iterations);
+  as.li(s1, data_base);
+  as.li(sp, code_base + ram_size);
+  as.li(a0, 0);
+  // the RAM is not cleared by the simulator
+  as.addi(t0, s1, 64);
+  as.bind(clear);
+  as.addi(t0, t0, -4);
+  as.sw(zero, 0, t0);
+  as.bne(t0, s1, clear);
+  as.li(t0, 1);
+  as.sb(t0, 47, s1);
+  as.bind(loop);
+  as.mv(a1, s0);
+  as.call(func);
+  as.add(a0, a0, a2);
+  // update a record
+  as.lw(t0, 0, s1);
+  as.add(t0, t0, a2);
+  as.sw(t0, 0, s1);
+  as.lw(t1, 4, s1);
+  as.xor_(t1, t1, t0);
+  as.sw(t1, 4, s1);
+  as.slt(t2, t0, t1);
+  as.add(a0, a0, t2);
+  // compare two 16-byte strings, equal except for the last byte
+  as.addi(t3, s1, 16);
+  as.addi(t4, s1, 32);
+  as.addi(t5, s1, 48);
+  as.bind(cmp);
+  as.lbu(t0, 0, t3);
+  as.lbu(t1, 0, t4);
+  as.bne(t0, t1, differ);
+  as.addi(t3, t3, 1);
+  as.addi(t4, t4, 1);
+  as.bltu(t3, t5, cmp);
+  as.bind(differ);
+  as.sub(t0, t0, t1);
+  as.add(a0, a0, t0);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  // a small leaf function
+  as.bind(func);
+  as.slli(t3, a1, 3);
+  as.add(t3, t3, a1);
+  as.xori(t3, t3, 0x55);
+  as.srli(t4, t3, 2);
+  as.or_(a2, t3, t4);
+  as.andi(a2, a2, 0x7ff);
+  as.ret();
+  return {"integer", as.finish()};
+}
+
+/**
+ * @brief Copy of a 4 KiB buffer, one word at a time and unrolled
+ * @param iterations Number of copies
+ */
+inline kernel_t kernel_memcpy(uint32_t iterations) {
+  riscv_asm as{code_base};
+  auto fill = as.label(), loop = as.label(), copy = as.label();
+  as.li(s0, iterations);
+  as.li(s1, data_base);
+  as.li(s2, data_base + 0x1000);
+  as.li(a0, 0);
+  // fill the source with a pattern
+  as.mv(t0, s1);
+  as.li(t1, 0x01234567);
+  as.bind(fill);
+  as.sw(t1, 0, t0);
+  as.addi(t1, t1, 0x111);
+  as.addi(t0, t0, 4);
+  as.bltu(t0, s2, fill);
+  as.bind(loop);
+  as.mv(t0, s1);
+  as.mv(t1, s2);
+  as.bind(copy);
+  as.lw(t2, 0, t0);
+  as.lw(t3, 4, t0);
+  as.lw(t4, 8, t0);
+  as.lw(t5, 12, t0);
+  as.sw(t2, 0, t1);
+  as.sw(t3, 4, t1);
+  as.sw(t4, 8, t1);
+  as.sw(t5, 12, t1);
+  as.addi(t0, t0, 16);
+  as.addi(t1, t1, 16);
+  as.bltu(t0, s2, copy);
+  as.lw(t2, -4, t1);
+  as.add(a0, a0, t2);
+  // shift the source by a byte, so each copy differs
+  as.lbu(t3, 0, s1);
+  as.addi(t3, t3, 1);
+  as.sb(t3, 0, s1);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"memcpy", as.finish()};
+}
+
+/**
+ * @brief Branches on pseudo-random bits, so they are hard to predict
+ * @param iterations Number of iterations
+ */
+inline kernel_t kernel_branchy(uint32_t iterations) {
+  riscv_asm as{code_base};
+  auto loop = as.label();
+  auto l1 = as.label(), l2 = as.label(), l3 = as.label(), l4 = as.label();
+  as.li(s0, iterations);
+  as.li(t0, 0x2545f491);
+  as.li(t3, 4);
+  as.li(a0, 0);
+  as.bind(loop);
+  // xorshift32
+  as.slli(t1, t0, 13);
+  as.xor_(t0, t0, t1);
+  as.srli(t1, t0, 17);
+  as.xor_(t0, t0, t1);
+  as.slli(t1, t0, 5);
+  as.xor_(t0, t0, t1);
+  as.andi(t2, t0, 1);
+  as.beqz(t2, l1);
+  as.addi(a0, a0, 3);
+  as.bind(l1);
+  as.andi(t2, t0, 2);
+  as.bnez(t2, l2);
+  as.xori(a0, a0, 0x5a);
+  as.bind(l2);
+  as.blt(t0, zero, l3);
+  as.addi(a0, a0, -1);
+  as.bind(l3);
+  as.andi(t2, t0, 12);
+  as.bltu(t2, t3, l4);
+  as.slli(t1, a0, 1);
+  as.add(a0, a0, t1);
+  as.bind(l4);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"branchy", as.finish()};
+}
+
+/**
+ * @brief Multiplications and divisions of changing operands
+ * @param iterations Number of iterations
+ */
+inline kernel_t kernel_muldiv(uint32_t iterations) {
+  riscv_asm as{code_base};
+  auto loop = as.label();
+  as.li(s0, iterations);
+  as.li(s2, 0x9e3779b9);
+  as.li(s3, 0x7f4a7c15);
+  as.li(a0, 0);
+  as.bind(loop);
+  as.mul(t0, s2, s3);
+  as.mulh(t1, s2, s3);
+  as.mulhu(t2, s2, s3);
+  as.ori(s4, s3, 1);
+  as.div(t3, s2, s4);
+  as.divu(t4, s2, s4);
+  as.rem(t5, s2, s4);
+  as.remu(t6, s2, s4);
+  as.add(a0, a0, t0);
+  as.xor_(a0, a0, t1);
+  as.add(a0, a0, t2);
+  as.xor_(a0, a0, t3);
+  as.add(a0, a0, t4);
+  as.xor_(a0, a0, t5);
+  as.add(a0, a0, t6);
+  as.add(s2, s2, t0);
+  as.srli(s3, s3, 1);
+  as.xor_(s3, s3, t2);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"muldiv", as.finish()};
+}
+
+/**
+ * @brief Polling of the timer through MMIO
+ *
+ * The values read depend on the host, so only the number of reads goes into
+ * the checksum.
+ *
+ * @param iterations Number of iterations
+ */
+inline kernel_t kernel_mmio(uint32_t iterations) {
+  riscv_asm as{code_base};
+  auto loop = as.label();
+  as.li(s0, iterations);
+  as.li(s1, mtime_base);
+  as.li(a0, 0);
+  as.bind(loop);
+  as.lw(t0, 0, s1);
+  as.lw(t1, 4, s1);
+  as.xor_(t2, t0, t1);
+  as.addi(a0, a0, 2);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"mmio", as.finish()};
+}
+
+/**
+ * @brief System calls to a machine-mode trap handler
+ * @param iterations Number of iterations
+ */
+inline kernel_t kernel_trap(uint32_t iterations) {
+  using csr = libcpu::riscv::csr_addr;
+  riscv_asm as{code_base};
+  auto start = as.label(), loop = as.label();
+  as.j(start);
+  // the handler skips the ecall and adds the cause to the checksum
+  uint32_t handler = as.here();
+  as.csrr(t0, csr::mepc);
+  as.addi(t0, t0, 4);
+  as.csrw(csr::mepc, t0);
+  as.csrr(t1, csr::mcause);
+  as.add(a0, a0, t1);
+  as.mret();
+  as.bind(start);
+  as.li(t0, handler);
+  as.csrw(csr::mtvec, t0);
+  as.li(s0, iterations);
+  as.li(a0, 0);
+  as.bind(loop);
+  as.ecall();
+  as.addi(a0, a0, 1);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"trap", as.finish()};
+}
+
+/**
+ * @brief Sector reads from a block device, each waited for by spinning in RAM
+ * until the completion interrupt
+ *
+ * Transfer `i`, counting down from `transfers`, reads `block_sectors`
+ * sectors from slot `i % block_slots` of the disk to `data_base`. The
+ * interrupt handler acknowledges the device and counts the completion. The
+ * words read go into the checksum. The spins are counted in `s5` and not in
+ * the checksum, as their number depends on the host, but the register writes
+ * let a differential test check that every CPU takes the interrupt after the
+ * same number of spins.
+ *
+ * @param transfers Number of transfers
+ */
+inline kernel_t kernel_block(uint32_t transfers) {
+  using csr = libcpu::riscv::csr_addr;
+  constexpr uint32_t bytes = block_sectors * libvio::block_sector_size;
+  riscv_asm as{code_base};
+  auto start = as.label(), loop = as.label(), wait = as.label();
+  auto sum = as.label();
+  as.j(start);
+  uint32_t handler = as.here();
+  as.sw(zero, 0x1c, s1);
+  as.addi(s3, s3, 1);
+  as.mret();
+  as.bind(start);
+  as.li(t0, handler);
+  as.csrw(csr::mtvec, t0);
+  as.li(t0, libcpu::riscv::mie<uint32_t>::meie);
+  as.csrw(csr::mie, t0);
+  as.li(t0, libcpu::riscv::mstatus<uint32_t>::mie);
+  as.csrrs(zero, csr::mstatus, t0);
+  as.li(s0, transfers);
+  as.li(s1, block_base);
+  as.li(s2, data_base);
+  as.li(s3, 0);
+  as.li(s5, 0);
+  as.li(a0, 0);
+  as.sw(s2, 0x08, s1);
+  as.sw(zero, 0x0c, s1);
+  as.li(t0, block_sectors);
+  as.sw(t0, 0x10, s1);
+  as.sw(zero, 0x04, s1);
+  as.bind(loop);
+  as.andi(t0, s0, block_slots - 1);
+  as.li(t1, block_sectors);
+  as.mul(t0, t0, t1);
+  as.sw(t0, 0x00, s1);
+  as.mv(s4, s3);
+  as.li(t0, libvio::block_cmd_read);
+  as.sw(t0, 0x14, s1);
+  // no MMIO while waiting, the CPU sees the interrupt by polling
+  as.bind(wait);
+  as.addi(s5, s5, 1);
+  as.beq(s3, s4, wait);
+  as.mv(t0, s2);
+  as.li(t1, data_base + bytes);
+  as.bind(sum);
+  as.lw(t2, 0, t0);
+  as.add(a0, a0, t2);
+  as.addi(t0, t0, 4);
+  as.bltu(t0, t1, sum);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"block", as.finish()};
+}
+
+/**
+ * @brief Sweeps storing every pixel of a `fb_width` by `fb_height` screen,
+ * four pixels per loop iteration
+ *
+ * Sweep `i`, counting down from `sweeps`, stores `i` to every pixel and adds
+ * the last pixel, read back, to the checksum.
+ *
+ * @param sweeps Number of sweeps
+ * @param pixels Address of the pixels, in RAM or in a framebuffer
+ * @param present Address of the present register written after each sweep,
+ * 0 for none
+ */
+inline kernel_t kernel_pixels(uint32_t sweeps, uint32_t pixels,
+                              uint32_t present) {
+  constexpr uint32_t bytes = fb_width * fb_height * 4;
+  riscv_asm as{code_base};
+  auto loop = as.label(), fill = as.label();
+  as.li(s0, sweeps);
+  as.li(s2, pixels + bytes);
+  as.li(s3, present);
+  as.li(a0, 0);
+  as.bind(loop);
+  as.li(s1, pixels);
+  as.bind(fill);
+  as.sw(s0, 0, s1);
+  as.sw(s0, 4, s1);
+  as.sw(s0, 8, s1);
+  as.sw(s0, 12, s1);
+  as.addi(s1, s1, 16);
+  as.bltu(s1, s2, fill);
+  if (present != 0) {
+    as.sw(zero, 0, s3);
+  }
+  as.lw(t0, -4, s2);
+  as.add(a0, a0, t0);
+  as.addi(s0, s0, -1);
+  as.bnez(s0, loop);
+  as.ebreak();
+  return {"pixels", as.finish()};
+}
+
+/**
+ * @brief Get all the kernels running without a block device
+ * @param scale Number of iterations of each kernel, in units of about a
+ * million instructions
+ * @return The kernels
+ */
+inline std::vector<kernel_t> kernels(uint32_t scale) {
+  return {kernel_integer(scale * 25000), kernel_memcpy(scale * 130),
+          kernel_branchy(scale * 50000), kernel_muldiv(scale * 50000),
+          kernel_mmio(scale * 170000),   kernel_trap(scale * 80000)};
+}
+
+} // namespace bench
+
+#endif
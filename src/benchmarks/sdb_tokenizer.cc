@@ -0,0 +1,318 @@
+/**
+ * @file A benchmark of the expression and command tokenizers of `libsdb`.
+ *
+ * The tokenizers are compared with the regex-based reference versions they
+ * replaced, first for equal output on a fixed corpus and on random inputs,
+ * then for speed. The benchmark fails if any output differs.
+ */
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <libsdb/commandline.hh>
+#include <libsdb/expression.hh>
+#include <optional>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace {
+
+using libsdb::token_t;
+using libsdb::token_type_t;
+
+// The regex-based expression tokenizer, kept as the reference.
+struct tokenizer_rule_t {
+  std::regex regex;
+  token_type_t type;
+  uint8_t precedence;
+  uint8_t base;
+};
+
+const tokenizer_rule_t reference_rules[] = {
+    {std::regex("\\s+"), token_type_t::space, 0, 0},
+    {std::regex("0b[01]+"), token_type_t::val, 0, 2},
+    {std::regex("0o[0-7]+"), token_type_t::val, 0, 8},
+    {std::regex("0x[0-9a-fA-F]+"), token_type_t::val, 0, 16},
+    {std::regex("[0-9]+"), token_type_t::val, 0, 10},
+    {std::regex("byte|half|word|sbyte|shalf|sword|pmem|vmem"), token_type_t::op,
+     8, 0},
+    {std::regex("<<|>>|>>>"), token_type_t::op, 5, 0},
+    {std::regex(">=|<=|>|<|==|!="), token_type_t::op, 4, 0},
+    {std::regex("[*/%]"), token_type_t::op, 7, 0},
+    {std::regex("[+-]"), token_type_t::op, 6, 0},
+    {std::regex("&"), token_type_t::op, 3, 0},
+    {std::regex("\\^"), token_type_t::op, 2, 0},
+    {std::regex("\\|"), token_type_t::op, 1, 0},
+    {std::regex("[~!]"), token_type_t::op, 8, 0},
+    {std::regex("\\("), token_type_t::parl, 0, 0},
+    {std::regex("\\)"), token_type_t::parr, 0, 0},
+    {std::regex("[a-z]+[0-9]*"), token_type_t::var, 0, 0}};
+
+std::vector<token_t> reference_tokenize_expression(const std::string &expr) {
+  std::vector<token_t> tokens;
+  std::string s = expr;
+  std::smatch m;
+  while (!s.empty()) {
+    bool matched = false;
+    for (const auto &rule : reference_rules) {
+      if (std::regex_search(s, m, rule.regex,
+                            std::regex_constants::match_continuous)) {
+        std::string token_str = m.str(0);
+        matched = true;
+        token_t token;
+        switch (rule.type) {
+        case token_type_t::val: {
+          token.type = token_type_t::val;
+          std::string num_str = token_str;
+          if (rule.base != 10) {
+            num_str = num_str.substr(2);
+          }
+          token.val = std::stoull(num_str, nullptr, rule.base);
+          tokens.push_back(token);
+          break;
+        }
+        case token_type_t::op:
+          token.type = token_type_t::op;
+          std::strncpy(token.op.str, token_str.c_str(), 6);
+          token.name[6] = 0;
+          token.op.prec = rule.precedence;
+          tokens.push_back(token);
+          break;
+        case token_type_t::var:
+          token.type = token_type_t::var;
+          std::strncpy(token.name, token_str.c_str(), 7);
+          token.name[7] = 0;
+          tokens.push_back(token);
+          break;
+        case token_type_t::parl:
+        case token_type_t::parr:
+          token.type = rule.type;
+          tokens.push_back(token);
+          break;
+        default:
+          break;
+        }
+        s = s.substr(token_str.length());
+        break;
+      }
+    }
+    if (!matched) {
+      tokens.push_back(token_t{token_type_t::invalid});
+      break;
+    }
+  }
+  return tokens;
+}
+
+// The character-by-character command tokenizer, kept as the reference.
+std::optional<std::vector<std::string>>
+reference_tokenize_command(const std::string &command) {
+  bool quote = false;
+  bool esc = false;
+  std::vector<std::string> tokens{};
+  std::string current_token = "";
+  for (auto c : command) {
+    if (esc) {
+      current_token += c;
+      esc = false;
+    } else if (c == '\\') {
+      esc = true;
+    } else if (c == '"') {
+      quote = !quote;
+    } else if (c == ' ') {
+      if (quote) {
+        current_token += c;
+      } else if (!current_token.empty()) {
+        tokens.push_back(current_token);
+        current_token.clear();
+      }
+    } else {
+      current_token += c;
+    }
+  }
+  if (!current_token.empty()) {
+    tokens.push_back(current_token);
+  }
+  if (quote || esc) {
+    return {};
+  }
+  return tokens;
+}
+
+bool same_token(const token_t &a, const token_t &b) {
+  if (a.type != b.type) {
+    return false;
+  }
+  switch (a.type) {
+  case token_type_t::val:
+    return a.val == b.val;
+  case token_type_t::op:
+    return std::strcmp(a.op.str, b.op.str) == 0 && a.op.prec == b.op.prec;
+  case token_type_t::var:
+    return std::strcmp(a.name, b.name) == 0;
+  default:
+    return true;
+  }
+}
+
+bool same_tokens(const std::vector<token_t> &a, const std::vector<token_t> &b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (!same_token(a[i], b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const char *const expression_corpus[] = {
+    "",
+    "   ",
+    "1 + 2 * 3",
+    "0x80000000 + 0b1010 - 0o777",
+    "0xDeadBeef & 0xff",
+    "0b2 + 0o9 + 0xg",
+    "a0 + sp * (t0 - 4)",
+    "pmem (sp + 8) == 0x1234",
+    "vmem pc >= 0x80000000",
+    "sbyte a0 + shalf a1 + sword a2",
+    "byte half word",
+    "bytes halfword pmem0 verylongname123",
+    "a0 << 2 >> 3 >>> 4",
+    "a0 <= 1 < 2 >= 3 > 4 == 5 != 6",
+    "!a0 && ~a1 || a2",
+    "-1 + +2 - -3",
+    "(((a0)))",
+    "a0 % 3 / 2 ^ 1 | 4 & 5",
+    "a0 = 1",
+    "A0 + 1",
+    "a_b",
+    "a0\t+\n1\r\v\f",
+    "18446744073709551615",
+    "12abc34 x9y8",
+};
+
+const char *const command_corpus[] = {
+    "",
+    "c",
+    "step 100",
+    "   break   0x80000000   if   a0 == 1  ",
+    "x pc 16 4 | less",
+    "eval \"a0 + 1\"",
+    "eval \"a0  +  1\" | \"grep 1\"",
+    "echo a\\ b\\\"c",
+    "unterminated \"quote",
+    "trailing escape \\",
+    "\"\" empty \"\" quotes",
+};
+
+// Random strings over the characters of both languages.
+std::string random_string(std::mt19937_64 &rng, const char *alphabet,
+                          size_t max_len) {
+  size_t alphabet_len = std::strlen(alphabet);
+  std::string s(rng() % (max_len + 1), ' ');
+  for (char &c : s) {
+    c = alphabet[rng() % alphabet_len];
+  }
+  return s;
+}
+
+template <typename F> double ns_per_call(const std::vector<std::string> &inputs,
+                                        size_t rounds, F f) {
+  size_t checksum = 0;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < rounds; ++r) {
+    for (const auto &input : inputs) {
+      checksum += f(input);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  if (checksum == SIZE_MAX) {
+    std::cout << std::endl;
+  }
+  double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+  return ns / (rounds * inputs.size());
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  constexpr size_t n_random = 100000;
+  const char *expression_alphabet = "0123456789abfowxhpsv()+-*/%<>=!~&^| \t";
+  const char *command_alphabet = "abc01 \"\\|";
+  std::mt19937_64 rng{42};
+
+  std::vector<std::string> expressions{std::begin(expression_corpus),
+                                       std::end(expression_corpus)};
+  std::vector<std::string> commands{std::begin(command_corpus),
+                                    std::end(command_corpus)};
+  for (size_t i = 0; i < n_random; ++i) {
+    expressions.push_back(random_string(rng, expression_alphabet, 24));
+    commands.push_back(random_string(rng, command_alphabet, 24));
+  }
+
+  size_t failures = 0;
+  for (const auto &expr : expressions) {
+    std::vector<token_t> reference;
+    try {
+      reference = reference_tokenize_expression(expr);
+    } catch (const std::out_of_range &) {
+      // the reference throws on numbers too large, the lexer stops instead
+      auto tokens = libsdb::tokenize_expression(expr);
+      if (tokens.empty() || tokens.back().type != token_type_t::invalid) {
+        std::cerr << "Overflow not rejected: \"" << expr << "\"" << std::endl;
+        ++failures;
+      }
+      continue;
+    }
+    if (!same_tokens(reference, libsdb::tokenize_expression(expr))) {
+      std::cerr << "Expression tokens differ: \"" << expr << "\"" << std::endl;
+      ++failures;
+    }
+  }
+  for (const auto &cmd : commands) {
+    if (reference_tokenize_command(cmd) != libsdb::tokenize_command(cmd)) {
+      std::cerr << "Command tokens differ: \"" << cmd << "\"" << std::endl;
+      ++failures;
+    }
+  }
+  if (failures != 0) {
+    std::cerr << failures << " inputs tokenized differently." << std::endl;
+    return 1;
+  }
+  std::cout << expressions.size() + commands.size()
+            << " inputs tokenized identically." << std::endl;
+
+  // typical debugger input for timing, without the random strings
+  std::vector<std::string> timed_expressions{std::begin(expression_corpus) + 2,
+                                             std::end(expression_corpus) - 2};
+  std::vector<std::string> timed_commands{std::begin(command_corpus) + 1,
+                                          std::begin(command_corpus) + 8};
+
+  std::cout << std::setw(12) << "tokenizer" << std::setw(16) << "reference"
+            << std::setw(16) << "new" << "   (ns/call)" << std::endl;
+  double ref_expr = ns_per_call(timed_expressions, 200, [](auto &s) {
+    return reference_tokenize_expression(s).size();
+  });
+  double new_expr = ns_per_call(timed_expressions, 20000, [](auto &s) {
+    return libsdb::tokenize_expression(s).size();
+  });
+  double ref_cmd = ns_per_call(timed_commands, 20000, [](auto &s) {
+    return reference_tokenize_command(s).value_or(std::vector<std::string>{}).size();
+  });
+  double new_cmd = ns_per_call(timed_commands, 20000, [](auto &s) {
+    return libsdb::tokenize_command(s).value_or(std::vector<std::string>{}).size();
+  });
+  std::cout << std::fixed << std::setprecision(1) << std::setw(12)
+            << "expression" << std::setw(16) << ref_expr << std::setw(16)
+            << new_expr << std::endl;
+  std::cout << std::setw(12) << "command" << std::setw(16) << ref_cmd
+            << std::setw(16) << new_cmd << std::endl;
+  return 0;
+}
@@ -45,6 +45,7 @@ int main(int argc, char **argv) {
 
   libsdb::sdb<word_t> sdb{};
   sdb.cpu = &cpu;
+  sdb.symbols.load_elf_from_file(argv[1]); // 装载函数符号，用于 profile
 
   for (size_t i = 2; i < argc; ++i) {
     sdb.execute_command(argv[i]);
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <libcpu/cache.hh>
+#include <optional>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace libcpu {
+
+static std::optional<uint64_t> parse_number(const std::string &str,
+                                            bool suffix) {
+  if (str.empty() || str[0] < '0' || str[0] > '9') {
+    return {};
+  }
+  char *end = nullptr;
+  uint64_t value = std::strtoull(str.c_str(), &end, 0);
+  if (suffix && (*end == 'k' || *end == 'K')) {
+    value <<= 10;
+    ++end;
+  } else if (suffix && (*end == 'm' || *end == 'M')) {
+    value <<= 20;
+    ++end;
+  }
+  if (*end != '\0') {
+    return {};
+  }
+  return value;
+}
+
+std::optional<cache_config_t> cache_config_t::parse(const std::string &spec) {
+  std::vector<std::string> fields;
+  std::istringstream in{spec};
+  for (std::string field; std::getline(in, field, ':');) {
+    fields.push_back(field);
+  }
+  if (fields.size() < 3) {
+    return {};
+  }
+  auto size = parse_number(fields[0], true);
+  auto ways = parse_number(fields[1], false);
+  auto line = parse_number(fields[2], false);
+  if (!size.has_value() || !ways.has_value() || !line.has_value()) {
+    return {};
+  }
+  cache_config_t config;
+  config.size = size.value();
+  config.ways = ways.value();
+  config.line = line.value();
+  for (size_t i = 3; i < fields.size(); ++i) {
+    if (fields[i] == "lru") {
+      config.replacement = replacement_t::lru;
+    } else if (fields[i] == "plru") {
+      config.replacement = replacement_t::plru;
+    } else if (fields[i] == "random") {
+      config.replacement = replacement_t::random;
+    } else if (fields[i] == "wb" || fields[i] == "wt") {
+      config.write_back = fields[i] == "wb";
+    } else if (fields[i] == "wa" || fields[i] == "nwa") {
+      config.write_allocate = fields[i] == "wa";
+    } else {
+      return {};
+    }
+  }
+
+  // the number of sets must be a power of 2 for the index bits
+  if (config.ways == 0 || config.ways > 64 ||
+      !std::has_single_bit(config.line) || config.ways != ways.value() ||
+      config.line != line.value() ||
+      config.size % (uint64_t{config.ways} * config.line) != 0 ||
+      !std::has_single_bit(config.size / config.ways / config.line)) {
+    return {};
+  }
+  if (config.replacement == replacement_t::plru &&
+      !std::has_single_bit(config.ways)) {
+    return {};
+  }
+  return config;
+}
+
+std::string cache_config_t::to_string(void) const {
+  static const char *const policies[] = {"lru", "plru", "random"};
+  std::string result;
+  if (size % (1 << 20) == 0) {
+    result = std::to_string(size >> 20) + "m";
+  } else if (size % (1 << 10) == 0) {
+    result = std::to_string(size >> 10) + "k";
+  } else {
+    result = std::to_string(size);
+  }
+  result += ":" + std::to_string(ways) + ":" + std::to_string(line) + ":" +
+            policies[static_cast<size_t>(replacement)] +
+            (write_back ? ":wb" : ":wt") + (write_allocate ? ":wa" : ":nwa");
+  return result;
+}
+
+cache_model::cache_model(const cache_config_t &config)
+    : config(config), line_shift(std::countr_zero(config.line)),
+      set_mask(config.size / config.ways / config.line - 1),
+      ways(config.ways), tags((set_mask + 1) * ways, invalid),
+      dirty((set_mask + 1) * ways, 0) {
+  if (config.replacement == replacement_t::lru) {
+    state.resize(tags.size(), 0);
+  } else if (config.replacement == replacement_t::plru) {
+    state.resize(set_mask + 1, 0);
+  }
+}
+
+void cache_model::touch_plru(size_t set, size_t way) {
+  // node `n` has children `2n` and `2n+1`, its bit points to the half to
+  // replace next, so it is set to the half not accessed
+  uint64_t &bits = state[set];
+  size_t node = 1;
+  for (unsigned level = std::countr_zero(ways); level-- > 0;) {
+    size_t half = (way >> level) & 1;
+    bits = (bits & ~(uint64_t{1} << node)) | (uint64_t{!half} << node);
+    node = 2 * node + half;
+  }
+}
+
+size_t cache_model::victim(size_t base) {
+  uint64_t empty = match(base, invalid);
+  if (empty != 0) {
+    return base + std::countr_zero(empty);
+  }
+  switch (config.replacement) {
+  case replacement_t::lru:
+    return std::min_element(state.begin() + base,
+                            state.begin() + base + ways) -
+           state.begin();
+  case replacement_t::plru: {
+    uint64_t bits = state[base / ways];
+    size_t node = 1;
+    while (node < ways) {
+      node = 2 * node + ((bits >> node) & 1);
+    }
+    return base + node - ways;
+  }
+  default:
+    // xorshift64
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return base + rng % ways;
+  }
+}
+
+cache_model::result_t cache_model::miss(size_t base, uint64_t block,
+                                        bool write) {
+  if (write) {
+    ++stats.write_misses;
+  } else {
+    ++stats.read_misses;
+  }
+  if (write && !config.write_allocate) {
+    return {false, false, true, false, 0};
+  }
+  size_t line = victim(base);
+  result_t result{false, true, write && !config.write_back, false, 0};
+  if (tags[line] != invalid && dirty[line]) {
+    ++stats.writebacks;
+    result.writeback = true;
+    result.victim = tags[line] << line_shift;
+  }
+  tags[line] = block;
+  dirty[line] = write && config.write_back;
+  touch(base, line);
+  return result;
+}
+
+cache_hierarchy::reuse_t::reuse_t(const cache_config_t &config)
+    : line_shift(std::countr_zero(config.line)), last(1 << 16, {0, 0}) {}
+
+void cache_hierarchy::reuse_t::access(uint64_t addr) {
+  uint64_t block = addr >> line_shift;
+  entry_t &entry = last[(block ^ (block >> 16)) & (last.size() - 1)];
+  ++time;
+  if (entry.time != 0 && entry.block == block) {
+    uint64_t distance = time - entry.time;
+    ++histogram[std::min<size_t>(std::bit_width(distance) - 1,
+                                 n_buckets - 1)];
+  } else {
+    ++first;
+  }
+  entry = {block, time};
+}
+
+cache_hierarchy::cache_hierarchy(const cache_config_t &l1i,
+                                 const cache_config_t &l1d,
+                                 const std::optional<cache_config_t> &l2)
+    : l1i(l1i), l1d(l1d), ireuse(l1i), dreuse(l1d) {
+  if (l2.has_value()) {
+    this->l2.emplace(l2.value());
+  }
+}
+
+void cache_hierarchy::next_level(const cache_model::result_t &result,
+                                 uint64_t addr) {
+  auto request = [this](uint64_t addr, bool write) {
+    if (!l2.has_value()) {
+      ++(write ? mem_writes : mem_reads);
+      return;
+    }
+    cache_model::result_t l2_result = l2->access(addr, write);
+    mem_reads += l2_result.fill;
+    mem_writes += l2_result.write_through + l2_result.writeback;
+  };
+  if (result.writeback) {
+    request(result.victim, true);
+  }
+  if (result.fill) {
+    request(addr, false);
+  }
+  if (result.write_through) {
+    request(addr, true);
+  }
+}
+
+void cache_hierarchy::write_report(std::ostream &os) const {
+  os << std::dec << instructions << " instructions";
+  if (lost != 0) {
+    os << ", " << lost << " events lost";
+  }
+  os << std::endl << std::fixed << std::setprecision(2);
+  os << std::setw(6) << "cache" << std::setw(14) << "accesses"
+     << std::setw(12) << "misses" << std::setw(8) << "hit%" << std::setw(9)
+     << "MPKI" << std::setw(12) << "writebacks"
+     << "  config" << std::endl;
+  auto row = [&](const char *name, const cache_model &cache) {
+    const cache_model::stats_t &stats = cache.get_stats();
+    uint64_t accesses = stats.reads + stats.writes;
+    uint64_t misses = stats.read_misses + stats.write_misses;
+    os << std::setw(6) << name << std::setw(14) << accesses << std::setw(12)
+       << misses << std::setw(8)
+       << 100.0 * (accesses - misses) / std::max<uint64_t>(accesses, 1)
+       << std::setw(9)
+       << 1000.0 * misses / std::max<uint64_t>(instructions, 1)
+       << std::setw(12) << stats.writebacks << "  "
+       << cache.get_config().to_string() << std::endl;
+  };
+  row("L1I", l1i);
+  row("L1D", l1d);
+  if (l2.has_value()) {
+    row("L2", l2.value());
+  }
+  os << "memory: " << mem_reads << " line reads, " << mem_writes
+     << " writes" << std::endl;
+
+  // distances are in accesses to the same cache, so a fully associative LRU
+  // cache with as many lines as the upper bound of a bucket hits at least
+  // the cumulative share
+  os << std::setw(16) << "reuse distance" << std::setw(14) << "L1I"
+     << std::setw(8) << "cum%" << std::setw(14) << "L1D" << std::setw(8)
+     << "cum%" << std::endl;
+  uint64_t cum_i = 0;
+  uint64_t cum_d = 0;
+  for (size_t i = 0; i < n_buckets; ++i) {
+    if (ireuse.histogram[i] == 0 && dreuse.histogram[i] == 0) {
+      continue;
+    }
+    cum_i += ireuse.histogram[i];
+    cum_d += dreuse.histogram[i];
+    uint64_t low = uint64_t{1} << i;
+    std::string range = std::to_string(low);
+    if (i == n_buckets - 1) {
+      range += "+";
+    } else if (low != 1) {
+      range += "-" + std::to_string(2 * low - 1);
+    }
+    os << std::setw(16) << range << std::setw(14) << ireuse.histogram[i]
+       << std::setw(8) << 100.0 * cum_i / std::max<uint64_t>(ireuse.time, 1)
+       << std::setw(14) << dreuse.histogram[i] << std::setw(8)
+       << 100.0 * cum_d / std::max<uint64_t>(dreuse.time, 1) << std::endl;
+  }
+  os << std::setw(16) << "first use" << std::setw(14) << ireuse.first
+     << std::setw(8) << "" << std::setw(14) << dreuse.first << std::endl;
+  os << std::defaultfloat;
+}
+
+} // namespace libcpu
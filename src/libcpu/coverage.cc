@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <libcpu/coverage.hh>
+#include <optional>
+#include <vector>
+
+namespace libcpu {
+
+static constexpr char coverage_magic[8] = {'A', 'N', 'E', 'M',
+                                           'O', 'C', 'O', 'V'};
+
+size_t coverage_map::edges(void) const {
+  return map_size - std::count(bitmap.begin(), bitmap.end(), 0);
+}
+
+std::vector<uint64_t> coverage_map::get_blocks(void) const {
+  std::vector<uint64_t> result{blocks.begin(), blocks.end()};
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+void coverage_map::insert_block(uint64_t addr) { blocks.insert(addr); }
+
+size_t coverage_map::merge_bitmap(const uint8_t *other) {
+  // kept branch-free, so the compiler vectorizes it
+  size_t n_new = 0;
+  for (size_t i = 0; i < map_size; ++i) {
+    n_new += (bitmap[i] == 0) & (other[i] != 0);
+    bitmap[i] = std::max(bitmap[i], other[i]);
+  }
+  return n_new;
+}
+
+size_t coverage_map::merge(const coverage_map &other) {
+  size_t n_new = merge_bitmap(other.bitmap.data());
+  if (track_blocks) {
+    for (uint64_t addr : other.blocks) {
+      n_new += blocks.insert(addr).second;
+    }
+  }
+  return n_new;
+}
+
+std::optional<size_t> coverage_map::merge(const char *filename) {
+  std::ifstream in(filename, std::ios::binary);
+  char magic[sizeof(coverage_magic)];
+  uint64_t n = 0;
+  in.read(magic, sizeof(magic));
+  in.read(reinterpret_cast<char *>(&n), sizeof(n));
+  if (!in || std::memcmp(magic, coverage_magic, sizeof(magic)) != 0) {
+    return std::nullopt;
+  }
+  std::vector<uint8_t> other_bitmap(map_size);
+  in.read(reinterpret_cast<char *>(other_bitmap.data()), map_size);
+  std::vector<uint64_t> other_blocks;
+  if (track_blocks) {
+    // the count is checked by the read, not trusted for the allocation
+    uint64_t chunk = 1 << 16;
+    for (uint64_t done = 0; in && done < n; done += chunk) {
+      size_t k = std::min(chunk, n - done);
+      other_blocks.resize(done + k);
+      in.read(reinterpret_cast<char *>(other_blocks.data() + done),
+              k * sizeof(uint64_t));
+    }
+  }
+  if (!in) {
+    return std::nullopt;
+  }
+  size_t n_new = merge_bitmap(other_bitmap.data());
+  blocks.reserve(blocks.size() + other_blocks.size());
+  for (uint64_t addr : other_blocks) {
+    n_new += blocks.insert(addr).second;
+  }
+  return n_new;
+}
+
+bool coverage_map::save(const char *filename) const {
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) {
+    return false;
+  }
+  std::vector<uint64_t> sorted = get_blocks();
+  uint64_t n = sorted.size();
+  out.write(coverage_magic, sizeof(coverage_magic));
+  out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+  out.write(reinterpret_cast<const char *>(bitmap.data()), map_size);
+  out.write(reinterpret_cast<const char *>(sorted.data()),
+            n * sizeof(uint64_t));
+  return static_cast<bool>(out);
+}
+
+void coverage_map::clear(void) {
+  std::fill(bitmap.begin(), bitmap.end(), 0);
+  blocks.clear();
+}
+
+} // namespace libcpu
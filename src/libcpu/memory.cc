@@ -48,6 +48,9 @@ bool memory_view::write(uint64_t addr, libvio::width_t width, uint64_t value) {
     return false;
   }
 
+  if (journal != nullptr) {
+    journal->record(start_offset, w);
+  }
   for (size_t i = 0; i < w; i++) {
     mem_ptr[start_offset + i] = (value >> (i * 8)) & 0xFF;
   }
@@ -61,6 +64,35 @@ uint8_t *memory_view::host_addr(uint64_t addr) {
   return mem_ptr + (addr - base);
 }
 
+uint8_t *memory_view::host_addr(uint64_t addr, uint64_t len) {
+  if (addr < base || addr - base > size || len > size - (addr - base)) {
+    return nullptr;
+  }
+  return mem_ptr + (addr - base);
+}
+
+bool memory_view::read_burst(uint64_t addr, uint8_t *data, uint64_t len) {
+  const uint8_t *src = host_addr(addr, len);
+  if (src == nullptr) {
+    return false;
+  }
+  std::copy_n(src, len, data);
+  return true;
+}
+
+bool memory_view::write_burst(uint64_t addr, const uint8_t *data,
+                              uint64_t len) {
+  uint8_t *dst = host_addr(addr, len);
+  if (dst == nullptr) {
+    return false;
+  }
+  if (journal != nullptr && len != 0) {
+    journal->record(addr - base, len);
+  }
+  std::copy_n(data, len, dst);
+  return true;
+}
+
 void memory_view::save(const char *filename) const {
   std::ofstream out(filename, std::ios::binary);
   if (!out)
@@ -146,4 +178,46 @@ bool memory_view::out_of_bound(uint64_t addr, libvio::width_t width) const {
   return addr < base || up_addr > base + size;
 }
 
+memory_journal::memory_journal(memory_view &mem) : mem(mem) {
+  uint64_t n_pages = (mem.size + page_size - 1) >> page_shift;
+  saved.assign((n_pages + 63) / 64, 0);
+  mem.journal = this;
+}
+
+memory_journal::~memory_journal() { mem.journal = nullptr; }
+
+void memory_journal::save(uint64_t first, uint64_t last) {
+  for (uint64_t page = first; page <= last; ++page) {
+    if (test(page)) {
+      continue;
+    }
+    saved[page / 64] |= uint64_t(1) << (page % 64);
+    // the last page may be cut short by the end of the memory
+    uint64_t offset = page << page_shift;
+    uint64_t len = std::min(page_size, mem.size - offset);
+    page_t saved_page{offset, std::unique_ptr<uint8_t[]>{new uint8_t[len]}};
+    std::copy(mem.mem_ptr + offset, mem.mem_ptr + offset + len,
+              saved_page.data.get());
+    pages.push_back(std::move(saved_page));
+  }
+}
+
+std::vector<memory_journal::page_t> memory_journal::take(void) {
+  for (const page_t &page : pages) {
+    uint64_t n = page.offset >> page_shift;
+    saved[n / 64] &= ~(uint64_t(1) << (n % 64));
+  }
+  std::vector<page_t> taken;
+  taken.swap(pages);
+  return taken;
+}
+
+void memory_journal::undo(const std::vector<page_t> &pages) {
+  for (const page_t &page : pages) {
+    uint64_t len = std::min(page_size, mem.size - page.offset);
+    std::copy(page.data.get(), page.data.get() + len,
+              mem.mem_ptr + page.offset);
+  }
+}
+
 } // namespace libcpu
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <elf.h>
+#include <fstream>
+#include <libcpu/symbols.hh>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace libcpu {
+
+template <typename EHDR_T, typename SHDR_T, typename SYM_T>
+static inline void load_symbols_impl(std::vector<symbol_table::symbol_t> &out,
+                                     const uint8_t *src, size_t size) {
+  if (size < sizeof(EHDR_T)) {
+    return;
+  }
+  const EHDR_T *elf_header = (const EHDR_T *)(src);
+  size_t n_sections = elf_header->e_shnum;
+  if (elf_header->e_shoff > size ||
+      n_sections > (size - elf_header->e_shoff) / sizeof(SHDR_T)) {
+    return;
+  }
+  const SHDR_T *sections = (const SHDR_T *)(src + elf_header->e_shoff);
+  // stripped binaries may still have the dynamic symbols
+  const SHDR_T *symtab = nullptr;
+  for (size_t i = 0; i < n_sections; ++i) {
+    if (sections[i].sh_type == SHT_SYMTAB) {
+      symtab = &sections[i];
+      break;
+    }
+    if (sections[i].sh_type == SHT_DYNSYM) {
+      symtab = &sections[i];
+    }
+  }
+  if (symtab == nullptr || symtab->sh_link >= n_sections) {
+    return;
+  }
+  const SHDR_T &strtab = sections[symtab->sh_link];
+  if (symtab->sh_offset > size ||
+      symtab->sh_size > size - symtab->sh_offset ||
+      strtab.sh_offset > size || strtab.sh_size > size - strtab.sh_offset) {
+    return;
+  }
+  const SYM_T *syms = (const SYM_T *)(src + symtab->sh_offset);
+  const char *names = (const char *)(src + strtab.sh_offset);
+  for (size_t i = 0; i < symtab->sh_size / sizeof(SYM_T); ++i) {
+    const SYM_T &sym = syms[i];
+    unsigned type = ELF64_ST_TYPE(sym.st_info);
+    // local untyped symbols are labels inside functions, e.g. loop heads
+    bool label = type == STT_NOTYPE && ELF64_ST_BIND(sym.st_info) == STB_LOCAL;
+    if ((type != STT_FUNC && type != STT_NOTYPE) || label ||
+        sym.st_shndx == SHN_UNDEF || sym.st_shndx >= n_sections ||
+        !(sections[sym.st_shndx].sh_flags & SHF_EXECINSTR) ||
+        sym.st_name >= strtab.sh_size) {
+      continue;
+    }
+    const char *name = names + sym.st_name;
+    size_t len = strnlen(name, strtab.sh_size - sym.st_name);
+    // skip mapping symbols like `$x` and assembler local labels
+    if (len == 0 || name[0] == '$' || (name[0] == '.' && name[1] == 'L')) {
+      continue;
+    }
+    out.push_back({sym.st_value, sym.st_size, std::string{name, len}});
+  }
+}
+
+size_t symbol_table::load_elf(const uint8_t *buffer, size_t size) {
+  if (size < EI_NIDENT) {
+    return 0;
+  }
+  size_t old_size = symbols.size();
+  if (buffer[4] == ELFCLASS32) {
+    load_symbols_impl<Elf32_Ehdr, Elf32_Shdr, Elf32_Sym>(symbols, buffer,
+                                                         size);
+  } else if (buffer[4] == ELFCLASS64) {
+    load_symbols_impl<Elf64_Ehdr, Elf64_Shdr, Elf64_Sym>(symbols, buffer,
+                                                         size);
+  }
+  size_t n_loaded = symbols.size() - old_size;
+  // aliases share an address, keep the one with a known size
+  std::stable_sort(symbols.begin(), symbols.end(),
+                   [](const symbol_t &a, const symbol_t &b) {
+                     return a.addr < b.addr ||
+                            (a.addr == b.addr && a.size > b.size);
+                   });
+  auto last = std::unique(
+      symbols.begin(), symbols.end(),
+      [](const symbol_t &a, const symbol_t &b) { return a.addr == b.addr; });
+  symbols.erase(last, symbols.end());
+  return n_loaded;
+}
+
+size_t symbol_table::load_elf_from_file(const char *filename) {
+  std::ifstream file(filename, std::ios::binary | std::ios::ate);
+  if (!file) {
+    return 0;
+  }
+  const auto file_size = file.tellg();
+  file.seekg(0);
+  std::unique_ptr<uint8_t[]> buffer(new uint8_t[file_size]);
+  file.read(reinterpret_cast<char *>(buffer.get()), file_size);
+  return load_elf(buffer.get(), file_size);
+}
+
+void symbol_table::insert(uint64_t addr, uint64_t size, std::string name) {
+  auto pos = std::upper_bound(
+      symbols.begin(), symbols.end(), addr,
+      [](uint64_t addr, const symbol_t &sym) { return addr < sym.addr; });
+  symbols.insert(pos, {addr, size, std::move(name)});
+}
+
+const symbol_table::symbol_t *symbol_table::lookup(uint64_t addr) const {
+  auto pos = std::upper_bound(
+      symbols.begin(), symbols.end(), addr,
+      [](uint64_t addr, const symbol_t &sym) { return addr < sym.addr; });
+  if (pos == symbols.begin()) {
+    return nullptr;
+  }
+  const symbol_t &sym = *(pos - 1);
+  if (sym.size != 0 && addr - sym.addr >= sym.size) {
+    return nullptr;
+  }
+  return &sym;
+}
+
+std::string symbol_table::name(uint64_t addr) const {
+  std::ostringstream os;
+  const symbol_t *sym = lookup(addr);
+  if (sym == nullptr) {
+    os << "0x" << std::hex << addr;
+  } else if (sym->addr == addr) {
+    os << sym->name;
+  } else {
+    os << sym->name << "+0x" << std::hex << addr - sym->addr;
+  }
+  return os.str();
+}
+
+} // namespace libcpu
@@ -6,6 +6,7 @@
 #include <memory>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #ifdef _WIN32
@@ -15,45 +16,51 @@
 
 namespace libsdb {
 
-std::optional<std::vector<std::string>> tokenize_command(std::string command) {
+std::optional<std::vector<std::string>>
+tokenize_command(const std::string &command) {
   bool quote = false;                // Flag for inside quoted section
-  bool esc = false;                  // Flag for escape character mode
   std::vector<std::string> tokens{}; // Result token storage
   std::string current_token = "";    // Current token being built
-  for (auto c : command) {           // Process each character
-    if (esc) {
-      // Escape mode: add character literally and reset escape flag
-      current_token += c;
-      esc = false;
-    } else {
-      if (c == '\\') {
-        // Start escape sequence (next character will be literal)
-        esc = true;
-      } else if (c == '"') {
-        // Toggle quoting mode (don't add quote to token)
-        quote = !quote;
-      } else if (c == ' ') {
-        if (quote) {
-          // In quotes: preserve space as part of token
-          current_token += c;
-        } else if (!current_token.empty()) {
-          // Outside quotes: finalize current token
-          tokens.push_back(current_token);
-          current_token.clear(); // Reset for next token
-        }
-      } else {
-        // Regular character: add to current token
-        current_token += c;
+  const char *p = command.data();
+  const char *end = p + command.size();
+  tokens.reserve(4); // Most commands have a few arguments
+  while (p < end) {
+    // Copy a run of regular characters at once
+    const char *run = p;
+    while (p < end && *p != '\\' && *p != '"' && *p != ' ') {
+      ++p;
+    }
+    current_token.append(run, p);
+    if (p == end) {
+      break;
+    }
+
+    char c = *p++;
+    if (c == '\\') {
+      // Escape: add next character literally, a trailing escape is an error
+      if (p == end) {
+        return {};
       }
+      current_token += *p++;
+    } else if (c == '"') {
+      // Toggle quoting mode (don't add quote to token)
+      quote = !quote;
+    } else if (quote) {
+      // In quotes: preserve space as part of token
+      current_token += c;
+    } else if (!current_token.empty()) {
+      // Outside quotes: finalize current token
+      tokens.push_back(std::move(current_token));
+      current_token.clear(); // Reset for next token
     }
   }
   // Add any remaining token content after processing all characters
   if (!current_token.empty()) {
-    tokens.push_back(current_token);
+    tokens.push_back(std::move(current_token));
   }
 
-  // unclosed quote or trailing escape is an error
-  if (quote || esc) {
+  // unclosed quote is an error
+  if (quote) {
     return {};
   } else {
     return tokens;
@@ -130,10 +137,46 @@ popen_ostream::popen_ostream(const std::string &command)
   rdbuf(buffer.get()); // Set the underlying buffer
 }
 
-popen_ostream &operator>>(std::ostream &os, const std::string &command) {
+popen_ostream::popen_ostream(popen_ostream &&other)
+    : std::ostream(std::move(other)), buffer(std::move(other.buffer)) {
+  rdbuf(buffer.get()); // The moved stream does not take the buffer
+}
+
+popen_ostream operator>>(std::ostream &os, const std::string &command) {
   // Ignore input stream, create new stream with the command
-  static popen_ostream popen_stream(command);
-  return popen_stream;
+  return popen_ostream{command};
+}
+
+batch_output_buffer::batch_output_buffer(std::streambuf *target)
+    : buffer(new char[buffer_size]), target(target) {
+  setp(buffer.get(), buffer.get() + buffer_size);
+}
+
+batch_output_buffer::~batch_output_buffer() { drain(); }
+
+int batch_output_buffer::drain(void) {
+  std::streamsize size = pptr() - pbase();
+  if (size > 0 && target->sputn(pbase(), size) != size) {
+    return -1;
+  }
+  pbump(-static_cast<int>(size));
+  return target->pubsync();
+}
+
+int batch_output_buffer::sync() {
+  // Flushes are deferred until the buffer is full or drained
+  return 0;
+}
+
+batch_output_buffer::int_type batch_output_buffer::overflow(int_type ch) {
+  if (drain() != 0) {
+    return traits_type::eof();
+  }
+  if (ch != traits_type::eof()) {
+    *pptr() = ch;
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
 }
 
 } // namespace libsdb
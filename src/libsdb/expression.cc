@@ -1,101 +1,160 @@
+#include <algorithm>
+#include <cctype>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <libcpu/abstract_cpu.hh>
 #include <libsdb/expression.hh>
 #include <optional>
-#include <regex>
 #include <vector>
 
 namespace libsdb {
 
-struct tokenizer_rule_t {
-  std::regex regex;
-  token_type_t type;
-  uint8_t precedence;
-  uint8_t base;
-};
-
 static constexpr uint8_t max_prec = 8;
-static const tokenizer_rule_t rules[] = {
-    {std::regex("\\s+"), token_type_t::space, 0, 0},
-    {std::regex("0b[01]+"), token_type_t::val, 0, 2},
-    {std::regex("0o[0-7]+"), token_type_t::val, 0, 8},
-    {std::regex("0x[0-9a-fA-F]+"), token_type_t::val, 0, 16},
-    {std::regex("[0-9]+"), token_type_t::val, 0, 10},
-    {std::regex("byte|half|word|sbyte|shalf|sword|pmem|vmem"), token_type_t::op,
-     8, 0},
-    {std::regex("<<|>>|>>>"), token_type_t::op, 5, 0},
-    {std::regex(">=|<=|>|<|==|!="), token_type_t::op, 4, 0},
-    {std::regex("[*/%]"), token_type_t::op, 7, 0},
-    {std::regex("[+-]"), token_type_t::op, 6, 0},
-    {std::regex("&"), token_type_t::op, 3, 0},
-    {std::regex("\\^"), token_type_t::op, 2, 0},
-    {std::regex("\\|"), token_type_t::op, 1, 0},
-    {std::regex("[~!]"), token_type_t::op, 8, 0},
-    {std::regex("\\("), token_type_t::parl, 0, 0},
-    {std::regex("\\)"), token_type_t::parr, 0, 0},
-    {std::regex("[a-z]+[0-9]*"), token_type_t::var, 0, 0}};
 
-std::vector<token_t> tokenize_expression(const std::string &expr) {
-  std::vector<token_t> tokens;
+// unary operators spelled as words, matched before variable names
+static const char *const word_operators[] = {
+    "byte", "half", "word", "sbyte", "shalf", "sword", "pmem", "vmem"};
 
-  std::string s = expr;
-  std::smatch m;
+static bool is_digit_of(char c, unsigned base) {
+  if (c >= '0' && c <= '9') {
+    return static_cast<unsigned>(c - '0') < base;
+  }
+  if (base == 16) {
+    return (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+  }
+  return false;
+}
 
-  while (!s.empty()) {
-    bool matched = false;
-    for (const auto &rule : rules) {
-      if (std::regex_search(s, m, rule.regex,
-                            std::regex_constants::match_continuous)) {
-        std::string token_str = m.str(0);
-        matched = true;
+static unsigned digit_value(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else {
+    return c - 'A' + 10;
+  }
+}
 
-        if (rule.type == token_type_t::space) {
-          s = s.substr(token_str.length());
-          break;
-        }
+static token_t make_op(const char *str, size_t len, uint8_t prec) {
+  token_t token;
+  token.type = token_type_t::op;
+  std::memset(token.op.str, 0, sizeof(token.op.str));
+  std::memcpy(token.op.str, str, len);
+  token.op.prec = prec;
+  return token;
+}
 
-        token_t token;
-        switch (rule.type) {
-        case token_type_t::val: {
-          token.type = token_type_t::val;
-          std::string num_str = token_str;
-          if (rule.base != 10) {
-            num_str = num_str.substr(2);
-          }
-          token.val = std::stoull(num_str, nullptr, rule.base);
-          tokens.push_back(token);
-          break;
-        }
-        case token_type_t::op: {
-          token.type = token_type_t::op;
-          std::strncpy(token.op.str, token_str.c_str(), 6);
-          token.name[6] = 0;
-          token.op.prec = rule.precedence;
-          tokens.push_back(token);
-          break;
+std::vector<token_t> tokenize_expression(const std::string &expr) {
+  std::vector<token_t> tokens;
+  const char *p = expr.c_str();
+  const char *end = p + expr.size();
+
+  while (p < end) {
+    char c = *p;
+    if (std::isspace(static_cast<unsigned char>(c))) {
+      ++p;
+      continue;
+    }
+
+    // numbers, a prefix only counts if at least one digit follows it
+    if (c >= '0' && c <= '9') {
+      unsigned base = 10;
+      if (c == '0' && end - p >= 3) {
+        unsigned prefixed = p[1] == 'b'   ? 2
+                            : p[1] == 'o' ? 8
+                            : p[1] == 'x' ? 16
+                                          : 0;
+        if (prefixed != 0 && is_digit_of(p[2], prefixed)) {
+          base = prefixed;
+          p += 2;
         }
-        case token_type_t::var: {
-          token.type = token_type_t::var;
-          std::strncpy(token.name, token_str.c_str(), 7);
-          token.name[7] = 0;
-          tokens.push_back(token);
-          break;
+      }
+      uint64_t val = 0;
+      bool overflow = false;
+      for (; p < end && is_digit_of(*p, base); ++p) {
+        unsigned digit = digit_value(*p);
+        if (val > (UINT64_MAX - digit) / base) {
+          overflow = true;
         }
-        case token_type_t::parl:
-        case token_type_t::parr:
-          token.type = rule.type;
-          tokens.push_back(token);
-          break;
-        default:
+        val = val * base + digit;
+      }
+      if (overflow) {
+        tokens.push_back(token_t{token_type_t::invalid});
+        break;
+      }
+      token_t token;
+      token.type = token_type_t::val;
+      token.val = val;
+      tokens.push_back(token);
+      continue;
+    }
+
+    // word operators and variables
+    if (c >= 'a' && c <= 'z') {
+      bool is_op = false;
+      for (const char *word : word_operators) {
+        size_t len = std::strlen(word);
+        if (static_cast<size_t>(end - p) >= len &&
+            std::memcmp(p, word, len) == 0) {
+          tokens.push_back(make_op(word, len, max_prec));
+          p += len;
+          is_op = true;
           break;
         }
-        s = s.substr(token_str.length());
-        break;
       }
+      if (is_op) {
+        continue;
+      }
+      const char *begin = p;
+      while (p < end && *p >= 'a' && *p <= 'z') {
+        ++p;
+      }
+      while (p < end && *p >= '0' && *p <= '9') {
+        ++p;
+      }
+      token_t token;
+      token.type = token_type_t::var;
+      std::memset(token.name, 0, sizeof(token.name));
+      std::memcpy(token.name, begin, std::min<size_t>(p - begin, 7));
+      tokens.push_back(token);
+      continue;
     }
-    if (!matched) {
+
+    // symbols, longer operators first
+    char next = p + 1 < end ? p[1] : 0;
+    if ((c == '<' || c == '>') && next == c) {
+      tokens.push_back(make_op(p, 2, 5));
+      p += 2;
+    } else if ((c == '<' || c == '>' || c == '=' || c == '!') && next == '=') {
+      tokens.push_back(make_op(p, 2, 4));
+      p += 2;
+    } else if (c == '<' || c == '>') {
+      tokens.push_back(make_op(p, 1, 4));
+      ++p;
+    } else if (c == '*' || c == '/' || c == '%') {
+      tokens.push_back(make_op(p, 1, 7));
+      ++p;
+    } else if (c == '+' || c == '-') {
+      tokens.push_back(make_op(p, 1, 6));
+      ++p;
+    } else if (c == '&') {
+      tokens.push_back(make_op(p, 1, 3));
+      ++p;
+    } else if (c == '^') {
+      tokens.push_back(make_op(p, 1, 2));
+      ++p;
+    } else if (c == '|') {
+      tokens.push_back(make_op(p, 1, 1));
+      ++p;
+    } else if (c == '~' || c == '!') {
+      tokens.push_back(make_op(p, 1, max_prec));
+      ++p;
+    } else if (c == '(' || c == ')') {
+      tokens.push_back(
+          token_t{c == '(' ? token_type_t::parl : token_type_t::parr});
+      ++p;
+    } else {
       tokens.push_back(token_t{token_type_t::invalid});
       break;
     }
@@ -103,6 +162,55 @@ std::vector<token_t> tokenize_expression(const std::string &expr) {
   return tokens;
 }
 
+std::optional<expr_op_t> resolve_operator(const token_t &token) {
+  struct operator_def_t {
+    const char *str;
+    bool unary;
+    expr_op_t op;
+  };
+  static const operator_def_t operators[] = {
+      {"-", true, expr_op_t::neg},
+      {"+", true, expr_op_t::nop},
+      {"~", true, expr_op_t::bit_not},
+      {"!", true, expr_op_t::log_not},
+      {"byte", true, expr_op_t::zext_byte},
+      {"half", true, expr_op_t::zext_half},
+      {"word", true, expr_op_t::zext_word},
+      {"sbyte", true, expr_op_t::sext_byte},
+      {"shalf", true, expr_op_t::sext_half},
+      {"sword", true, expr_op_t::sext_word},
+      {"pmem", true, expr_op_t::pmem},
+      {"vmem", true, expr_op_t::vmem},
+      {"<<", false, expr_op_t::sll},
+      {">>", false, expr_op_t::sra},
+      {">>>", false, expr_op_t::srl},
+      {">=", false, expr_op_t::ge},
+      {"<=", false, expr_op_t::le},
+      {">", false, expr_op_t::gt},
+      {"<", false, expr_op_t::lt},
+      {"==", false, expr_op_t::eq},
+      {"!=", false, expr_op_t::ne},
+      {"*", false, expr_op_t::mul},
+      {"/", false, expr_op_t::div},
+      {"%", false, expr_op_t::rem},
+      {"+", false, expr_op_t::add},
+      {"-", false, expr_op_t::sub},
+      {"&", false, expr_op_t::bit_and},
+      {"^", false, expr_op_t::bit_xor},
+      {"|", false, expr_op_t::bit_or}};
+
+  if (token.type != token_type_t::op) {
+    return std::nullopt;
+  }
+  bool unary = token.op.prec == max_prec;
+  for (const auto &def : operators) {
+    if (def.unary == unary && strcmp(def.str, token.op.str) == 0) {
+      return def.op;
+    }
+  }
+  return std::nullopt;
+}
+
 std::optional<std::vector<token_t>>
 parse_expression(const std::vector<token_t> &expr) {
   auto is_numerical = [](token_t token) {
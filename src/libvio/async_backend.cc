@@ -0,0 +1,65 @@
+#include <cstddef>
+#include <cstdint>
+#include <libvio/async_backend.hh>
+#include <thread>
+
+namespace libvio {
+
+async_backend::~async_backend() { stop(); }
+
+void async_backend::submit(uint64_t req, uint64_t data) {
+  if (!worker.joinable()) {
+    stopping.store(false);
+    worker = std::thread{&async_backend::worker_loop, this};
+  }
+  // bounding the operations in flight keeps both queues from overflowing
+  while (in_flight() >= queue_size) {
+    std::this_thread::yield();
+    collect();
+  }
+  jobs.try_push({req, data, 0});
+  jobs.notify();
+  ++submitted;
+}
+
+size_t async_backend::in_flight(void) const { return submitted - completed; }
+
+void async_backend::stop(void) {
+  if (!worker.joinable()) {
+    return;
+  }
+  stopping.store(true);
+  jobs.notify();
+  worker.join();
+}
+
+void async_backend::collect(void) {
+  job_t job;
+  while (completions.try_pop(job)) {
+    ++completed;
+    complete(job);
+  }
+}
+
+void async_backend::worker_loop(void) {
+  while (true) {
+    // take the epoch first, so that no notification is missed
+    uint32_t epoch = jobs.epoch();
+    bool stop = stopping.load();
+    job_t job;
+    while (jobs.try_pop(job)) {
+      job.result = execute(job.req, job.data);
+      // never full, as submit() bounds the operations in flight
+      completions.try_push(job);
+      if (completion_signal != nullptr) {
+        completion_signal->fetch_add(1, std::memory_order_release);
+      }
+    }
+    if (stop) {
+      return;
+    }
+    jobs.wait(epoch);
+  }
+}
+
+} // namespace libvio
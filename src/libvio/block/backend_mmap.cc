@@ -0,0 +1,178 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
+#include <libvio/async_backend.hh>
+#include <libvio/block.hh>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace libvio {
+
+// update the lower and/or higher 32 bits of a 64-bit register
+static inline void put_halves(uint64_t &field, uint64_t req, uint64_t req_l,
+                              uint64_t req_h, uint64_t data) {
+  if ((req & req_l) && (req & req_h)) {
+    field = data;
+  } else if (req & req_l) {
+    field = (field & 0xffffffff00000000) | (data & 0x00000000ffffffff);
+  } else if (req & req_h) {
+    field = (data << 32) | (field & 0x00000000ffffffff);
+  }
+}
+
+// get the lower and/or higher 32 bits of a 64-bit register
+static inline uint64_t get_halves(uint64_t field, uint64_t req, uint64_t req_l,
+                                  uint64_t req_h) {
+  if ((req & req_l) && (req & req_h)) {
+    return field;
+  } else if (req & req_l) {
+    return field & 0x00000000ffffffff;
+  } else {
+    return field >> 32;
+  }
+}
+
+block_backend_mmap::block_backend_mmap(const char *filename,
+                                       bool copy_on_write)
+    : copy_on_write(copy_on_write) {
+  int fd = open(filename, copy_on_write ? O_RDONLY : O_RDWR);
+  if (fd < 0) {
+    std::cerr << "libvio: Failed to open disk image " << filename << std::endl;
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    // a private mapping can be written even if the file is read-only
+    void *ptr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE,
+                     copy_on_write ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED) {
+      image = static_cast<uint8_t *>(ptr);
+      image_size = st.st_size;
+    } else {
+      std::cerr << "libvio: Failed to map disk image " << filename
+                << std::endl;
+    }
+  }
+  // the mapping stays valid after the file is closed
+  close(fd);
+}
+
+block_backend_mmap::~block_backend_mmap() {
+  // the worker must not touch the image after it is unmapped
+  stop();
+  if (image != nullptr) {
+    munmap(image, image_size);
+  }
+}
+
+bool block_backend_mmap::irq_pending(void) const {
+  return status & block_status_irq;
+}
+
+uint64_t block_backend_mmap::execute(uint64_t req, uint64_t data) {
+  auto transfer = reinterpret_cast<transfer_t *>(data);
+  if (!transfer->ok) {
+    return 0;
+  }
+  if (req == block_cmd_flush) {
+    return copy_on_write || image == nullptr ||
+           msync(image, image_size, MS_SYNC) == 0;
+  }
+  uint8_t *disk = image + transfer->sector * block_sector_size;
+  if (req == block_cmd_read) {
+    std::copy(disk, disk + transfer->buffer.size(), transfer->buffer.begin());
+  } else {
+    std::copy(transfer->buffer.begin(), transfer->buffer.end(), disk);
+  }
+  return 1;
+}
+
+void block_backend_mmap::complete(const job_t &job) {
+  // the worker finishes the commands in order
+  std::unique_ptr<transfer_t> transfer = std::move(transfers.front());
+  transfers.pop_front();
+  bool ok = job.result != 0;
+  if (ok && job.req == block_cmd_read) {
+    const auto &buffer = transfer->buffer;
+    ok = dma != nullptr &&
+         dma->dma_write(transfer->dma_addr, buffer.data(), buffer.size());
+  }
+  if (!ok) {
+    status |= block_status_error;
+  }
+  if (transfers.empty()) {
+    status |= block_status_done | block_status_irq;
+  }
+}
+
+uint64_t block_backend_mmap::request(uint64_t req) {
+  if (req & (reqval::block_sector_l | reqval::block_sector_h)) {
+    return get_halves(sector, req, reqval::block_sector_l,
+                      reqval::block_sector_h);
+  }
+  if (req & (reqval::block_dma_l | reqval::block_dma_h)) {
+    return get_halves(dma_addr, req, reqval::block_dma_l, reqval::block_dma_h);
+  }
+  if (req & (reqval::block_capacity_l | reqval::block_capacity_h)) {
+    return get_halves(image_size / block_sector_size, req,
+                      reqval::block_capacity_l, reqval::block_capacity_h);
+  }
+  if (req == reqval::block_count) {
+    return count;
+  }
+  if (req == reqval::block_status) {
+    return status;
+  }
+  return 0;
+}
+
+void block_backend_mmap::put(uint64_t req, uint64_t data) {
+  if (req & (reqval::block_sector_l | reqval::block_sector_h)) {
+    put_halves(sector, req, reqval::block_sector_l, reqval::block_sector_h,
+               data);
+  } else if (req & (reqval::block_dma_l | reqval::block_dma_h)) {
+    put_halves(dma_addr, req, reqval::block_dma_l, reqval::block_dma_h, data);
+  } else if (req == reqval::block_count) {
+    count = data & 0x00000000ffffffff;
+  } else if (req == reqval::block_command) {
+    status &= ~(block_status_done | block_status_error);
+    auto transfer =
+        std::make_unique<transfer_t>(transfer_t{sector, dma_addr, {}, true});
+    uint64_t capacity = image_size / block_sector_size;
+    if (data == block_cmd_read || data == block_cmd_write) {
+      transfer->ok = sector <= capacity && count <= capacity - sector;
+    } else {
+      transfer->ok = data == block_cmd_flush;
+    }
+    if (transfer->ok && data != block_cmd_flush) {
+      transfer->buffer.resize(count * block_sector_size);
+    }
+    // the sectors to write are taken from the memory as the command is issued
+    if (transfer->ok && data == block_cmd_write) {
+      auto &buffer = transfer->buffer;
+      transfer->ok = dma != nullptr &&
+                     dma->dma_read(dma_addr, buffer.data(), buffer.size());
+    }
+    // queued first, so a completion collected by submit() sees it in flight
+    uint64_t job_data = reinterpret_cast<uint64_t>(transfer.get());
+    transfers.push_back(std::move(transfer));
+    submit(data, job_data);
+  } else if (req == reqval::block_irq_ack) {
+    status &= ~block_status_irq;
+  }
+}
+
+bool block_backend_mmap::poll(uint64_t req) { return true; }
+
+bool block_backend_mmap::check(uint64_t req) {
+  if (req == reqval::block_status) {
+    return irq_pending();
+  }
+  return true;
+}
+
+} // namespace libvio
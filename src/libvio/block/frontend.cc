@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <libvio/block.hh>
+#include <libvio/frontend.hh>
+#include <libvio/regmap.hh>
+
+namespace libvio {
+
+static constexpr uint64_t sector_hl =
+    reqval::block_sector_h | reqval::block_sector_l;
+static constexpr uint64_t dma_hl = reqval::block_dma_h | reqval::block_dma_l;
+static constexpr uint64_t capacity_hl =
+    reqval::block_capacity_h | reqval::block_capacity_l;
+
+static constexpr register_map<40> block_registers{{
+    // 64-bit registers
+    {0x00, width_t::dword, reg_access_t::read_write,
+     {ioreq_type_t::read, sector_hl}, {ioreq_type_t::write, sector_hl}},
+    {0x08, width_t::dword, reg_access_t::read_write,
+     {ioreq_type_t::read, dma_hl}, {ioreq_type_t::write, dma_hl}},
+    {0x20, width_t::dword, reg_access_t::read_only,
+     {ioreq_type_t::read, capacity_hl}, {ioreq_type_t::invalid, 0}},
+    // 32-bit halves of 64-bit registers
+    {0x00, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::block_sector_l},
+     {ioreq_type_t::write, reqval::block_sector_l}},
+    {0x04, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::block_sector_h},
+     {ioreq_type_t::write, reqval::block_sector_h}},
+    {0x08, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::block_dma_l},
+     {ioreq_type_t::write, reqval::block_dma_l}},
+    {0x0c, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::block_dma_h},
+     {ioreq_type_t::write, reqval::block_dma_h}},
+    {0x20, width_t::word, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::block_capacity_l},
+     {ioreq_type_t::invalid, 0}},
+    {0x24, width_t::word, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::block_capacity_h},
+     {ioreq_type_t::invalid, 0}},
+    // 32-bit registers
+    {0x10, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::block_count},
+     {ioreq_type_t::write, reqval::block_count}},
+    {0x14, width_t::word, reg_access_t::write_only,
+     {ioreq_type_t::invalid, 0}, {ioreq_type_t::write, reqval::block_command}},
+    {0x18, width_t::word, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::block_status}, {ioreq_type_t::invalid, 0}},
+    {0x1c, width_t::word, reg_access_t::write_only,
+     {ioreq_type_t::invalid, 0}, {ioreq_type_t::write, reqval::block_irq_ack}},
+}};
+
+ioreq_t block_frontend::resolve_read(uint64_t offset, width_t width) const {
+  return block_registers.resolve_read(offset, width);
+}
+
+ioreq_t block_frontend::resolve_write(uint64_t offset, width_t width,
+                                      uint64_t data) const {
+  return block_registers.resolve_write(offset, width);
+}
+
+bool block_frontend::irq_level(void) const {
+  return backend->check(reqval::block_status);
+}
+
+uint64_t block_frontend::ioctl_get(uint64_t req) { return 0; }
+
+void block_frontend::ioctl_set(uint64_t req, uint64_t value) { return; }
+
+} // namespace libvio
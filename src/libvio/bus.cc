@@ -1,7 +1,9 @@
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <libvio/bus.hh>
+#include <libvio/phase.hh>
 #include <string>
 
 namespace libvio {
@@ -13,14 +15,183 @@ mmio_device_def::mmio_device_def(io_frontend *frontend, io_backend *backend,
   this->frontend->backend = this->backend.get();
 }
 
+// host banks are accessed in little-endian byte order like the guest memory
+static inline uint64_t host_load(const uint8_t *ptr, width_t width) {
+  uint64_t value = 0;
+  for (size_t i = 0; i < static_cast<size_t>(width); ++i) {
+    value |= static_cast<uint64_t>(ptr[i]) << (i * 8);
+  }
+  return value;
+}
+
+static inline void host_store(uint8_t *ptr, width_t width, uint64_t value) {
+  for (size_t i = 0; i < static_cast<size_t>(width); ++i) {
+    ptr[i] = (value >> (i * 8)) & 0xff;
+  }
+}
+
+// mark the blocks of a host bank touched by a write in its dirty bitmap
+static inline void mark_dirty(uint64_t *dirty_map, unsigned dirty_shift,
+                              uint64_t offset, uint64_t len) {
+  if (dirty_map == nullptr || len == 0) {
+    return;
+  }
+  uint64_t first = offset >> dirty_shift;
+  uint64_t last = (offset + len - 1) >> dirty_shift;
+  for (uint64_t block = first; block <= last; ++block) {
+    dirty_map[block / 64] |= uint64_t(1) << (block % 64);
+  }
+}
+
 using io_device = std::tuple<io_frontend *, io_backend *, uint64_t, uint64_t>;
 io_dispatcher::io_dispatcher(std::initializer_list<io_device> device_list,
                              size_t buffer_size)
-    : read_request_buffer(buffer_size), write_request_buffer(buffer_size) {
+    : read_request_buffer(buffer_size), write_request_buffer(buffer_size),
+      read_burst_buffer(buffer_size), write_burst_buffer(buffer_size),
+      irq_history(buffer_size), dma_history(buffer_size) {
   devices.reserve(device_list.size());
   for (auto [front, back, addr, size] : device_list) {
     devices.emplace_back(mmio_device_def{front, back, addr, size});
+    if (back != nullptr) {
+      back->completion_signal = &completion_signal;
+      back->dma = this;
+    }
   }
+  build_decode_table();
+}
+
+void io_dispatcher::add_device(io_frontend *frontend, io_backend *backend,
+                               uint64_t addr_begin, uint64_t byte_span,
+                               int irq_line) {
+  devices.emplace_back(
+      mmio_device_def{frontend, backend, addr_begin, byte_span});
+  if (backend != nullptr) {
+    backend->completion_signal = &completion_signal;
+    backend->dma = this;
+  }
+  devices.back().irq_line = irq_line;
+  if (irq_line >= 64) {
+    std::cerr << "libvio: Interrupt line " << irq_line << " out of range."
+              << std::endl;
+    devices.back().irq_line = -1;
+  } else if (irq_line >= static_cast<int>(irq_counts.size())) {
+    irq_counts.resize(irq_line + 1, 0);
+  }
+  build_decode_table();
+}
+
+void io_dispatcher::build_decode_table(void) {
+  decode_table.clear();
+  decode_table.reserve(devices.size());
+  for (auto &dev : devices) {
+    uint64_t dev_end = dev.addr_begin + dev.byte_span;
+    auto banks = dev.frontend->host_banks();
+    std::sort(banks.begin(), banks.end(),
+              [](const host_bank_t &a, const host_bank_t &b) {
+                return a.offset < b.offset;
+              });
+    // split the range of the device around its host banks
+    uint64_t addr = dev.addr_begin;
+    for (const auto &bank : banks) {
+      uint64_t bank_begin = dev.addr_begin + bank.offset;
+      uint64_t bank_end = std::min(bank_begin + bank.size, dev_end);
+      if (bank_begin < addr || bank_begin >= bank_end) {
+        std::cerr << "libvio: Invalid host bank at 0x" << std::hex
+                  << bank_begin << std::dec << std::endl;
+        continue;
+      }
+      if (addr < bank_begin) {
+        decode_table.push_back(
+            {addr, bank_begin, &dev, nullptr, nullptr, nullptr, 0});
+      }
+      // a bank mapped by an agent is served to the other agents from a copy
+      uint8_t *host_ptr = bank.host_ptr;
+      uint64_t *dirty_map = bank.dirty_map;
+      auto shadow = shadows.find(bank.host_ptr);
+      if (shadow != shadows.end()) {
+        host_ptr = shadow->second.get();
+        dirty_map = nullptr;
+      }
+      decode_table.push_back({bank_begin, bank_end, &dev, host_ptr,
+                              bank.host_ptr, dirty_map, bank.dirty_shift});
+      addr = bank_end;
+    }
+    if (addr < dev_end) {
+      decode_table.push_back(
+          {addr, dev_end, &dev, nullptr, nullptr, nullptr, 0});
+    }
+  }
+  // stable sort keeps the device listed first in front on equal addresses
+  std::stable_sort(decode_table.begin(), decode_table.end(),
+                   [](const decode_entry_t &a, const decode_entry_t &b) {
+                     return a.addr_begin < b.addr_begin;
+                   });
+  for (size_t i = 1; i < decode_table.size(); ++i) {
+    if (decode_table[i].addr_begin < decode_table[i - 1].addr_end) {
+      std::cerr << "libvio: Overlapping device address ranges at 0x"
+                << std::hex << decode_table[i].addr_begin << std::dec
+                << std::endl;
+    }
+  }
+
+  // build the page table if the address window of the devices is small enough
+  decode_pages.clear();
+  decode_page_base = 0;
+  if (decode_table.empty()) {
+    return;
+  }
+  uint64_t first_page = decode_table.front().addr_begin >> decode_page_shift;
+  uint64_t last_page = first_page;
+  for (const auto &entry : decode_table) {
+    last_page = std::max(last_page, (entry.addr_end - 1) >> decode_page_shift);
+  }
+  if (last_page - first_page >= decode_max_pages) {
+    return;
+  }
+  decode_page_base = first_page;
+  decode_pages.assign(last_page - first_page + 1, decode_no_entry);
+  // iterate backwards so that each page ends up with the first entry
+  for (size_t i = decode_table.size(); i-- > 0;) {
+    uint64_t begin = decode_table[i].addr_begin >> decode_page_shift;
+    uint64_t end = (decode_table[i].addr_end - 1) >> decode_page_shift;
+    for (uint64_t page = begin; page <= end; ++page) {
+      decode_pages[page - first_page] = i;
+    }
+  }
+}
+
+mmio_device_def *io_dispatcher::find_device(uint64_t addr) {
+  const decode_entry_t *entry = find_entry(addr);
+  return entry != nullptr ? entry->device : nullptr;
+}
+
+const io_dispatcher::decode_entry_t *io_dispatcher::find_entry(uint64_t addr) {
+  size_t index;
+  if (!decode_pages.empty()) {
+    uint64_t page = (addr >> decode_page_shift) - decode_page_base;
+    if (page >= decode_pages.size() || decode_pages[page] == decode_no_entry) {
+      return nullptr;
+    }
+    index = decode_pages[page];
+  } else {
+    // find the last range beginning at or before `addr`
+    auto it = std::upper_bound(
+        decode_table.begin(), decode_table.end(), addr,
+        [](uint64_t a, const decode_entry_t &e) { return a < e.addr_begin; });
+    if (it == decode_table.begin()) {
+      return nullptr;
+    }
+    index = it - decode_table.begin() - 1;
+  }
+  // only devices sharing a single page are scanned here
+  for (; index < decode_table.size() &&
+         decode_table[index].addr_begin <= addr;
+       ++index) {
+    if (addr < decode_table[index].addr_end) {
+      return &decode_table[index];
+    }
+  }
+  return nullptr;
 }
 
 std::optional<uint64_t>
@@ -47,11 +218,16 @@ io_dispatcher::request_read(uint64_t addr, width_t width, size_t req_no) {
     }
   } else if (req_no == read_request_buffer.lastindex()) {
     std::optional<uint64_t> req_data = {};
-    for (auto &dev : devices) {
-      if (addr >= dev.addr_begin && addr < dev.addr_begin + dev.byte_span) {
-        req_data = dev.frontend->read(addr - dev.addr_begin, width);
-        break;
-      }
+    const decode_entry_t *entry = find_entry(addr);
+    if (entry == nullptr) {
+      // unmapped address
+    } else if (entry->host_ptr != nullptr &&
+               addr + static_cast<uint64_t>(width) <= entry->addr_end) {
+      req_data = host_load(entry->host_ptr + (addr - entry->addr_begin), width);
+    } else {
+      mmio_device_def *dev = entry->device;
+      req_data = dev->frontend->read(addr - dev->addr_begin, width);
+      update_irq(*dev);
     }
     read_request_buffer.push_back({addr, width, req_data});
     return req_data;
@@ -84,11 +260,19 @@ bool io_dispatcher::request_write(uint64_t addr, width_t width, size_t req_no,
     }
   } else if (req_no == write_request_buffer.lastindex()) {
     bool result = false;
-    for (auto &dev : devices) {
-      if (addr >= dev.addr_begin && addr < dev.addr_begin + dev.byte_span) {
-        result = dev.frontend->write(addr - dev.addr_begin, width, data);
-        break;
-      }
+    const decode_entry_t *entry = find_entry(addr);
+    if (entry == nullptr) {
+      // unmapped address
+    } else if (entry->host_ptr != nullptr &&
+               addr + static_cast<uint64_t>(width) <= entry->addr_end) {
+      host_store(entry->host_ptr + (addr - entry->addr_begin), width, data);
+      mark_dirty(entry->dirty_map, entry->dirty_shift, addr - entry->addr_begin,
+                 static_cast<uint64_t>(width));
+      result = true;
+    } else {
+      mmio_device_def *dev = entry->device;
+      result = dev->frontend->write(addr - dev->addr_begin, width, data);
+      update_irq(*dev);
     }
     write_request_buffer.push_back({addr, width, data, result});
     return result;
@@ -98,18 +282,322 @@ bool io_dispatcher::request_write(uint64_t addr, width_t width, size_t req_no,
   }
 }
 
+bool io_dispatcher::request_read_burst(uint64_t addr, uint8_t *data,
+                                       size_t len, size_t req_no) {
+  if (req_no < read_burst_buffer.firstindex()) {
+    std::cerr << "libvio: Burst read buffer underflow." << std::endl;
+    return false;
+  } else if (req_no < read_burst_buffer.lastindex()) {
+    const auto &[cached_addr, cached_data, cached_result] =
+        read_burst_buffer[req_no];
+    if (cached_addr == addr && cached_data.size() == len) {
+      std::copy(cached_data.begin(), cached_data.end(), data);
+      return cached_result;
+    } else {
+      std::cerr << "libvio: Burst read request mismatch." << std::endl;
+      std::cerr << "Cached request: addr=" << std::hex << cached_addr
+                << ", len=" << std::dec << cached_data.size() << std::endl;
+      std::cerr << "New request: addr=" << std::hex << addr
+                << ", len=" << std::dec << len << std::endl;
+      return false;
+    }
+  } else if (req_no == read_burst_buffer.lastindex()) {
+    bool result = false;
+    const decode_entry_t *entry = find_entry(addr);
+    if (entry == nullptr) {
+      // unmapped address
+    } else if (entry->host_ptr != nullptr && addr + len <= entry->addr_end) {
+      std::copy_n(entry->host_ptr + (addr - entry->addr_begin), len, data);
+      result = true;
+    } else if (addr + len <=
+               entry->device->addr_begin + entry->device->byte_span) {
+      mmio_device_def *dev = entry->device;
+      result = dev->frontend->read_burst(addr - dev->addr_begin, data, len);
+      update_irq(*dev);
+    }
+    if (!result) {
+      std::fill_n(data, len, 0);
+    }
+    read_burst_buffer.push_back({addr, {data, data + len}, result});
+    return result;
+  } else {
+    std::cerr << "libvio: Burst read buffer overflow." << std::endl;
+    return false;
+  }
+}
+
+bool io_dispatcher::request_write_burst(uint64_t addr, const uint8_t *data,
+                                        size_t len, size_t req_no) {
+  if (req_no < write_burst_buffer.firstindex()) {
+    std::cerr << "libvio: Burst write buffer underflow." << std::endl;
+    return false;
+  } else if (req_no < write_burst_buffer.lastindex()) {
+    const auto &[cached_addr, cached_data, cached_result] =
+        write_burst_buffer[req_no];
+    if (cached_addr == addr && cached_data.size() == len &&
+        std::equal(cached_data.begin(), cached_data.end(), data)) {
+      return cached_result;
+    } else {
+      std::cerr << "libvio: Burst write request mismatch." << std::endl;
+      std::cerr << "Cached request: addr=" << std::hex << cached_addr
+                << ", len=" << std::dec << cached_data.size() << std::endl;
+      std::cerr << "New request: addr=" << std::hex << addr
+                << ", len=" << std::dec << len << std::endl;
+      return false;
+    }
+  } else if (req_no == write_burst_buffer.lastindex()) {
+    bool result = false;
+    const decode_entry_t *entry = find_entry(addr);
+    if (entry == nullptr) {
+      // unmapped address
+    } else if (entry->host_ptr != nullptr && addr + len <= entry->addr_end) {
+      std::copy_n(data, len, entry->host_ptr + (addr - entry->addr_begin));
+      mark_dirty(entry->dirty_map, entry->dirty_shift, addr - entry->addr_begin,
+                 len);
+      result = true;
+    } else if (addr + len <=
+               entry->device->addr_begin + entry->device->byte_span) {
+      mmio_device_def *dev = entry->device;
+      result = dev->frontend->write_burst(addr - dev->addr_begin, data, len);
+      update_irq(*dev);
+    }
+    write_burst_buffer.push_back({addr, {data, data + len}, result});
+    return result;
+  } else {
+    std::cerr << "libvio: Burst write buffer overflow." << std::endl;
+    return false;
+  }
+}
+
+uint64_t io_dispatcher::get_irq_lines(void) const { return irq_lines; }
+
+void io_dispatcher::set_irq_controller(irq_controller *controller) {
+  this->controller = controller;
+  controller_frontend = dynamic_cast<io_frontend *>(controller);
+  uint64_t lines = irq_sources;
+  if (controller != nullptr) {
+    controller->set_sources(irq_sources);
+    lines = controller->outputs();
+  }
+  set_irq_lines(lines);
+}
+
+void io_dispatcher::update_irq(mmio_device_def &dev) {
+  uint64_t sources = irq_sources;
+  if (dev.irq_line >= 0) {
+    bool level = dev.frontend->irq_level();
+    if (level != dev.irq_asserted) {
+      dev.irq_asserted = level;
+      uint32_t &count = irq_counts[dev.irq_line];
+      count += level ? 1 : -1;
+      if (count != 0) {
+        sources |= uint64_t(1) << dev.irq_line;
+      } else {
+        sources &= ~(uint64_t(1) << dev.irq_line);
+      }
+    }
+  }
+  // the outputs of a controller also change when its registers are accessed
+  bool controller_accessed = controller_frontend != nullptr &&
+                             dev.frontend.get() == controller_frontend;
+  if (sources == irq_sources && !controller_accessed) {
+    return;
+  }
+  if (controller == nullptr) {
+    irq_sources = sources;
+    set_irq_lines(sources);
+    return;
+  }
+  if (sources != irq_sources) {
+    irq_sources = sources;
+    controller->set_sources(sources);
+  }
+  set_irq_lines(controller->outputs());
+}
+
+void io_dispatcher::set_irq_lines(uint64_t lines) {
+  if (lines == irq_lines) {
+    return;
+  }
+  irq_lines = lines;
+  // the change is seen right after the request of the leading agent
+  irq_history.push_back({sequence == 0 ? 0 : sequence - 1, lines});
+}
+
+bool io_dispatcher::dma_read(uint64_t addr, uint8_t *data, size_t len) {
+  if (leader == nullptr || !leader->dma_read_handler) {
+    return false;
+  }
+  return leader->dma_read_handler(addr, data, len);
+}
+
+bool io_dispatcher::dma_write(uint64_t addr, const uint8_t *data,
+                              size_t len) {
+  if (leader == nullptr) {
+    return false;
+  }
+  // the write happens during the current request of the leading agent
+  dma_history.push_back(
+      {sequence - 1, addr, std::vector<uint8_t>(data, data + len)});
+  leader->dma_index = dma_history.lastindex();
+  return leader->dma_write_handler &&
+         leader->dma_write_handler(addr, data, len);
+}
+
+void io_dispatcher::begin_request(mmio_agent *agent) {
+  if (agent->sequence++ != sequence) {
+    // a lagging agent gets the DMA writes before the request, as the leading
+    // agent did
+    if (agent->dma_index < dma_history.firstindex()) {
+      std::cerr << "libvio: DMA buffer underflow." << std::endl;
+      agent->dma_index = dma_history.firstindex();
+    }
+    while (agent->dma_index < dma_history.lastindex()) {
+      const auto &[seq, addr, data] = dma_history[agent->dma_index];
+      if (seq >= agent->sequence) {
+        break;
+      }
+      ++agent->dma_index;
+      if (agent->dma_write_handler) {
+        agent->dma_write_handler(addr, data.data(), data.size());
+      }
+    }
+    return;
+  }
+  ++sequence;
+  leader = agent;
+  uint32_t signal = completion_signal.load(std::memory_order_acquire);
+  if (signal != collected_signal) {
+    collected_signal = signal;
+    for (auto &dev : devices) {
+      if (dev.backend != nullptr) {
+        dev.backend->collect();
+      }
+      update_irq(dev);
+    }
+  }
+}
+
+void io_dispatcher::end_request(mmio_agent *agent) {
+  if (agent->irq_index == irq_history.lastindex()) {
+    return;
+  }
+  if (agent->irq_index < irq_history.firstindex()) {
+    std::cerr << "libvio: Interrupt buffer underflow." << std::endl;
+    agent->irq_index = irq_history.firstindex();
+  }
+  while (agent->irq_index < irq_history.lastindex()) {
+    auto [seq, lines] = irq_history[agent->irq_index];
+    if (seq >= agent->sequence) {
+      break;
+    }
+    ++agent->irq_index;
+    if (agent->irq_handler) {
+      agent->irq_handler(lines);
+    }
+  }
+}
+
+std::vector<host_range_t> io_dispatcher::map_host_banks(mmio_agent *agent) {
+  if (agent->mapped) {
+    return agent->views;
+  }
+  agent->mapped = true;
+  for (auto &entry : decode_table) {
+    if (entry.bank_ptr == nullptr) {
+      continue;
+    }
+    uint64_t size = entry.addr_end - entry.addr_begin;
+    auto copy = std::make_unique<uint8_t[]>(size);
+    std::copy_n(entry.bank_ptr, size, copy.get());
+    if (entry.host_ptr == entry.bank_ptr) {
+      // the first agent gets the bank, so the device sees the stores of a CPU
+      agent->views.push_back({entry.addr_begin, entry.addr_end, entry.bank_ptr,
+                              entry.dirty_map, entry.dirty_shift});
+      entry.host_ptr = copy.get();
+      entry.dirty_map = nullptr;
+      shadows[entry.bank_ptr] = std::move(copy);
+    } else {
+      agent->views.push_back({entry.addr_begin, entry.addr_end, copy.get()});
+      agent->copies.push_back(std::move(copy));
+    }
+  }
+  return agent->views;
+}
+
 mmio_agent *io_dispatcher::new_agent(void) {
   agents.emplace_back(std::unique_ptr<mmio_agent>{new mmio_agent});
   agents.back()->dispatcher = this;
   return agents.back().get();
 }
 
+host_range_t *mmio_agent::find_view(uint64_t addr, uint64_t len) {
+  for (auto &view : views) {
+    if (view.contains(addr, len)) {
+      return &view;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<host_range_t> mmio_agent::host_ranges(void) {
+  return dispatcher->map_host_banks(this);
+}
+
 std::optional<uint64_t> mmio_agent::read(uint64_t addr, width_t width) {
-  return dispatcher->request_read(addr, width, read_count++);
+  LIBVIO_PHASE(mmio);
+  if (host_range_t *view = find_view(addr, static_cast<uint64_t>(width))) {
+    return view->load(addr, width);
+  }
+  dispatcher->begin_request(this);
+  auto result = dispatcher->request_read(addr, width, read_count++);
+  dispatcher->end_request(this);
+  return result;
 }
 
 bool mmio_agent::write(uint64_t addr, width_t width, uint64_t data) {
-  return dispatcher->request_write(addr, width, write_count++, data);
+  LIBVIO_PHASE(mmio);
+  if (host_range_t *view = find_view(addr, static_cast<uint64_t>(width))) {
+    view->store(addr, width, data);
+    return true;
+  }
+  dispatcher->begin_request(this);
+  bool result = dispatcher->request_write(addr, width, write_count++, data);
+  dispatcher->end_request(this);
+  return result;
+}
+
+bool mmio_agent::read_burst(uint64_t addr, uint8_t *data, size_t len) {
+  LIBVIO_PHASE(mmio);
+  if (host_range_t *view = find_view(addr, len)) {
+    std::copy_n(view->host_ptr + (addr - view->addr_begin), len, data);
+    return true;
+  }
+  dispatcher->begin_request(this);
+  bool result =
+      dispatcher->request_read_burst(addr, data, len, read_burst_count++);
+  dispatcher->end_request(this);
+  return result;
+}
+
+bool mmio_agent::write_burst(uint64_t addr, const uint8_t *data, size_t len) {
+  LIBVIO_PHASE(mmio);
+  if (host_range_t *view = find_view(addr, len)) {
+    std::copy_n(data, len, view->host_ptr + (addr - view->addr_begin));
+    view->mark_dirty(addr, len);
+    return true;
+  }
+  dispatcher->begin_request(this);
+  bool result =
+      dispatcher->request_write_burst(addr, data, len, write_burst_count++);
+  dispatcher->end_request(this);
+  return result;
+}
+
+void mmio_agent::poll_irq(void) {
+  LIBVIO_PHASE(mmio);
+  dispatcher->begin_request(this);
+  dispatcher->end_request(this);
 }
 
-} // namespace libvio
\ No newline at end of file
+} // namespace libvio
@@ -0,0 +1,104 @@
+#include <cstddef>
+#include <cstdint>
+#include <libvio/console.hh>
+#include <string>
+#include <thread>
+
+namespace libvio {
+
+console_backend_async::console_backend_async(std::istream &is,
+                                             std::ostream &os,
+                                             size_t threshold)
+    : console_backend_iostream(is, os), threshold(threshold) {
+  writer = std::thread{&console_backend_async::writer_loop, this};
+}
+
+console_backend_async::~console_backend_async() {
+  stopping.store(true);
+  queue.notify();
+  writer.join();
+}
+
+uint64_t console_backend_async::request(uint64_t req) {
+  // make prompts visible before waiting for input
+  if (!input_data.has_value()) {
+    sync();
+  }
+  return console_backend_iostream::request(req);
+}
+
+bool console_backend_async::poll(uint64_t req) {
+  if (!input_data.has_value()) {
+    sync();
+  }
+  return console_backend_iostream::poll(req);
+}
+
+void console_backend_async::put(uint64_t req, uint64_t data) {
+  if (req != reqval::console_tx) {
+    return;
+  }
+  char c = static_cast<char>(data);
+  unsynced = true;
+  while (!queue.try_push(c)) {
+    // the writer is behind, wake it up and let it catch up
+    queue.notify();
+    std::this_thread::yield();
+  }
+  // the writer only writes out full lines or full buffers, so waking it up
+  // for every character is a waste
+  if (c == '\n' || ++unnotified >= threshold) {
+    unnotified = 0;
+    queue.notify();
+  }
+}
+
+void console_backend_async::sync(void) {
+  if (!unsynced) {
+    return;
+  }
+  unsynced = false;
+  uint32_t target = sync_requested.fetch_add(1) + 1;
+  queue.notify();
+  uint32_t done = sync_done.load();
+  while (done != target) {
+    sync_done.wait(done);
+    done = sync_done.load();
+  }
+}
+
+void console_backend_async::writer_loop(void) {
+  std::string buffer;
+  buffer.reserve(threshold);
+  auto write_buffer = [&](void) {
+    ostream.write(buffer.data(), buffer.size());
+    ostream.flush();
+    buffer.clear();
+  };
+  while (true) {
+    // take the epoch first, so that no notification is missed
+    uint32_t epoch = queue.epoch();
+    uint32_t requested = sync_requested.load();
+    bool stop = stopping.load();
+    char c;
+    while (queue.try_pop(c)) {
+      buffer.push_back(c);
+      if (c == '\n' || buffer.size() >= threshold) {
+        write_buffer();
+      }
+    }
+    if (requested != sync_done.load() || stop) {
+      if (!buffer.empty()) {
+        write_buffer();
+      }
+      sync_done.store(requested);
+      sync_done.notify_all();
+    }
+    if (stop) {
+      return;
+    }
+    queue.wait(epoch);
+  }
+}
+
+} // namespace libvio
@@ -0,0 +1,51 @@
+#include <cstddef>
+#include <cstdint>
+#include <libvio/console.hh>
+
+namespace libvio {
+
+console_backend_buffered::console_backend_buffered(std::istream &is,
+                                                   std::ostream &os,
+                                                   size_t threshold)
+    : console_backend_iostream(is, os), threshold(threshold) {
+  buffer.reserve(threshold);
+}
+
+console_backend_buffered::~console_backend_buffered() { sync(); }
+
+uint64_t console_backend_buffered::request(uint64_t req) {
+  // make prompts visible before waiting for input
+  if (!input_data.has_value()) {
+    sync();
+  }
+  return console_backend_iostream::request(req);
+}
+
+bool console_backend_buffered::poll(uint64_t req) {
+  if (!input_data.has_value()) {
+    sync();
+  }
+  return console_backend_iostream::poll(req);
+}
+
+void console_backend_buffered::put(uint64_t req, uint64_t data) {
+  if (req != reqval::console_tx) {
+    return;
+  }
+  char c = static_cast<char>(data);
+  buffer.push_back(c);
+  if (c == '\n' || buffer.size() >= threshold) {
+    sync();
+  }
+}
+
+void console_backend_buffered::sync(void) {
+  if (buffer.empty()) {
+    return;
+  }
+  ostream.write(buffer.data(), buffer.size());
+  ostream.flush();
+  buffer.clear();
+}
+
+} // namespace libvio
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
+#include <libvio/console.hh>
+#include <poll.h>
+#include <thread>
+#include <unistd.h>
+
+namespace libvio {
+
+// interval of checking whether the reader should exit
+static constexpr std::chrono::milliseconds reader_tick{50};
+
+console_backend_nonblocking::console_backend_nonblocking(std::ostream &os,
+                                                         int fd)
+    : ostream(os), fd(fd), own_fd(false), rate(0) {
+  reader = std::thread{&console_backend_nonblocking::reader_loop, this};
+}
+
+console_backend_nonblocking::console_backend_nonblocking(std::ostream &os,
+                                                         const char *script,
+                                                         uint64_t rate)
+    : ostream(os), fd(open(script, O_RDONLY)), own_fd(true), rate(rate) {
+  if (fd < 0) {
+    std::cerr << "libvio: Failed to open input script " << script
+              << std::endl;
+  }
+  reader = std::thread{&console_backend_nonblocking::reader_loop, this};
+}
+
+console_backend_nonblocking::~console_backend_nonblocking() {
+  stopping.store(true);
+  reader.join();
+  if (own_fd && fd >= 0) {
+    close(fd);
+  }
+}
+
+uint64_t console_backend_nonblocking::request(uint64_t req) {
+  if (req != reqval::console_rx) {
+    return 0;
+  }
+  char c;
+  while (true) {
+    uint32_t epoch = queue.epoch();
+    if (queue.try_pop(c)) {
+      return static_cast<unsigned char>(c);
+    }
+    if (eof.load()) {
+      // the last characters are pushed before eof is set
+      if (queue.try_pop(c)) {
+        return static_cast<unsigned char>(c);
+      }
+      return static_cast<uint64_t>(-1);
+    }
+    queue.wait(epoch);
+  }
+}
+
+bool console_backend_nonblocking::poll(uint64_t req) { return check(req); }
+
+bool console_backend_nonblocking::check(uint64_t req) {
+  if (req != reqval::console_rx) {
+    return true;
+  }
+  return !queue.empty();
+}
+
+void console_backend_nonblocking::put(uint64_t req, uint64_t data) {
+  if (req == reqval::console_tx) {
+    ostream << static_cast<char>(data);
+  }
+}
+
+void console_backend_nonblocking::reader_loop(void) {
+  using clock = std::chrono::steady_clock;
+  auto next = clock::now();
+  char buffer[256];
+  while (fd >= 0 && !stopping.load()) {
+    // wait with a timeout, so that a blocked reader can still exit
+    pollfd pfd = {fd, POLLIN, 0};
+    int ready = ::poll(&pfd, 1, reader_tick.count());
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    } else if (ready <= 0) {
+      if (ready < 0) {
+        break;
+      }
+      continue;
+    }
+    // feed one character at a time when the rate is limited
+    ssize_t n = read(fd, buffer, rate == 0 ? sizeof(buffer) : 1);
+    if (n <= 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < n; ++i) {
+      while (!queue.try_push(buffer[i])) {
+        if (stopping.load()) {
+          return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+      }
+    }
+    queue.notify();
+    if (rate != 0) {
+      next += std::chrono::nanoseconds{1000000000 / rate};
+      for (auto now = clock::now(); now < next && !stopping.load();
+           now = clock::now()) {
+        std::this_thread::sleep_for(std::min<clock::duration>(
+            next - now, reader_tick));
+      }
+    }
+  }
+  eof.store(true);
+  queue.notify();
+}
+
+} // namespace libvio
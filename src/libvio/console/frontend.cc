@@ -1,36 +1,35 @@
 #include <cstdint>
 #include <libvio/console.hh>
 #include <libvio/frontend.hh>
+#include <libvio/regmap.hh>
 
 namespace libvio {
 
-ioreq_t console_frontend::resolve_read(uint64_t offset, width_t width) const {
-  if (offset == 0 && width == width_t::byte) {
-    // receiving
-    return {ioreq_type_t::read, reqval::console_rx};
-  } else if (offset == 1 && width == width_t::byte) {
+static constexpr register_map<8> console_registers{{
+    // receiving and sending
+    {0, width_t::byte, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::console_rx},
+     {ioreq_type_t::write, reqval::console_tx}},
     // querying device state
     // bit 0: output ready
     // bit 1: input valid
-    return {ioreq_type_t::ioctl_get, reqval::console_rx | reqval::console_tx};
-  } else {
-    return {ioreq_type_t::invalid, 0};
-  }
+    {1, width_t::byte, reg_access_t::read_only,
+     {ioreq_type_t::ioctl_get, reqval::console_rx | reqval::console_tx},
+     {}},
+    // trying to set prescaler
+    // ignore this
+    {2, width_t::half, reg_access_t::write_only,
+     {},
+     {ioreq_type_t::ioctl_set, reqval::console_prescaler}},
+}};
+
+ioreq_t console_frontend::resolve_read(uint64_t offset, width_t width) const {
+  return console_registers.resolve_read(offset, width);
 }
 
-ioreq_t console_frontend::resolve_write(size_t offset, width_t width,
+ioreq_t console_frontend::resolve_write(uint64_t offset, width_t width,
                                         uint64_t data) const {
-  if (offset == 0 && width == width_t::byte) {
-    // sending
-    return {ioreq_type_t::write, reqval::console_tx};
-  } else if (offset == 2 && width == width_t::half) {
-    // trying to set prescaler
-    // ignore this
-    return {ioreq_type_t::ioctl_set, reqval::console_prescaler};
-  } else {
-    return {ioreq_type_t::invalid, 0};
-    ;
-  }
+  return console_registers.resolve_write(offset, width);
 }
 
 uint64_t console_frontend::ioctl_get(uint64_t req) {
@@ -42,4 +41,4 @@ uint64_t console_frontend::ioctl_get(uint64_t req) {
 
 void console_frontend::ioctl_set(uint64_t req, uint64_t data) { return; }
 
-} // namespace libvio
\ No newline at end of file
+} // namespace libvio
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <libvio/framebuffer.hh>
+#include <vector>
+
+namespace libvio {
+
+framebuffer_backend::framebuffer_backend(uint32_t width, uint32_t height)
+    : width(width), height(height) {
+  uint64_t blocks =
+      ((uint64_t(width) * height * 4 + (1 << dirty_shift) - 1) >> dirty_shift);
+  dirty_map.assign((blocks + 63) / 64, 0);
+}
+
+host_bank_t framebuffer_backend::pixel_bank(void) {
+  return {0, uint64_t(width) * height * 4, reinterpret_cast<uint8_t *>(pixels),
+          dirty_map.data(), dirty_shift};
+}
+
+uint64_t framebuffer_backend::byte_span(void) const {
+  return framebuffer_frontend::pixel_offset + uint64_t(width) * height * 4;
+}
+
+std::vector<fb_rect_t> framebuffer_backend::take_dirty_rects(void) {
+  std::vector<fb_rect_t> rects;
+  uint64_t stride = uint64_t(width) * 4;
+  // dirty column range of the current band of rows
+  uint32_t band_y = 0, band_h = 0, band_x0 = 0, band_x1 = 0;
+  // dirty column range of the current row
+  uint32_t row = 0, row_x0 = 0, row_x1 = 0;
+  bool row_dirty = false;
+
+  auto end_row = [&](void) {
+    if (!row_dirty) {
+      return;
+    }
+    if (band_h != 0 && band_y + band_h == row) {
+      band_x0 = std::min(band_x0, row_x0);
+      band_x1 = std::max(band_x1, row_x1);
+      ++band_h;
+    } else {
+      if (band_h != 0) {
+        rects.push_back({band_x0, band_y, band_x1 - band_x0, band_h});
+      }
+      band_y = row;
+      band_h = 1;
+      band_x0 = row_x0;
+      band_x1 = row_x1;
+    }
+    row_dirty = false;
+  };
+
+  for (size_t i = 0; i < dirty_map.size(); ++i) {
+    uint64_t word = dirty_map[i];
+    dirty_map[i] = 0;
+    while (word != 0) {
+      uint64_t block = i * 64 + std::countr_zero(word);
+      word &= word - 1;
+      uint64_t begin = block << dirty_shift;
+      uint64_t end = std::min((block + 1) << dirty_shift, stride * height);
+      // a block may cover the end of a row and the start of the next ones
+      while (begin < end) {
+        uint32_t y = begin / stride;
+        uint64_t row_end = std::min(end, (uint64_t(y) + 1) * stride);
+        uint32_t x0 = (begin % stride) / 4;
+        uint32_t x1 = ((row_end - 1) % stride) / 4 + 1;
+        if (!row_dirty || y != row) {
+          end_row();
+          row = y;
+          row_x0 = x0;
+          row_x1 = x1;
+          row_dirty = true;
+        } else {
+          row_x0 = std::min(row_x0, x0);
+          row_x1 = std::max(row_x1, x1);
+        }
+        begin = row_end;
+      }
+    }
+  }
+  end_row();
+  if (band_h != 0) {
+    rects.push_back({band_x0, band_y, band_x1 - band_x0, band_h});
+  }
+  return rects;
+}
+
+uint64_t framebuffer_backend::request(uint64_t req) {
+  if (req == (reqval::fb_width | reqval::fb_height)) {
+    return (uint64_t(width) << 16) | height;
+  }
+  if (req == reqval::fb_width) {
+    return width;
+  }
+  if (req == reqval::fb_height) {
+    return height;
+  }
+  return 0;
+}
+
+void framebuffer_backend::put(uint64_t req, uint64_t data) {
+  if (req == reqval::fb_sync) {
+    present(take_dirty_rects());
+  }
+}
+
+bool framebuffer_backend::poll(uint64_t req) { return true; }
+
+bool framebuffer_backend::check(uint64_t req) { return true; }
+
+} // namespace libvio
@@ -0,0 +1,44 @@
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <libvio/framebuffer.hh>
+#include <memory>
+#include <vector>
+
+namespace libvio {
+
+framebuffer_backend_ppm::framebuffer_backend_ppm(uint32_t width,
+                                                 uint32_t height,
+                                                 const char *pattern)
+    : framebuffer_backend(width, height), pattern(pattern) {
+  storage = std::unique_ptr<uint32_t[]>{new uint32_t[uint64_t(width) * height]};
+  std::fill_n(storage.get(), uint64_t(width) * height, 0);
+  pixels = storage.get();
+}
+
+void framebuffer_backend_ppm::present(const std::vector<fb_rect_t> &dirty) {
+  if (dirty.empty()) {
+    return;
+  }
+  std::vector<char> filename(pattern.size() + 32);
+  std::snprintf(filename.data(), filename.size(), pattern.c_str(), frame++);
+  std::ofstream out(filename.data(), std::ios::binary);
+  if (!out) {
+    std::cerr << "libvio: Failed to open " << filename.data() << std::endl;
+    return;
+  }
+  out << "P6\n" << width << ' ' << height << "\n255\n";
+  std::vector<char> line(uint64_t(width) * 3);
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint32_t *src = pixels + uint64_t(y) * width;
+    for (uint32_t x = 0; x < width; ++x) {
+      line[x * 3 + 0] = (src[x] >> 16) & 0xff;
+      line[x * 3 + 1] = (src[x] >> 8) & 0xff;
+      line[x * 3 + 2] = src[x] & 0xff;
+    }
+    out.write(line.data(), line.size());
+  }
+}
+
+} // namespace libvio
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fcntl.h>
+#include <iostream>
+#include <libvio/framebuffer.hh>
+#include <memory>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+namespace libvio {
+
+// keep the pixels cache line aligned
+static constexpr size_t shm_pixel_offset = 64;
+
+framebuffer_backend_shm::framebuffer_backend_shm(uint32_t width,
+                                                 uint32_t height,
+                                                 const char *name)
+    : framebuffer_backend(width, height), name(name) {
+  size_t size = shm_pixel_offset + uint64_t(width) * height * 4;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd >= 0 && ftruncate(fd, size) == 0) {
+    void *ptr =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr != MAP_FAILED) {
+      header = static_cast<fb_shm_header_t *>(ptr);
+      map_size = size;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  if (header == nullptr) {
+    std::cerr << "libvio: Failed to create shared memory " << name
+              << std::endl;
+    fallback =
+        std::unique_ptr<uint32_t[]>{new uint32_t[uint64_t(width) * height]};
+    std::fill_n(fallback.get(), uint64_t(width) * height, 0);
+    pixels = fallback.get();
+    return;
+  }
+  header->magic = fb_shm_magic;
+  header->width = width;
+  header->height = height;
+  header->offset = shm_pixel_offset;
+  header->frame = 0;
+  header->dirty = {0, 0, 0, 0};
+  pixels = reinterpret_cast<uint32_t *>(reinterpret_cast<uint8_t *>(header) +
+                                        shm_pixel_offset);
+}
+
+framebuffer_backend_shm::~framebuffer_backend_shm() {
+  if (header != nullptr) {
+    munmap(header, map_size);
+    shm_unlink(name.c_str());
+  }
+}
+
+void framebuffer_backend_shm::present(const std::vector<fb_rect_t> &dirty) {
+  if (header == nullptr || dirty.empty()) {
+    return;
+  }
+  uint32_t x0 = width, y0 = height, x1 = 0, y1 = 0;
+  for (const auto &rect : dirty) {
+    x0 = std::min(x0, rect.x);
+    y0 = std::min(y0, rect.y);
+    x1 = std::max(x1, rect.x + rect.width);
+    y1 = std::max(y1, rect.y + rect.height);
+  }
+  header->dirty = {x0, y0, x1 - x0, y1 - y0};
+  // publish the frame after the pixels and the dirty area
+  __atomic_store_n(&header->frame, header->frame + 1, __ATOMIC_RELEASE);
+}
+
+} // namespace libvio
@@ -0,0 +1,45 @@
+#include <cstdint>
+#include <libvio/frontend.hh>
+#include <libvio/framebuffer.hh>
+#include <libvio/regmap.hh>
+#include <vector>
+
+namespace libvio {
+
+static constexpr register_map<8> framebuffer_registers{{
+    {0, width_t::word, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::fb_width | reqval::fb_height},
+     {ioreq_type_t::invalid, 0}},
+    {0, width_t::half, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::fb_height}, {ioreq_type_t::invalid, 0}},
+    {2, width_t::half, reg_access_t::read_only,
+     {ioreq_type_t::read, reqval::fb_width}, {ioreq_type_t::invalid, 0}},
+    {4, width_t::word, reg_access_t::write_only, {ioreq_type_t::invalid, 0},
+     {ioreq_type_t::write, reqval::fb_sync}},
+}};
+
+ioreq_t framebuffer_frontend::resolve_read(uint64_t offset,
+                                           width_t width) const {
+  return framebuffer_registers.resolve_read(offset, width);
+}
+
+ioreq_t framebuffer_frontend::resolve_write(uint64_t offset, width_t width,
+                                            uint64_t data) const {
+  return framebuffer_registers.resolve_write(offset, width);
+}
+
+std::vector<host_bank_t> framebuffer_frontend::host_banks(void) const {
+  auto fb = dynamic_cast<framebuffer_backend *>(backend);
+  if (fb == nullptr) {
+    return {};
+  }
+  host_bank_t bank = fb->pixel_bank();
+  bank.offset = pixel_offset;
+  return {bank};
+}
+
+uint64_t framebuffer_frontend::ioctl_get(uint64_t req) { return 0; }
+
+void framebuffer_frontend::ioctl_set(uint64_t req, uint64_t value) { return; }
+
+} // namespace libvio
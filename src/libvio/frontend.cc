@@ -1,3 +1,4 @@
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
 #include <libvio/backend.hh>
@@ -62,4 +63,25 @@ bool io_frontend::write(uint64_t offset, width_t width, uint64_t data) {
   return write_result;
 }
 
+bool io_frontend::read_burst(uint64_t offset, uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    auto byte = read(offset + i, width_t::byte);
+    if (!byte.has_value()) {
+      return false;
+    }
+    data[i] = byte.value();
+  }
+  return true;
+}
+
+bool io_frontend::write_burst(uint64_t offset, const uint8_t *data,
+                              size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (!write(offset + i, width_t::byte, data[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 } // namespace libvio
\ No newline at end of file
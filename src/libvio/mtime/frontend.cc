@@ -1,66 +1,42 @@
 #include <cstdint>
 #include <libvio/frontend.hh>
 #include <libvio/mtime.hh>
+#include <libvio/regmap.hh>
 
 namespace libvio {
 
-ioreq_t mtime_frontend::resolve_read(size_t offset, width_t width) const {
-  if (width == width_t::dword) {
-    if (offset == 0) {
-      // reading mtime
-      return {ioreq_type_t::read, reqval::mtime_h | reqval::mtime_l};
-    } else if (offset == 8) {
-      // reading mtimecmp
-      return {ioreq_type_t::read, reqval::mtimecmp_h | reqval::mtimecmp_l};
-      ;
-    } else {
-      return {ioreq_type_t::invalid, 0};
-    }
-  } else if (width == width_t::word) {
-    if (offset == 0) {
-      return {ioreq_type_t::read, reqval::mtime_l};
-    } else if (offset == 4) {
-      return {ioreq_type_t::read, reqval::mtime_h};
-    } else if (offset == 8) {
-      return {ioreq_type_t::read, reqval::mtimecmp_l};
-    } else if (offset == 12) {
-      return {ioreq_type_t::read, reqval::mtimecmp_l};
-    } else {
-      return {ioreq_type_t::invalid, 0};
-    }
-  } else {
-    return {ioreq_type_t::invalid, 0};
-  }
+static constexpr uint64_t mtime_hl = reqval::mtime_h | reqval::mtime_l;
+static constexpr uint64_t mtimecmp_hl =
+    reqval::mtimecmp_h | reqval::mtimecmp_l;
+
+static constexpr register_map<16> mtime_registers{{
+    // 64-bit accesses
+    {0, width_t::dword, reg_access_t::read_write,
+     {ioreq_type_t::read, mtime_hl}, {ioreq_type_t::write, mtime_hl}},
+    {8, width_t::dword, reg_access_t::read_write,
+     {ioreq_type_t::read, mtimecmp_hl}, {ioreq_type_t::write, mtimecmp_hl}},
+    // 32-bit accesses
+    {0, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::mtime_l},
+     {ioreq_type_t::write, reqval::mtime_l}},
+    {4, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::mtime_h},
+     {ioreq_type_t::write, reqval::mtime_h}},
+    {8, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::mtimecmp_l},
+     {ioreq_type_t::write, reqval::mtimecmp_l}},
+    {12, width_t::word, reg_access_t::read_write,
+     {ioreq_type_t::read, reqval::mtimecmp_h},
+     {ioreq_type_t::write, reqval::mtimecmp_h}},
+}};
+
+ioreq_t mtime_frontend::resolve_read(uint64_t offset, width_t width) const {
+  return mtime_registers.resolve_read(offset, width);
 }
 
-ioreq_t mtime_frontend::resolve_write(size_t offset, width_t width,
+ioreq_t mtime_frontend::resolve_write(uint64_t offset, width_t width,
                                       uint64_t data) const {
-  if (width == width_t::dword) {
-    if (offset == 0) {
-      // mtime
-      return {ioreq_type_t::write, reqval::mtime_h | reqval::mtime_l};
-    } else if (offset == 8) {
-      // mtimecmp
-      return {ioreq_type_t::write, reqval::mtimecmp_h | reqval::mtimecmp_l};
-      ;
-    } else {
-      return {ioreq_type_t::invalid, 0};
-    }
-  } else if (width == width_t::word) {
-    if (offset == 0) {
-      return {ioreq_type_t::write, reqval::mtime_l};
-    } else if (offset == 4) {
-      return {ioreq_type_t::write, reqval::mtime_h};
-    } else if (offset == 8) {
-      return {ioreq_type_t::write, reqval::mtimecmp_l};
-    } else if (offset == 12) {
-      return {ioreq_type_t::write, reqval::mtimecmp_l};
-    } else {
-      return {ioreq_type_t::invalid, 0};
-    }
-  } else {
-    return {ioreq_type_t::invalid, 0};
-  }
+  return mtime_registers.resolve_write(offset, width);
 }
 
 uint64_t mtime_frontend::ioctl_get(uint64_t req) { return 0; }
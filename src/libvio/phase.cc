@@ -0,0 +1,65 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <libvio/phase.hh>
+#include <ostream>
+
+namespace libvio {
+
+const char *phase_name(phase_t phase) {
+  static const char *const names[n_phases] = {
+      "none",   "cpu",  "fetch", "decode",   "execute",
+      "memory", "mmio", "trace", "difftest",
+  };
+  return names[static_cast<size_t>(phase)];
+}
+
+// the fastest of many back-to-back reads, so interrupts are filtered out
+static uint64_t clock_cost(void) {
+  uint64_t cost = UINT64_MAX;
+  for (size_t i = 0; i < 1000; ++i) {
+    uint64_t begin = phase_clock();
+    uint64_t end = phase_clock();
+    cost = std::min(cost, end - begin);
+  }
+  return cost;
+}
+
+void reset_phase_profile(void) {
+  phase_profile_t &profile = phase_profile;
+  std::fill(std::begin(profile.ticks), std::end(profile.ticks), 0);
+  std::fill(std::begin(profile.switches), std::end(profile.switches), 0);
+  profile.last = phase_clock();
+}
+
+void write_phase_profile(std::ostream &os, uint64_t instructions) {
+  static const uint64_t cost = clock_cost();
+  const phase_profile_t &profile = phase_profile;
+  uint64_t ticks[n_phases];
+  uint64_t total = 0;
+  uint64_t overhead = 0;
+  // time outside the simulation, e.g. in the debugger, is not reported
+  for (size_t i = 1; i < n_phases; ++i) {
+    uint64_t clock = std::min(profile.ticks[i], profile.switches[i] * cost);
+    ticks[i] = profile.ticks[i] - clock;
+    total += ticks[i];
+    overhead += clock;
+  }
+  double per_total = 100.0 / std::max<uint64_t>(total, 1);
+  double per_instr = 1.0 / std::max<uint64_t>(instructions, 1);
+  os << std::setw(10) << "phase" << std::setw(16) << "ticks" << std::setw(8)
+     << "%" << std::setw(12) << "per instr" << std::endl;
+  os << std::fixed << std::setprecision(2);
+  for (size_t i = 1; i < n_phases; ++i) {
+    os << std::setw(10) << phase_name(static_cast<phase_t>(i))
+       << std::setw(16) << ticks[i] << std::setw(8) << ticks[i] * per_total
+       << std::setw(12) << ticks[i] * per_instr << std::endl;
+  }
+  os << std::setw(10) << "total" << std::setw(16) << total << std::setw(8)
+     << 100.0 << std::setw(12) << total * per_instr << std::endl;
+  os << std::defaultfloat << overhead << " ticks of clock reads, " << cost
+     << " each, not included" << std::endl;
+}
+
+} // namespace libvio
@@ -0,0 +1,166 @@
+#include <bit>
+#include <cstdint>
+#include <libvio/frontend.hh>
+#include <libvio/plic.hh>
+
+namespace libvio {
+
+// kinds of registers, encoded in the upper half of `ioreq_t::req`
+// the lower half is the source, word or context index
+static constexpr uint64_t plic_priority = 1;
+static constexpr uint64_t plic_pending = 2;
+static constexpr uint64_t plic_enable = 3;
+static constexpr uint64_t plic_threshold = 4;
+static constexpr uint64_t plic_claim = 5;
+
+static constexpr uint64_t priority_base = 0x000000;
+static constexpr uint64_t pending_base = 0x001000;
+static constexpr uint64_t enable_base = 0x002000;
+static constexpr uint64_t enable_stride = 0x80;
+static constexpr uint64_t context_base = 0x200000;
+static constexpr uint64_t context_stride = 0x1000;
+
+plic_frontend::plic_frontend(unsigned n_contexts)
+    : n_contexts(n_contexts), priority{}, enable(n_contexts, 0),
+      threshold(n_contexts, 0) {}
+
+// the word registers are the same for reads and writes
+static ioreq_t resolve(uint64_t offset, width_t width, unsigned n_contexts) {
+  if (width != width_t::word || offset % 4 != 0) {
+    return {ioreq_type_t::invalid, 0};
+  }
+  uint64_t kind = 0, index = 0;
+  if (offset < pending_base) {
+    kind = plic_priority;
+    index = (offset - priority_base) / 4;
+    if (index >= plic_frontend::max_sources) {
+      return {ioreq_type_t::invalid, 0};
+    }
+  } else if (offset < enable_base) {
+    kind = plic_pending;
+    index = (offset - pending_base) / 4;
+    if (index >= plic_frontend::max_sources / 32) {
+      return {ioreq_type_t::invalid, 0};
+    }
+  } else if (offset < context_base) {
+    uint64_t context = (offset - enable_base) / enable_stride;
+    uint64_t word = (offset - enable_base) % enable_stride / 4;
+    if (context >= n_contexts || word >= plic_frontend::max_sources / 32) {
+      return {ioreq_type_t::invalid, 0};
+    }
+    kind = plic_enable;
+    index = context * 2 + word;
+  } else {
+    uint64_t context = (offset - context_base) / context_stride;
+    uint64_t reg = (offset - context_base) % context_stride;
+    if (context >= n_contexts || reg > 4) {
+      return {ioreq_type_t::invalid, 0};
+    }
+    kind = reg == 0 ? plic_threshold : plic_claim;
+    index = context;
+  }
+  return {ioreq_type_t::ioctl_get, (kind << 32) | index};
+}
+
+ioreq_t plic_frontend::resolve_read(uint64_t offset, width_t width) const {
+  return resolve(offset, width, n_contexts);
+}
+
+ioreq_t plic_frontend::resolve_write(uint64_t offset, width_t width,
+                                     uint64_t data) const {
+  ioreq_t req = resolve(offset, width, n_contexts);
+  if (req.type == ioreq_type_t::invalid || req.req >> 32 == plic_pending) {
+    return {ioreq_type_t::invalid, 0};
+  }
+  return {ioreq_type_t::ioctl_set, req.req};
+}
+
+uint64_t plic_frontend::ioctl_get(uint64_t req) {
+  uint64_t kind = req >> 32;
+  uint32_t index = req & 0xffffffff;
+  switch (kind) {
+  case plic_priority:
+    return priority[index];
+  case plic_pending:
+    return (pending >> (index * 32)) & 0xffffffff;
+  case plic_enable:
+    return (enable[index / 2] >> (index % 2 * 32)) & 0xffffffff;
+  case plic_threshold:
+    return threshold[index];
+  case plic_claim: {
+    unsigned source = best_source(index);
+    if (source != 0) {
+      claimed |= uint64_t(1) << source;
+      update_pending();
+    }
+    return source;
+  }
+  default:
+    return 0;
+  }
+}
+
+void plic_frontend::ioctl_set(uint64_t req, uint64_t value) {
+  uint64_t kind = req >> 32;
+  uint32_t index = req & 0xffffffff;
+  switch (kind) {
+  case plic_priority:
+    // source 0 does not exist
+    if (index != 0) {
+      priority[index] = value;
+    }
+    break;
+  case plic_enable: {
+    uint64_t mask = uint64_t(0xffffffff) << (index % 2 * 32);
+    uint64_t bits = (value & 0xffffffff) << (index % 2 * 32);
+    enable[index / 2] = (enable[index / 2] & ~mask) | (bits & ~uint64_t(1));
+    break;
+  }
+  case plic_threshold:
+    threshold[index] = value;
+    break;
+  case plic_claim:
+    // completing a source not enabled for the context is ignored
+    if (value < max_sources && ((enable[index] >> value) & 1)) {
+      claimed &= ~(uint64_t(1) << value);
+      update_pending();
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+void plic_frontend::set_sources(uint64_t levels) {
+  this->levels = levels & ~uint64_t(1);
+  update_pending();
+}
+
+uint64_t plic_frontend::outputs(void) const {
+  uint64_t result = 0;
+  for (unsigned context = 0; context < n_contexts; ++context) {
+    if (best_source(context) != 0) {
+      result |= uint64_t(1) << context;
+    }
+  }
+  return result;
+}
+
+unsigned plic_frontend::best_source(unsigned context) const {
+  uint64_t candidates = pending & enable[context];
+  unsigned best = 0;
+  uint32_t best_priority = threshold[context];
+  while (candidates != 0) {
+    unsigned source = std::countr_zero(candidates);
+    candidates &= candidates - 1;
+    if (priority[source] > best_priority) {
+      best = source;
+      best_priority = priority[source];
+    }
+  }
+  return best;
+}
+
+void plic_frontend::update_pending(void) { pending = levels & ~claimed; }
+
+} // namespace libvio
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <libvio/replay.hh>
+#include <optional>
+#include <utility>
+
+namespace libvio {
+
+replay_agent::replay_agent(io_agent *target) : target(target) {
+  irq_handler = std::move(target->irq_handler);
+  target->irq_handler = [this](uint64_t lines) {
+    append({kind_t::irq, true, 0, lines});
+    if (irq_handler) {
+      irq_handler(lines);
+    }
+  };
+  dma_write_handler = std::move(target->dma_write_handler);
+  target->dma_write_handler = [this](uint64_t addr, const uint8_t *data,
+                                     size_t len) {
+    bursts.emplace_back(data, data + len);
+    log_bytes += len;
+    append({kind_t::dma, true, addr, burst_base + bursts.size() - 1});
+    return dma_write_handler && dma_write_handler(addr, data, len);
+  };
+  // DMA reads only happen while recording, so they need no log
+  dma_read_handler = std::move(target->dma_read_handler);
+  target->dma_read_handler = [this](uint64_t addr, uint8_t *data, size_t len) {
+    return dma_read_handler && dma_read_handler(addr, data, len);
+  };
+}
+
+replay_agent::~replay_agent() {
+  target->irq_handler = std::move(irq_handler);
+  target->dma_write_handler = std::move(dma_write_handler);
+  target->dma_read_handler = std::move(dma_read_handler);
+}
+
+void replay_agent::append(const entry_t &entry) {
+  log_bytes += sizeof(entry_t);
+  log.push_back(entry);
+  ++pos;
+}
+
+void replay_agent::discard(size_t position) {
+  while (base < position && !log.empty()) {
+    // bursts are logged in order, so the first one goes with its entry
+    if ((log.front().kind == kind_t::read_burst && log.front().ok) ||
+        log.front().kind == kind_t::dma) {
+      log_bytes -= bursts.front().size();
+      bursts.pop_front();
+      ++burst_base;
+    }
+    log_bytes -= sizeof(entry_t);
+    log.pop_front();
+    ++base;
+  }
+}
+
+const replay_agent::entry_t *replay_agent::replay(kind_t kind, uint64_t addr) {
+  while (replaying() && (log[pos - base].kind == kind_t::irq ||
+                         log[pos - base].kind == kind_t::dma)) {
+    const entry_t &entry = log[pos - base];
+    if (entry.kind == kind_t::irq && irq_handler) {
+      irq_handler(entry.value);
+    } else if (entry.kind == kind_t::dma && dma_write_handler) {
+      const std::vector<uint8_t> &data = bursts[entry.value - burst_base];
+      dma_write_handler(entry.addr, data.data(), data.size());
+    }
+    ++pos;
+  }
+  if (!replaying()) {
+    return nullptr;
+  }
+  const entry_t &entry = log[pos - base];
+  ++pos;
+  if (entry.kind != kind || entry.addr != addr) {
+    if (!warned) {
+      std::cerr << "libvio: MMIO replay diverged from the recording at entry "
+                << pos - 1 << "." << std::endl;
+      warned = true;
+    }
+    return nullptr;
+  }
+  return &entry;
+}
+
+std::optional<uint64_t> replay_agent::read(uint64_t addr, width_t width) {
+  if (replaying()) {
+    const entry_t *entry = replay(kind_t::read, addr);
+    if (entry == nullptr || !entry->ok) {
+      return std::nullopt;
+    }
+    return entry->value;
+  }
+  auto data = target->read(addr, width);
+  append({kind_t::read, data.has_value(), addr, data.value_or(0)});
+  return data;
+}
+
+bool replay_agent::write(uint64_t addr, width_t width, uint64_t data) {
+  if (replaying()) {
+    const entry_t *entry = replay(kind_t::write, addr);
+    return entry != nullptr && entry->ok;
+  }
+  bool ok = target->write(addr, width, data);
+  append({kind_t::write, ok, addr, 0});
+  return ok;
+}
+
+bool replay_agent::read_burst(uint64_t addr, uint8_t *data, size_t len) {
+  if (replaying()) {
+    const entry_t *entry = replay(kind_t::read_burst, addr);
+    if (entry == nullptr || !entry->ok) {
+      return false;
+    }
+    const std::vector<uint8_t> &burst = bursts[entry->value - burst_base];
+    if (burst.size() != len) {
+      return false;
+    }
+    std::copy(burst.begin(), burst.end(), data);
+    return true;
+  }
+  bool ok = target->read_burst(addr, data, len);
+  if (ok) {
+    bursts.emplace_back(data, data + len);
+    log_bytes += len;
+  }
+  append({kind_t::read_burst, ok, addr, burst_base + bursts.size() - 1});
+  return ok;
+}
+
+bool replay_agent::write_burst(uint64_t addr, const uint8_t *data,
+                               size_t len) {
+  if (replaying()) {
+    const entry_t *entry = replay(kind_t::write_burst, addr);
+    return entry != nullptr && entry->ok;
+  }
+  bool ok = target->write_burst(addr, data, len);
+  append({kind_t::write_burst, ok, addr, 0});
+  return ok;
+}
+
+void replay_agent::poll_irq(void) {
+  if (replaying()) {
+    replay(kind_t::poll, 0);
+    return;
+  }
+  target->poll_irq();
+  append({kind_t::poll, true, 0, 0});
+}
+
+} // namespace libvio